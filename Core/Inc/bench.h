@@ -0,0 +1,102 @@
+/**
+ * Blackberry Q10 keyboard STM32 driver
+ * A fun little weekend project to act as a BBQ10 STM32 driver that is able to communicate with I2C bus masters.
+ * Creates rising-edge IRQ pulse, sends pressed character over I2C when master reads from slave upon receiving interrupt.
+ *
+ * Copyright (C) 2025 Mustafa Ozcelikors
+ *
+ * See GPLv3 LICENSE file in repository for licensing details.
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#ifndef INC_BENCH_H_
+#define INC_BENCH_H_
+
+#include "stm32f4xx_hal.h"
+
+/* Cycle benchmarks of the hot paths on the DWT cycle counter, read out over
+ * I2C (tools/bench_read.py). Off until started, a probe then costs two
+ * CYCCNT reads and a short interrupts-off update, and a flag test otherwise.
+ *
+ * Per probe: sample count, min, max and mean in cycles and a log2 histogram.
+ * Bucket 0 holds samples below 2^BENCH_HIST_SHIFT cycles, bucket i > 0 those
+ * in [2^(i + BENCH_HIST_SHIFT - 1), 2^(i + BENCH_HIST_SHIFT)), the last bucket
+ * everything above.
+ *
+ * The BENCH_KEY_* probes follow every key through the pipeline, one sample
+ * per key and stage, each measured from the end of the stage before, so the
+ * stages of one key add up to BENCH_KEY_TOTAL. There is no separate debounce,
+ * a key is accepted by the scan that sees its edge; when during the scan
+ * interval before that scan the edge happened is not known. With the default
+ * shift the last bucket starts at 2^19 cycles, about 33 ms at 16 MHz. */
+
+/* Probes */
+#define BENCH_SCAN          0  // keyboard_scan(), settle delays included
+#define BENCH_FIND_KEY      1  // keyboard_find_key()
+#define BENCH_I2C_ADDR      2  // HAL_I2C_AddrCallback()
+#define BENCH_I2C_RX_CPLT   3  // HAL_I2C_SlaveRxCpltCallback()
+#define BENCH_I2C_TX_CPLT   4  // HAL_I2C_SlaveTxCpltCallback()
+#define BENCH_I2C_LISTEN    5  // HAL_I2C_ListenCpltCallback()
+#define BENCH_I2C_ERROR     6  // HAL_I2C_ErrorCallback()
+#define BENCH_KEY_TO_IRQ    7  // start of the scan that saw a key to the IRQ edge
+#define BENCH_ISR_ENTRY     8  // NVIC pend to the first line of a handler at I2C priority
+#define BENCH_KEY_SCAN      9  // start to end of the scan that accepted the key
+#define BENCH_KEY_DECODE    10 // end of that scan to keyboard_find_key() done, PendSV entry included
+#define BENCH_KEY_QUEUE     11 // decoded to stored in the key FIFO
+#define BENCH_KEY_IRQ       12 // queued to the IRQ edge, coalescing included
+#define BENCH_KEY_READ      13 // IRQ edge to the master finishing the key read
+#define BENCH_KEY_TOTAL     14 // start of the scan to the master finishing the key read
+#define BENCH_NUM_PROBES    15
+
+#define BENCH_HIST_BUCKETS 16
+#define BENCH_HIST_SHIFT   5
+
+/* Spare vector for the ISR entry probe, pended from the main loop */
+#define BENCH_IRQn       SPI5_IRQn
+#define BENCH_IRQHandler SPI5_IRQHandler
+
+/* REG_BENCH_CTRL commands */
+#define BENCH_CMD_STOP  0x00
+#define BENCH_CMD_START 0x01  // clears all probes and starts measuring
+#define BENCH_CMD_CLEAR 0x02
+
+/* REG_BENCH_CTRL status */
+#define BENCH_STATE_STOPPED 0x00
+#define BENCH_STATE_RUNNING 0x01
+
+typedef struct
+{
+    uint32_t count;
+    uint32_t min;
+    uint32_t max;
+    uint64_t total;
+    uint16_t hist[BENCH_HIST_BUCKETS];  // saturating
+} bench_stats_t;
+
+void bench_init(void);
+uint32_t bench_start(void);
+void bench_record(uint8_t probe, uint32_t start);
+void bench_key_decoded(uint32_t scan_start, uint32_t scan_end);
+void bench_key_queued(uint8_t slot);
+void bench_key_irq(void);
+void bench_key_delivered(uint8_t slot);
+void bench_poll(void);
+void bench_command(uint8_t cmd);
+void bench_get(uint8_t probe, bench_stats_t *stats);
+uint8_t bench_get_status(uint8_t *buf);
+uint8_t bench_read(uint8_t probe, uint8_t *buf);
+uint8_t bench_read_hist(uint8_t probe, uint8_t *buf);
+
+#endif /* INC_BENCH_H_ */
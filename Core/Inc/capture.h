@@ -0,0 +1,62 @@
+/**
+ * Blackberry Q10 keyboard STM32 driver
+ * A fun little weekend project to act as a BBQ10 STM32 driver that is able to communicate with I2C bus masters.
+ * Creates rising-edge IRQ pulse, sends pressed character over I2C when master reads from slave upon receiving interrupt.
+ *
+ * Copyright (C) 2025 Mustafa Ozcelikors
+ *
+ * See GPLv3 LICENSE file in repository for licensing details.
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#ifndef INC_CAPTURE_H_
+#define INC_CAPTURE_H_
+
+#include "stm32f4xx_hal.h"
+#include "keyboard.h"
+
+/* Raw matrix capture into a RAM ring, read out over I2C and replayed on the
+ * host build (host/Src/replay_capture.c).
+ *
+ * Image layout, as returned by REG_CAPTURE_DATA:
+ *   version, NUM_ROWS, NUM_COLS, base frame (KEYBOARD_BITMAP_SIZE bytes), records...
+ * A frame is one scan's samples packed like the key state snapshot (bit r * NUM_COLS + c).
+ * The base frame is the matrix before the oldest record still in the ring.
+ * Record: varint idle scans, varint dt_us, flip count, flipped bit indices
+ *   idle scans  unchanged scans since the previous record, not stored themselves
+ *   dt_us       time since the previous record (or since start)
+ * Varints are LEB128, 7 bits per byte, low bits first. */
+
+#define CAPTURE_FORMAT_VERSION 1
+#define CAPTURE_HEADER_SIZE    (3 + KEYBOARD_BITMAP_SIZE)
+#define CAPTURE_RING_SIZE      4096  // must be a power of two
+#define CAPTURE_MAX_IDLE_SCANS 1000  // an unchanged scan is recorded after this many, bounds the idle tail
+
+/* REG_CAPTURE_CTRL commands, applied by the main loop at the next scan */
+#define CAPTURE_CMD_STOP  0x00
+#define CAPTURE_CMD_START 0x01  // clears the ring and starts recording
+#define CAPTURE_CMD_CLEAR 0x02
+
+/* REG_CAPTURE_CTRL status */
+#define CAPTURE_STATE_STOPPED 0x00
+#define CAPTURE_STATE_RUNNING 0x01
+#define CAPTURE_FLAG_WRAPPED  (1 << 0)  // oldest records were overwritten
+
+void capture_record(const board_row_mask_t rows[NUM_COLS]);
+void capture_command(uint8_t cmd);
+uint8_t capture_get_status(uint8_t *buf);
+uint8_t capture_read(uint16_t offset, uint8_t *buf, uint8_t size);
+
+#endif /* INC_CAPTURE_H_ */
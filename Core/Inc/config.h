@@ -0,0 +1,57 @@
+/**
+ * Blackberry Q10 keyboard STM32 driver
+ * A fun little weekend project to act as a BBQ10 STM32 driver that is able to communicate with I2C bus masters.
+ * Creates rising-edge IRQ pulse, sends pressed character over I2C when master reads from slave upon receiving interrupt.
+ *
+ * Copyright (C) 2025 Mustafa Ozcelikors
+ *
+ * See GPLv3 LICENSE file in repository for licensing details.
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#ifndef INC_CONFIG_H_
+#define INC_CONFIG_H_
+
+#include "stm32f4xx_hal.h"
+
+/* Configuration parameters, 16-bit values */
+#define CFG_SCAN_INTERVAL_MS        0x00  // delay between two matrix scans
+#define CFG_COL_SETTLE_US           0x01  // settle time after driving a column low, upper bound with auto settle
+#define CFG_PRESS_AND_HOLD_MS       0x02  // time a key is held before it repeats
+#define CFG_SYM_DEBOUNCE_MS         0x03  // caps lock (sym) toggle debounce
+#define CFG_I2C_ADDRESS             0x04  // 7-bit slave address, applied at boot
+#define CFG_IRQ_PULSE_MS            0x05  // width of the IRQ_KEYCHANGED pulse
+#define CFG_IRQ_COALESCE_EVENTS     0x06  // see IRQ_COALESCE_EVENTS
+#define CFG_IRQ_COALESCE_TIMEOUT_US 0x07  // see IRQ_COALESCE_TIMEOUT_US
+#define CFG_COL_SETTLE_AUTO         0x08  // 1: per column settle time calibrated at boot
+#define CFG_EDGE_STAMP              0x09  // 1: columns parked between scans, presses stamped by row edge (edge.h)
+#define CFG_PARTIAL_SCAN            0x0A  // 1: columns searched while at most one key is down
+#define CFG_NUM_PARAMS              11
+
+/* Flash layout: two 128K sectors at the end of flash used as an EEPROM emulation log.
+ * Each sector starts with a status word and a generation word, followed by
+ * 32-bit records: value[15:0], parameter id[23:16], check byte[31:24]. */
+#define CONFIG_PAGE0_ADDR   0x08040000U  // sector 6
+#define CONFIG_PAGE1_ADDR   0x08060000U  // sector 7
+#define CONFIG_PAGE0_SECTOR FLASH_SECTOR_6
+#define CONFIG_PAGE1_SECTOR FLASH_SECTOR_7
+#define CONFIG_PAGE_SIZE    0x20000U
+
+void config_init(void);
+uint16_t config_get(uint8_t id);
+uint8_t config_set(uint8_t id, uint16_t value);
+void config_service(void);
+
+#endif /* INC_CONFIG_H_ */
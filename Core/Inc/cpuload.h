@@ -0,0 +1,108 @@
+/**
+ * Blackberry Q10 keyboard STM32 driver
+ * A fun little weekend project to act as a BBQ10 STM32 driver that is able to communicate with I2C bus masters.
+ * Creates rising-edge IRQ pulse, sends pressed character over I2C when master reads from slave upon receiving interrupt.
+ *
+ * Copyright (C) 2025 Mustafa Ozcelikors
+ *
+ * See GPLv3 LICENSE file in repository for licensing details.
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#ifndef INC_CPULOAD_H_
+#define INC_CPULOAD_H_
+
+#include "stm32f4xx_hal.h"
+#include "timebase.h"
+
+/* CPU load meter on the DWT cycle counter, always on, read over I2C
+ * (REG_CPU_LOAD, tools/cpuload_read.py).
+ *
+ * Each interrupt context brackets its handler with cpuload_enter() and
+ * cpuload_exit(), which charge it with its own cycles: those of handlers
+ * nesting in it are taken off, so nothing is counted twice. The main loop
+ * brackets its scan interval wait as idle. What is left is main loop work.
+ * Every CPULOAD_WINDOW_MS SysTick turns the cycles of the window into shares
+ * in units of 0.01 %. Counters run free and windows are taken as
+ * differences, so only the handlers themselves ever write them.
+ *
+ * REG_CPU_LOAD layout, 16-bit little endian each:
+ *   0   window length in ms, 0 before the first window closed
+ *   2   busy, everything but idle
+ *   4   main loop: scan, flash and I2C recovery work
+ *   6   deferred decode (PendSV)
+ *   8   I2C event and error interrupts
+ *   10  SysTick
+ *   12  row edge stamping (EXTI)
+ *   14  idle, waiting out the scan interval
+ *   16  highest busy share of any window since reset */
+
+#define CPULOAD_WINDOW_MS 1000
+
+/* Interrupt contexts */
+#define CPULOAD_DEFERRED 0
+#define CPULOAD_I2C      1
+#define CPULOAD_TICK     2
+#define CPULOAD_EDGE     3
+#define CPULOAD_NUM_ISRS 4
+
+#define CPULOAD_SIZE 18
+
+typedef struct
+{
+    uint32_t start;   // cycle counter at entry
+    uint32_t nested;  // cpuload_isr_total at entry
+} cpuload_frame_t;
+
+// Own cycles per interrupt context and of all of them, written at handler exit
+extern volatile uint32_t cpuload_isr[CPULOAD_NUM_ISRS];
+extern volatile uint32_t cpuload_isr_total;
+
+// Idle cycles, main loop only
+extern volatile uint32_t cpuload_idle;
+
+static inline cpuload_frame_t cpuload_enter(void)
+{
+    cpuload_frame_t frame = { timebase_now(), cpuload_isr_total };
+
+    return frame;
+}
+
+static inline void cpuload_exit(uint8_t isr, cpuload_frame_t frame)
+{
+    // Masked so that a handler preempting this one cannot slip in between
+    // the read and the update of the total, a caller's mask is kept
+    uint32_t primask = __get_PRIMASK();
+
+    __disable_irq();
+
+    uint32_t own = timebase_now() - frame.start - (cpuload_isr_total - frame.nested);
+
+    cpuload_isr[isr] += own;
+    cpuload_isr_total += own;
+
+    __set_PRIMASK(primask);
+}
+
+static inline void cpuload_idle_end(cpuload_frame_t frame)
+{
+    cpuload_idle += timebase_now() - frame.start - (cpuload_isr_total - frame.nested);
+}
+
+void cpuload_init(void);
+void cpuload_tick(void);
+uint8_t cpuload_read(uint8_t *buf);
+
+#endif /* INC_CPULOAD_H_ */
@@ -0,0 +1,97 @@
+/**
+ * Blackberry Q10 keyboard STM32 driver
+ * A fun little weekend project to act as a BBQ10 STM32 driver that is able to communicate with I2C bus masters.
+ * Creates rising-edge IRQ pulse, sends pressed character over I2C when master reads from slave upon receiving interrupt.
+ *
+ * Copyright (C) 2025 Mustafa Ozcelikors
+ *
+ * See GPLv3 LICENSE file in repository for licensing details.
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#ifndef INC_CRASHLOG_H_
+#define INC_CRASHLOG_H_
+
+#include "stm32f4xx_hal.h"
+
+/* Crash dump and flight recorder in .noinit RAM, kept across a reset.
+ *
+ * The key pipeline logs small events into a ring. A fault handler or
+ * Error_Handler() freezes the ring together with the exception frame and the
+ * fault status registers into the dump and resets the chip. A watchdog reset
+ * leaves no time for that, so the ring is frozen at the next boot instead,
+ * unless a dump the host has not read yet is still held: that one is kept and
+ * the watchdog reset is only counted and logged. After the reboot the host
+ * reads the dump over I2C (REG_CRASH_*, tools/crash_read.py) until it clears
+ * it. A dump is only trusted when its magic word and checksum match, so the
+ * random RAM contents after power-on read as no dump.
+ *
+ * Image layout, as returned by REG_CRASH_DATA, 32-bit words little endian:
+ *   0   version, cause, event count, crashes since power-on (saturating)
+ *   4   r0, r1, r2, r3, r12, lr, pc, xpsr as stacked by the exception;
+ *       software errors only fill in pc, the caller of the error handler
+ *   36  stack pointer after stacking, EXC_RETURN
+ *   44  CFSR, HFSR, MMFAR, BFAR
+ *   60  cycle counter and HAL tick at the crash; after a watchdog reset
+ *       the cycle counter of the last event and tick 0
+ *   68  events, oldest first: cycle counter, type, arg, 16-bit data */
+
+#define CRASHLOG_FORMAT_VERSION 1
+#define CRASHLOG_EVENTS         32  // must be a power of two
+#define CRASHLOG_HEADER_SIZE    68
+#define CRASHLOG_EVENT_SIZE     8
+#define CRASHLOG_IMAGE_SIZE     (CRASHLOG_HEADER_SIZE + CRASHLOG_EVENTS * CRASHLOG_EVENT_SIZE)
+
+/* Causes, faults use their exception number */
+#define CRASHLOG_CAUSE_NONE       0x00
+#define CRASHLOG_CAUSE_NMI        0x02
+#define CRASHLOG_CAUSE_HARDFAULT  0x03
+#define CRASHLOG_CAUSE_MEMMANAGE  0x04
+#define CRASHLOG_CAUSE_BUSFAULT   0x05
+#define CRASHLOG_CAUSE_USAGEFAULT 0x06
+#define CRASHLOG_CAUSE_ERROR      0x80  // Error_Handler(), HAL setup failed
+#define CRASHLOG_CAUSE_I2C_ERROR  0x81  // I2C_Error_Handler()
+#define CRASHLOG_CAUSE_WATCHDOG   0x82  // watchdog reset, events only, see watchdog.h
+
+/* Flight recorder events, arg and data as noted */
+#define CRASHLOG_EV_BOOT          0x01  // arg: cause of the dump held, data: 0
+#define CRASHLOG_EV_KEY_QUEUED    0x02  // arg: key, data: keys queued
+#define CRASHLOG_EV_KEY_DROPPED   0x03  // arg: key, queue full
+#define CRASHLOG_EV_IRQ_PULSE     0x04  // data: events reported by the pulse
+#define CRASHLOG_EV_I2C_ADDR      0x05  // arg: direction, data: register
+#define CRASHLOG_EV_I2C_WRITE     0x06  // arg: register, data: bytes
+#define CRASHLOG_EV_KEY_DELIVERED 0x07  // arg: key
+#define CRASHLOG_EV_I2C_ERROR     0x08  // data: HAL error code
+#define CRASHLOG_EV_I2C_RESTART   0x09  // listening restarted after an error
+#define CRASHLOG_EV_CONFIG_SAVE   0x0A  // data: parameters written, one bit each
+#define CRASHLOG_EV_KEYMAP_SAVE   0x0B  // arg: 1 save, 0 erase
+#define CRASHLOG_EV_WATCHDOG      0x0C  // watchdog reset that kept the unread dump, arg: crashes
+
+/* REG_CRASH_CTRL commands */
+#define CRASHLOG_CMD_CLEAR 0x02  // forget the dump once the host has it
+
+/* REG_CRASH_CTRL status */
+#define CRASHLOG_STATE_EMPTY 0x00
+#define CRASHLOG_STATE_DUMP  0x01
+
+void crashlog_init(void);
+void crashlog_event(uint8_t type, uint8_t arg, uint16_t data);
+void crashlog_fault(const uint32_t *frame, uint32_t exc_return) __attribute__((noreturn));
+void crashlog_error(uint8_t cause, uint32_t caller) __attribute__((noreturn));
+void crashlog_command(uint8_t cmd);
+uint8_t crashlog_get_status(uint8_t *buf);
+uint8_t crashlog_read(uint16_t offset, uint8_t *buf, uint8_t size);
+
+#endif /* INC_CRASHLOG_H_ */
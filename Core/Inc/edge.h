@@ -0,0 +1,55 @@
+/**
+ * Blackberry Q10 keyboard STM32 driver
+ * A fun little weekend project to act as a BBQ10 STM32 driver that is able to communicate with I2C bus masters.
+ * Creates rising-edge IRQ pulse, sends pressed character over I2C when master reads from slave upon receiving interrupt.
+ *
+ * Copyright (C) 2025 Mustafa Ozcelikors
+ *
+ * See GPLv3 LICENSE file in repository for licensing details.
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#ifndef INC_EDGE_H_
+#define INC_EDGE_H_
+
+#include "stm32f4xx_hal.h"
+#include "keyboard.h"
+
+/* Row edge timestamps, enabled with CFG_EDGE_STAMP.
+ *
+ * Between two scans the columns are parked low, so a key going down pulls its
+ * row low right away. That falling edge interrupts through the row's EXTI
+ * line and the handler stamps it on the cycle counter, the first edge per row
+ * only, bounces after it are ignored. The next scan disarms the lines, takes
+ * the stamps and, when it finds a key newly pressed on a stamped row, gives
+ * the key that stamp instead of its own start. A key is then timed to within
+ * the interrupt latency rather than to the scan period.
+ *
+ * No edge is seen for a row a held key already keeps low, and rows without an
+ * EXTI line of their own (BOARD_EDGE_ROWS) are never stamped; keys on those
+ * keep the time of the scan that found them. */
+
+#define EDGE_STAMP_ENABLE 0  // CFG_EDGE_STAMP default, parked columns and EXTI off
+
+void edge_init(void);
+
+/* Main loop, around the scan: edge_arm() parks the columns and lets the rows
+ * interrupt, edge_disarm() undoes that and returns the rows with an edge since,
+ * their stamps (timebase_now() cycles) in stamps[] */
+void edge_arm(void);
+board_row_mask_t edge_disarm(uint32_t stamps[NUM_ROWS]);
+uint8_t edge_parked(void);  // columns parked since the last scan
+
+#endif /* INC_EDGE_H_ */
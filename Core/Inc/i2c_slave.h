@@ -28,18 +28,38 @@
 
 #define KEYBOARD_I2C_ADDRESS (0x52)
 
+/* Transfer buffers, a master write is register address + up to I2C_RX_BUF_SIZE - 1 data bytes */
+#define I2C_RX_BUF_SIZE 32
+#define I2C_TX_BUF_SIZE 32
+
+/* Key event queue between deferred decode (producer) and I2C ISR (consumer) */
+#define KEY_FIFO_SIZE 16  // must be a power of two
+
+/* Host interrupt moderation defaults
+ * Host IRQ is asserted once IRQ_COALESCE_EVENTS events are pending or the oldest
+ * unreported event is IRQ_COALESCE_TIMEOUT_US old, whichever comes first.
+ * Setting either to 0 selects immediate mode (one pulse per event). */
+#define IRQ_COALESCE_EVENTS     4
+#define IRQ_COALESCE_TIMEOUT_US 10000
+
+/* Width of the IRQ_KEYCHANGED pulse */
+#define IRQ_PULSE_MS 2
+
 extern I2C_HandleTypeDef hi2c1;
 
-extern uint8_t I2C_RxData[1];
+extern uint8_t I2C_RxData[I2C_RX_BUF_SIZE];
 
 // volatile because accessed from ISR
-extern volatile uint8_t I2C_TxData[1];
+extern volatile uint8_t I2C_TxData[I2C_TX_BUF_SIZE];
 extern volatile uint8_t i2c_busy;
 
 void MX_I2C1_Init_Slave(void);
 void HAL_I2C_SlaveTxCpltCallback(I2C_HandleTypeDef *hi2c);
-void wait_i2c_busy(void);
-void set_i2c_txdata(char c);
+void set_i2c_txdata(char c, uint32_t stamp);
 void create_keychanged_irq_pulse(void);
+void i2c_irq_pulse_tick(void);
+void i2c_watchdog_tick(void);
+void i2c_irq_moderation_poll(void);
+void i2c_service(void);
 
 #endif /* INC_I2C_SLAVE_H_ */
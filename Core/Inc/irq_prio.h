@@ -0,0 +1,54 @@
+/**
+ * Blackberry Q10 keyboard STM32 driver
+ * A fun little weekend project to act as a BBQ10 STM32 driver that is able to communicate with I2C bus masters.
+ * Creates rising-edge IRQ pulse, sends pressed character over I2C when master reads from slave upon receiving interrupt.
+ *
+ * Copyright (C) 2025 Mustafa Ozcelikors
+ *
+ * See GPLv3 LICENSE file in repository for licensing details.
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#ifndef INC_IRQ_PRIO_H_
+#define INC_IRQ_PRIO_H_
+
+#include "stm32f4xx_hal.h"
+
+/* Interrupt priorities, preemption only (NVIC_PRIORITYGROUP_4), 0 is highest.
+ *
+ *   IRQ_PRIO_I2C       I2C1 event and error, the byte handling the bus waits
+ *                      on. Besides the row edges below only the benchmark
+ *                      ISR entry probe, which stands in for an I2C event,
+ *                      runs at this level.
+ *   IRQ_PRIO_EDGE      EXTI row edges (edge.c), same level: a stamp may wait
+ *                      for one I2C handler but never delays one.
+ *   IRQ_PRIO_TICK      SysTick: the time base that paces the scan and the
+ *                      end of the IRQ_KEYCHANGED pulse (TICK_INT_PRIORITY).
+ *   IRQ_PRIO_DEFERRED  PendSV: decode, key queueing and interrupt moderation,
+ *                      pended by the main loop after each scan.
+ *
+ * The main loop (thread mode) scans the matrix and does the flash work.
+ * Sections that mask interrupts are kept short, apart from those the I2C
+ * ISR only ever waits for another I2C event. */
+#define IRQ_PRIO_I2C      0
+#define IRQ_PRIO_EDGE     IRQ_PRIO_I2C
+#define IRQ_PRIO_TICK     1
+#define IRQ_PRIO_DEFERRED 15
+
+#if defined(TICK_INT_PRIORITY) && (TICK_INT_PRIORITY != IRQ_PRIO_TICK)
+#error "TICK_INT_PRIORITY in stm32f4xx_hal_conf.h must match IRQ_PRIO_TICK"
+#endif
+
+#endif /* INC_IRQ_PRIO_H_ */
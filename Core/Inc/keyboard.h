@@ -26,6 +26,50 @@
 
 #include "stm32f4xx_hal.h"
 
+/* Matrix size, pinout and default keymap, generated from board/<board>.txt */
+#include "board_gen.h"
+
+/* Special characters */
+#define S_ALT    'a'
+#define S_ENTER  '\n'
+#define S_BACK   '\r'
+#define S_LSHIFT 'l'
+#define S_RSHIFT 'r'
+#define S_UNUSED  0
+#define S_SYM    'c'
+
+/* Scan timing defaults, tunable at runtime through the config store */
+#define KEYBOARD_SCAN_INTERVAL_MS 1     // delay between two scans
+#define KEYBOARD_COL_SETTLE_US    1000  // settle time after driving a column
+#define KEYBOARD_COL_SETTLE_AUTO  1     // calibrate the settle time per column at boot
+#define KEYBOARD_PARTIAL_SCAN     0     // resolve a lone active row without scanning every column
+#define PRESS_AND_HOLD_MS         350   // hold time before a key repeats
+#define SYM_DEBOUNCE_MS           500   // caps lock toggle debounce
+
+/* Settle time calibration: with a column driven low, each row is discharged
+ * and timed while its pull-up brings it back. A column's settle time is twice
+ * its slowest row plus the margin, bounded by CFG_COL_SETTLE_US. */
+#define KEYBOARD_SETTLE_MARGIN_US 2     // added to twice the measured time
+#define KEYBOARD_SETTLE_REPEATS   3     // measurements per row, the slowest counts
+
+/* Partial scan: with every column driven low at once, the rows that read low
+ * are those with a key down. No row ends the scan there. A single row has its
+ * columns halved until the one pulling it low is left, which must then be the
+ * only one. Several rows, or several keys on the row, take the full scan. */
+
+/* Key state snapshot: packed key bitmap (bit r * NUM_COLS + c) followed by modifier byte */
+#define KEYBOARD_BITMAP_SIZE (((NUM_ROWS * NUM_COLS) + 7) / 8)
+#define KEYBOARD_STATE_SIZE  (KEYBOARD_BITMAP_SIZE + 1)
+
+/* Modifier byte bits */
+#define KEY_MOD_ALT         (1 << 0)  // alt held
+#define KEY_MOD_LSHIFT      (1 << 1)  // left shift held
+#define KEY_MOD_RSHIFT      (1 << 2)  // right shift held
+#define KEY_MOD_SYM         (1 << 3)  // sym held
+#define KEY_MOD_ALT_LATCH   (1 << 4)  // alt applies to next key
+#define KEY_MOD_SHIFT_LATCH (1 << 5)  // shift applies to next key
+#define KEY_MOD_CAPS_LOCK   (1 << 6)  // caps lock mode active
+
 /* Keyboard States */
 // Following is volatile mostly because of live debugging purposes
 extern volatile char last_pressed_key;
@@ -35,5 +79,8 @@ void keyboard_init(void);
 void keyboard_scan(void);
 char keyboard_find_key(void);
 uint8_t keyboard_is_key_changed();
+uint32_t keyboard_key_stamp(void);  // timebase_now() cycles the key of the last scan went down, see edge.h
+uint8_t keyboard_get_state(uint8_t *buf);
+uint8_t keyboard_get_settle(uint8_t *buf);
 
 #endif /* INC_KEYBOARD_H_ */
@@ -0,0 +1,63 @@
+/**
+ * Blackberry Q10 keyboard STM32 driver
+ * A fun little weekend project to act as a BBQ10 STM32 driver that is able to communicate with I2C bus masters.
+ * Creates rising-edge IRQ pulse, sends pressed character over I2C when master reads from slave upon receiving interrupt.
+ *
+ * Copyright (C) 2025 Mustafa Ozcelikors
+ *
+ * See GPLv3 LICENSE file in repository for licensing details.
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#ifndef INC_KEYMAP_H_
+#define INC_KEYMAP_H_
+
+#include "stm32f4xx_hal.h"
+#include "keyboard.h"
+
+/* Keymap, primary layer followed by alternate (alt) layer, 0 = no character */
+typedef struct
+{
+    char primary[NUM_ROWS][NUM_COLS];
+    char alt[NUM_ROWS][NUM_COLS];
+} keymap_t;
+
+#define KEYMAP_SIZE (sizeof(keymap_t))
+
+/* REG_KEYMAP_CTRL commands */
+#define KEYMAP_CMD_ACTIVATE 0x01  // verify CRC of uploaded keymap in the main loop, activate and store it
+#define KEYMAP_CMD_DEFAULT  0x02  // revert to built-in keymap and clear the flash slot
+
+/* REG_KEYMAP_CTRL status */
+#define KEYMAP_STATUS_IDLE      0x00
+#define KEYMAP_STATUS_OK        0x01
+#define KEYMAP_STATUS_BAD_CRC   0x02
+#define KEYMAP_STATUS_BUSY      0x03  // upload being checked or flash slot being written, commands meanwhile are dropped
+#define KEYMAP_STATUS_FLASH_ERR 0x04
+
+/* Flash slot, sector 5. Written as header + keymap, magic word programmed last */
+#define KEYMAP_SLOT_ADDR   0x08020000U
+#define KEYMAP_SLOT_SECTOR FLASH_SECTOR_5
+#define KEYMAP_SLOT_MAGIC  0x50414D4BU  // "KMAP"
+
+void keymap_init(void);
+const keymap_t *keymap_active(void);
+uint8_t keymap_read(uint8_t offset, uint8_t *buf, uint8_t size);
+void keymap_write(uint8_t offset, const uint8_t *data, uint8_t len);
+void keymap_command(uint8_t cmd, uint16_t crc);
+uint8_t keymap_get_status(uint8_t *buf);
+void keymap_service(void);
+
+#endif /* INC_KEYMAP_H_ */
@@ -0,0 +1,52 @@
+/**
+ * Blackberry Q10 keyboard STM32 driver
+ * A fun little weekend project to act as a BBQ10 STM32 driver that is able to communicate with I2C bus masters.
+ * Creates rising-edge IRQ pulse, sends pressed character over I2C when master reads from slave upon receiving interrupt.
+ *
+ * Copyright (C) 2025 Mustafa Ozcelikors
+ *
+ * See GPLv3 LICENSE file in repository for licensing details.
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#ifndef INC_RAMCODE_H_
+#define INC_RAMCODE_H_
+
+#include "stm32f4xx_hal.h"
+
+/* Optional SRAM placement of the hot paths, for clocks where flash wait
+ * states and ART misses start to show. Both are off by default, the build
+ * turns them on (make HOT_CODE_IN_RAM=1 VECTORS_IN_RAM=1, see firmware.mk):
+ *
+ *   HOT_CODE_IN_RAM  functions marked HOT_CODE go to .RamFunc, which the
+ *                    linker script places in .data, so the startup code
+ *                    copies them to SRAM with the initialized data. Calls
+ *                    between flash and SRAM go through linker veneers.
+ *   VECTORS_IN_RAM   ramcode_init() copies the vector table to SRAM and
+ *                    points VTOR at it.
+ *
+ * The HAL's own handlers stay in flash. Compare with the REG_BENCH_* probes,
+ * an SRAM vector table also makes the vector fetch share the bus with the
+ * exception stacking. */
+
+#ifdef HOT_CODE_IN_RAM
+#define HOT_CODE __attribute__((section(".RamFunc"), noinline))
+#else
+#define HOT_CODE
+#endif
+
+void ramcode_init(void);
+
+#endif /* INC_RAMCODE_H_ */
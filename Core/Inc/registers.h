@@ -0,0 +1,60 @@
+/**
+ * Blackberry Q10 keyboard STM32 driver
+ * A fun little weekend project to act as a BBQ10 STM32 driver that is able to communicate with I2C bus masters.
+ * Creates rising-edge IRQ pulse, sends pressed character over I2C when master reads from slave upon receiving interrupt.
+ *
+ * Copyright (C) 2025 Mustafa Ozcelikors
+ *
+ * See GPLv3 LICENSE file in repository for licensing details.
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#ifndef INC_REGISTERS_H_
+#define INC_REGISTERS_H_
+
+#include "stm32f4xx_hal.h"
+
+/* I2C register map
+ * A master write selects a register with its first byte, any further bytes are
+ * written to that register. The next master read returns the selected register,
+ * after which the selection falls back to REG_KEY. A plain 1-byte read without a
+ * preceding write therefore keeps returning queued keys. */
+#define REG_KEY        0x00  // R,  1 byte: oldest queued key, 0 if empty
+#define REG_KEY_STATE  0x01  // R,  KEYBOARD_STATE_SIZE bytes: key bitmap + modifier byte
+#define REG_KEY_STAMPED 0x02 // R,  5 bytes: oldest queued key as REG_KEY, then when it went down in us since boot, 32-bit
+#define REG_CONFIG     0x10  // RW, write [id] selects, [id, lo, hi] sets and persists, read returns [lo, hi]
+#define REG_KEYMAP_DATA 0x20 // RW, write [offset, data...] uploads, [offset] selects, read returns active keymap from offset
+#define REG_KEYMAP_CTRL 0x21 // RW, write [cmd, crc lo, crc hi], read returns [status, active crc lo, hi]
+#define REG_CAPTURE_CTRL 0x30 // RW, write [cmd], read returns [state, flags, image size lo, hi]
+#define REG_CAPTURE_DATA 0x31 // RW, write [offset lo, hi] selects, read returns capture image from offset
+#define REG_BENCH_CTRL  0x40  // RW, write [cmd], read returns [state, probes, buckets, bucket shift]
+#define REG_BENCH_DATA  0x41  // RW, write [probe] selects, read returns [count, min, max, mean] in cycles, 32-bit each
+#define REG_BENCH_HIST  0x42  // RW, write [probe] selects, read returns the probe's histogram, 16-bit per bucket
+#define REG_CRASH_CTRL  0x50  // RW, write [cmd], read returns [state, cause, image size lo, hi, crashes]
+#define REG_CRASH_DATA  0x51  // RW, write [offset lo, hi] selects, read returns the crash dump from offset
+#define REG_BOOT_REASON 0x60  // R,  2 bytes: reset cause, RCC reset flags (RCC_CSR bits 31-24)
+#define REG_STATS_CTRL  0x70  // RW, write [cmd] takes a snapshot, read returns [counters, snapshots taken]
+#define REG_STATS_DATA  0x71  // RW, write [offset] selects, read returns the snapshot from offset
+#define REG_TRACE_CTRL  0x80  // RW, write [cmd], read returns [records written lo, hi, ring records, record size]
+#define REG_TRACE_DATA  0x81  // RW, write [slot] selects, read returns trace records from that ring slot
+#define REG_CPU_LOAD    0x90  // R,  18 bytes: CPU load of the last window, see cpuload.h
+#define REG_SELFTEST_CTRL 0xA0 // RW, write [cmd] starts the matrix self-test, read returns [status, faults, result size]
+#define REG_SELFTEST_DATA 0xA1 // RW, write [offset] selects, read returns the self-test result from offset
+#define REG_COL_SETTLE  0xB0  // R,  2 * NUM_COLS bytes: settle time per column in us, 16-bit each
+
+uint8_t registers_read(uint8_t reg, uint8_t *buf, uint8_t size);
+void registers_write(uint8_t reg, const uint8_t *data, uint8_t len);
+
+#endif /* INC_REGISTERS_H_ */
@@ -0,0 +1,84 @@
+/**
+ * Blackberry Q10 keyboard STM32 driver
+ * A fun little weekend project to act as a BBQ10 STM32 driver that is able to communicate with I2C bus masters.
+ * Creates rising-edge IRQ pulse, sends pressed character over I2C when master reads from slave upon receiving interrupt.
+ *
+ * Copyright (C) 2025 Mustafa Ozcelikors
+ *
+ * See GPLv3 LICENSE file in repository for licensing details.
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#ifndef INC_SELFTEST_H_
+#define INC_SELFTEST_H_
+
+#include "stm32f4xx_hal.h"
+#include "keyboard.h"
+
+/* Matrix self-test for production and wiring diagnostics, started over I2C
+ * (REG_SELFTEST_CTRL, tools/selftest_read.py) with nothing pressed.
+ *
+ * The test borrows the matrix from the scan for one line per main loop
+ * iteration, so the I2C, the decode and the watchdog carry on. It checks
+ *   idle     every row reads high and every column reads back high
+ *   columns  each column driven low alone pulls no row low and reads back low
+ *   col/col  each column driven low with the others as pulled-up inputs
+ *   row/row  each row driven low with the others as pulled-up inputs
+ * and takes some 2 * NUM_COLS + NUM_ROWS + 1 iterations, a few tens of ms.
+ * A line that is not connected at all reads like a good one, so the scans
+ * after the test clear the lines they see a key on: a line still unseen
+ * once every key has been pressed once is open.
+ *
+ * Result layout, as returned by REG_SELFTEST_DATA, masks 32-bit little endian:
+ *   0   status, see below
+ *   1   fault flags, see below
+ *   2   NUM_ROWS
+ *   3   NUM_COLS
+ *   4   stuck rows: low while idle or not driven low
+ *   8   stuck columns: low while driven high or high while driven low
+ *   12  rows shorted to another row
+ *   16  columns shorted to another column
+ *   20  rows no key has been seen on since the test, open if pressed
+ *   24  columns no key has been seen on since the test, open if pressed
+ *   28  test duration in us
+ *   32  per column the rows it pulled low with nothing pressed: a key stuck
+ *       closed or a row/column short, NUM_COLS masks
+ * The result is consistent once the status is no longer running. */
+
+#define SELFTEST_SIZE (32 + 4 * NUM_COLS)
+
+/* REG_SELFTEST_CTRL commands, applied by the main loop at the next scan */
+#define SELFTEST_CMD_START 0x01
+
+/* REG_SELFTEST_CTRL status */
+#define SELFTEST_STATE_IDLE    0x00  // no test since reset
+#define SELFTEST_STATE_RUNNING 0x01
+#define SELFTEST_STATE_PASS    0x02
+#define SELFTEST_STATE_FAIL    0x03
+
+/* Fault flags, one per non-empty mask of the result */
+#define SELFTEST_FAULT_STUCK_ROW (1 << 0)
+#define SELFTEST_FAULT_STUCK_COL (1 << 1)
+#define SELFTEST_FAULT_ROW_SHORT (1 << 2)
+#define SELFTEST_FAULT_COL_SHORT (1 << 3)
+#define SELFTEST_FAULT_CLOSED    (1 << 4)
+
+uint8_t selftest_step(void);
+void selftest_observe(const board_row_mask_t rows[NUM_COLS]);
+void selftest_command(uint8_t cmd);
+uint8_t selftest_get_status(uint8_t *buf);
+uint8_t selftest_read(uint8_t offset, uint8_t *buf, uint8_t size);
+
+#endif /* INC_SELFTEST_H_ */
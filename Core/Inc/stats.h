@@ -0,0 +1,90 @@
+/**
+ * Blackberry Q10 keyboard STM32 driver
+ * A fun little weekend project to act as a BBQ10 STM32 driver that is able to communicate with I2C bus masters.
+ * Creates rising-edge IRQ pulse, sends pressed character over I2C when master reads from slave upon receiving interrupt.
+ *
+ * Copyright (C) 2025 Mustafa Ozcelikors
+ *
+ * See GPLv3 LICENSE file in repository for licensing details.
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#ifndef INC_STATS_H_
+#define INC_STATS_H_
+
+#include "stm32f4xx_hal.h"
+
+/* Always-on performance counters, read out over I2C (tools/stats_read.py).
+ *
+ * Every counter has exactly one writer context, so counting is a plain
+ * increment with no masking: main loop (M), deferred decode in PendSV (D) or
+ * the I2C ISR (I). The host takes a snapshot with REG_STATS_CTRL, optionally
+ * clearing the counters, and reads it from REG_STATS_DATA. A clear never
+ * writes a running counter, it moves the baseline the next snapshot is taken
+ * against, so an increment the I2C ISR preempted is not lost. Levels (scan
+ * min/max, FIFO high-water) are restarted directly; an update racing the
+ * clear lands in the new period, which it also belongs to.
+ *
+ * Snapshot layout, 32-bit little endian, in the order of the ids below. */
+
+#define STATS_ELAPSED_MS      0   // time covered by the snapshot
+#define STATS_IDLE_MS         1   // M, waiting out the scan interval
+#define STATS_SCANS           2   // M
+#define STATS_SCAN_MIN        3   // M, level, cycles, 0 without scans
+#define STATS_SCAN_MAX        4   // M, level, cycles
+#define STATS_KEYS_QUEUED     5   // D
+#define STATS_KEYS_DELIVERED  6   // I, the master NACKed the end of the key read
+#define STATS_KEYS_DROPPED    7   // D, key FIFO full
+#define STATS_FIFO_HIGH_WATER 8   // D, level, most keys queued at once
+#define STATS_I2C_ADDR        9   // I, address matches
+#define STATS_I2C_READS       10  // I
+#define STATS_I2C_WRITES      11  // I, with at least the register byte
+#define STATS_I2C_NACKS       12  // I, reads the master ended before the end of the register
+#define STATS_I2C_BUS_ERRORS  13  // I, bus errors, arbitration losses, overruns
+#define STATS_I2C_RECOVERIES  14  // M, listening restarted after a bus error
+#define STATS_IRQ_PULSES      15  // D, IRQ_KEYCHANGED assertions
+#define STATS_NUM_COUNTERS    16
+
+#define STATS_SIZE (STATS_NUM_COUNTERS * 4)
+
+/* REG_STATS_CTRL commands, applied at once */
+#define STATS_CMD_SNAPSHOT       0x01
+#define STATS_CMD_SNAPSHOT_CLEAR 0x02  // snapshot, then start a new period
+
+extern volatile uint32_t stats_counter[STATS_NUM_COUNTERS];
+
+static inline void stats_count(uint8_t id)
+{
+    stats_counter[id]++;
+}
+
+static inline void stats_add(uint8_t id, uint32_t n)
+{
+    stats_counter[id] += n;
+}
+
+static inline void stats_level(uint8_t id, uint32_t level)
+{
+    if (level > stats_counter[id])
+        stats_counter[id] = level;
+}
+
+void stats_init(void);
+void stats_scan(uint32_t cycles);
+void stats_command(uint8_t cmd);
+uint8_t stats_get_status(uint8_t *buf);
+uint8_t stats_read(uint8_t offset, uint8_t *buf, uint8_t size);
+
+#endif /* INC_STATS_H_ */
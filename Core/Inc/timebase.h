@@ -0,0 +1,46 @@
+/**
+ * Blackberry Q10 keyboard STM32 driver
+ * A fun little weekend project to act as a BBQ10 STM32 driver that is able to communicate with I2C bus masters.
+ * Creates rising-edge IRQ pulse, sends pressed character over I2C when master reads from slave upon receiving interrupt.
+ *
+ * Copyright (C) 2025 Mustafa Ozcelikors
+ *
+ * See GPLv3 LICENSE file in repository for licensing details.
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#ifndef INC_TIMEBASE_H_
+#define INC_TIMEBASE_H_
+
+#include "stm32f4xx_hal.h"
+
+/* Microsecond timebase built on the Cortex-M4 DWT cycle counter.
+ * Timestamps are raw CPU cycles, so only differences shorter than
+ * 2^32 cycles (~268 s at 16 MHz) are meaningful.
+ *
+ * timebase_us() turns a timestamp into microseconds since timebase_init(),
+ * for values that leave the chip. It keeps a base it moves up to the current
+ * time, so it has one caller context, the deferred decode, which runs at
+ * least every main loop iteration and keeps the base from falling a counter
+ * wrap behind. The timestamp may be up to 2^31 cycles old; the result wraps
+ * at 2^32 us (~71 min). */
+
+void timebase_init(void);
+uint32_t timebase_now(void);
+uint32_t timebase_elapsed_us(uint32_t since);
+void timebase_delay_us(uint32_t us);
+uint32_t timebase_us(uint32_t stamp);
+
+#endif /* INC_TIMEBASE_H_ */
@@ -0,0 +1,74 @@
+/**
+ * Blackberry Q10 keyboard STM32 driver
+ * A fun little weekend project to act as a BBQ10 STM32 driver that is able to communicate with I2C bus masters.
+ * Creates rising-edge IRQ pulse, sends pressed character over I2C when master reads from slave upon receiving interrupt.
+ *
+ * Copyright (C) 2025 Mustafa Ozcelikors
+ *
+ * See GPLv3 LICENSE file in repository for licensing details.
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#ifndef INC_TRACE_H_
+#define INC_TRACE_H_
+
+#include "stm32f4xx_hal.h"
+
+/* Deferred formatting trace, cheap enough for ISRs and field builds.
+ *
+ *   TRACE("i2c: error 0x%x", hi2c->ErrorCode);
+ *
+ * The format string goes to .trace_fmt, which the linker script keeps in the
+ * ELF but never loads, at address 0, so the string's address is its 16-bit
+ * id. A trace point only stores the id, the cycle counter and up to two
+ * 32-bit arguments in a RAM ring, and mirrors the record to ITM stimulus
+ * port TRACE_ITM_PORT while a debugger has ITM enabled and the stimulus FIFO
+ * has room, a trace point never waits for SWO. tools/trace_decode.py
+ * reads the ring over I2C (REG_TRACE_*) or an SWO capture and formats the
+ * records with the strings from the ELF. Arguments are formatted as
+ * integers: %d, %u, %x, %c and friends, no %s or floating point.
+ *
+ * Record layout, 32-bit words little endian, also the order written to ITM:
+ *   0   id (bits 31-16), argument count (bits 15-8), sequence (bits 7-0)
+ *   4   cycle counter
+ *   8   arguments, unused ones 0 */
+
+#define TRACE_RECORDS     64  // must be a power of two
+#define TRACE_RECORD_SIZE 16
+#define TRACE_MAX_ARGS    2
+#define TRACE_ITM_PORT    1   // port 0 is left to printf style retargeting
+
+/* REG_TRACE_CTRL commands */
+#define TRACE_CMD_CLEAR 0x01
+
+// Argument count, 3 only to fail the assertion below
+#define TRACE_NARGS_(...) TRACE_NARGS2_(0, ##__VA_ARGS__, 3, 2, 1, 0)
+#define TRACE_NARGS2_(_0, _1, _2, _3, n, ...) n
+
+#define TRACE_(fmt, n, a0, a1, ...) do { \
+    static const char trace_fmt_[] __attribute__((section(".trace_fmt"), used)) = fmt; \
+    _Static_assert(n <= TRACE_MAX_ARGS, "at most two trace arguments"); \
+    trace_write(((uint32_t)(uint16_t)(uintptr_t)trace_fmt_ << 16) | ((n) << 8), \
+                (uint32_t)(a0), (uint32_t)(a1)); \
+} while (0)
+
+#define TRACE(fmt, ...) TRACE_(fmt, TRACE_NARGS_(__VA_ARGS__), ##__VA_ARGS__, 0, 0)
+
+void trace_write(uint32_t header, uint32_t arg0, uint32_t arg1);
+void trace_command(uint8_t cmd);
+uint8_t trace_get_status(uint8_t *buf);
+uint8_t trace_read(uint8_t slot, uint8_t *buf, uint8_t size);
+
+#endif /* INC_TRACE_H_ */
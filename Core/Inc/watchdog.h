@@ -0,0 +1,66 @@
+/**
+ * Blackberry Q10 keyboard STM32 driver
+ * A fun little weekend project to act as a BBQ10 STM32 driver that is able to communicate with I2C bus masters.
+ * Creates rising-edge IRQ pulse, sends pressed character over I2C when master reads from slave upon receiving interrupt.
+ *
+ * Copyright (C) 2025 Mustafa Ozcelikors
+ *
+ * See GPLv3 LICENSE file in repository for licensing details.
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#ifndef INC_WATCHDOG_H_
+#define INC_WATCHDOG_H_
+
+#include "stm32f4xx_hal.h"
+
+/* Independent watchdog supervisor and reset cause.
+ *
+ * The IWDG runs from the LSI and resets the chip unless it is reloaded in
+ * time. It is reloaded from SysTick only while every supervised pipeline has
+ * shown progress within the deadline the caller of watchdog_tick() gives, so
+ * a stuck main loop, a stuck deferred decode, an I2C transfer that never ends
+ * or an interrupt storm that starves SysTick all end in a reset after
+ * deadline + WATCHDOG_TIMEOUT_MS. Flash erases stall the CPU for longer than
+ * that and are bracketed with watchdog_stall_begin()/watchdog_stall_end().
+ *
+ * Watchdog timeouts are nominal, the LSI is only specified to 17-47 kHz. */
+
+#define WATCHDOG_TIMEOUT_MS 250   // IWDG period
+#define WATCHDOG_STALL_MS   4000  // IWDG period during a flash sector erase
+#define WATCHDOG_MARGIN_MS  100   // slack on top of a pipeline's own deadline
+
+/* Supervised pipelines */
+#define WATCHDOG_SCAN     0  // matrix scan and deferred decode
+#define WATCHDOG_I2C      1  // I2C slave back to listening
+#define WATCHDOG_CHANNELS 2
+
+/* Reset cause, as read by REG_BOOT_REASON */
+#define WATCHDOG_BOOT_POWER_ON  0x00
+#define WATCHDOG_BOOT_PIN       0x01  // NRST
+#define WATCHDOG_BOOT_SOFTWARE  0x02  // NVIC_SystemReset(), also after a crash dump
+#define WATCHDOG_BOOT_WATCHDOG  0x03  // IWDG or WWDG
+#define WATCHDOG_BOOT_BROWNOUT  0x04
+#define WATCHDOG_BOOT_LOW_POWER 0x05
+
+void watchdog_init(void);
+uint8_t watchdog_boot_reason(void);
+uint8_t watchdog_get_status(uint8_t *buf);
+void watchdog_progress(uint8_t channel);
+void watchdog_tick(uint32_t deadline_ms);
+void watchdog_stall_begin(void);
+void watchdog_stall_end(void);
+
+#endif /* INC_WATCHDOG_H_ */
@@ -0,0 +1,164 @@
+/**
+ * Blackberry Q10 keyboard STM32 driver
+ * A fun little weekend project to act as a BBQ10 STM32 driver that is able to communicate with I2C bus masters.
+ * Creates rising-edge IRQ pulse, sends pressed character over I2C when master reads from slave upon receiving interrupt.
+ *
+ * Copyright (C) 2025 Mustafa Ozcelikors
+ *
+ * See GPLv3 LICENSE file in repository for licensing details.
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#include "app.h"
+#include "bench.h"
+#include "config.h"
+#include "cpuload.h"
+#include "crashlog.h"
+#include "edge.h"
+#include "keyboard.h"
+#include "keymap.h"
+#include "i2c_slave.h"
+#include "irq_prio.h"
+#include "ramcode.h"
+#include "stats.h"
+#include "timebase.h"
+#include "watchdog.h"
+
+// Start and end of the last scan, for the key latency probes of the deferred decode
+static uint32_t app_scan_start = 0;
+static uint32_t app_scan_end = 0;
+
+static void app_defer(void)
+{
+    // Pend the decode, taken right away when nothing above thread mode is active
+    SCB->ICSR = SCB_ICSR_PENDSVSET_Msk;
+    __DSB();
+    __ISB();
+}
+
+void app_init(void)
+{
+    ramcode_init();
+
+    timebase_init();
+
+    watchdog_init();
+
+    crashlog_init();
+
+    config_init();
+
+    keymap_init();
+
+    MX_I2C1_Init_Slave();
+
+    keyboard_init();
+
+    edge_init();
+
+    bench_init();
+
+    stats_init();
+
+    cpuload_init();
+
+    // Decode and queueing run below everything else (irq_prio.h)
+    HAL_NVIC_SetPriority(PendSV_IRQn, IRQ_PRIO_DEFERRED, 0);
+}
+
+void app_step(void)
+{
+    // One main loop iteration: scan, decode and queue in PendSV, then background work
+    uint32_t scan_start = timebase_now();
+    uint32_t scan_end;
+    uint32_t idle_start;
+    cpuload_frame_t idle;
+
+    keyboard_scan();
+    scan_end = timebase_now();
+    stats_scan(scan_end - scan_start);
+    bench_record(BENCH_SCAN, scan_start);
+
+    app_scan_start = scan_start;
+    app_scan_end = scan_end;
+    app_defer();
+
+    bench_poll();
+
+    i2c_service();
+
+    config_service();
+
+    keymap_service();
+
+    idle_start = HAL_GetTick();
+    idle = cpuload_enter();
+    HAL_Delay(config_get(CFG_SCAN_INTERVAL_MS)); // debounce/scan interval
+    cpuload_idle_end(idle);
+    stats_add(STATS_IDLE_MS, HAL_GetTick() - idle_start);
+}
+
+HOT_CODE void PendSV_Handler(void)
+{
+    cpuload_frame_t frame = cpuload_enter();
+
+    // Keeps the microsecond base moving while no key needs it
+    (void)timebase_us(timebase_now());
+
+    // Deferred decode of the last scan, preempted by the tick and the I2C ISRs
+    if (keyboard_is_key_changed())
+    {
+        uint32_t find_start = bench_start();
+        char pressed = keyboard_find_key();
+
+        bench_record(BENCH_FIND_KEY, find_start);
+
+        if (pressed)
+        {
+            bench_key_decoded(app_scan_start, app_scan_end);
+            set_i2c_txdata(pressed, timebase_us(keyboard_key_stamp()));
+        }
+    }
+
+    i2c_irq_moderation_poll();
+
+    watchdog_progress(WATCHDOG_SCAN);
+
+    cpuload_exit(CPULOAD_DEFERRED, frame);
+}
+
+static uint32_t app_loop_period_ms(void)
+{
+    // Longest regular main loop iteration: one scan plus the scan interval
+    uint32_t scan_ms = (NUM_COLS * config_get(CFG_COL_SETTLE_US) + 999) / 1000;
+
+    return scan_ms + config_get(CFG_SCAN_INTERVAL_MS);
+}
+
+void HAL_SYSTICK_Callback(void)
+{
+    cpuload_frame_t frame = cpuload_enter();
+
+    // Tick work, the tick itself is counted by HAL_IncTick()
+    i2c_irq_pulse_tick();
+
+    // Both pipelines get back to the main loop once per iteration, where a
+    // bus error is recovered, so that bounds how long either may go quiet
+    i2c_watchdog_tick();
+    watchdog_tick(app_loop_period_ms() + WATCHDOG_MARGIN_MS);
+
+    cpuload_tick();
+    cpuload_exit(CPULOAD_TICK, frame);
+}
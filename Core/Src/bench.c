@@ -0,0 +1,309 @@
+/**
+ * Blackberry Q10 keyboard STM32 driver
+ * A fun little weekend project to act as a BBQ10 STM32 driver that is able to communicate with I2C bus masters.
+ * Creates rising-edge IRQ pulse, sends pressed character over I2C when master reads from slave upon receiving interrupt.
+ *
+ * Copyright (C) 2025 Mustafa Ozcelikors
+ *
+ * See GPLv3 LICENSE file in repository for licensing details.
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#include "bench.h"
+#include "i2c_slave.h"
+#include "irq_prio.h"
+#include "timebase.h"
+#include <string.h>
+
+// Written from every priority level, always with interrupts off
+static bench_stats_t bench_stats[BENCH_NUM_PROBES];
+
+static volatile uint8_t bench_state = BENCH_STATE_STOPPED;
+
+// Deferred decode (PendSV) only: start of the scan that queued the oldest unsignalled key
+static uint32_t bench_key_start = 0;
+static uint8_t bench_key_waiting = 0;
+
+// Deferred decode only: stage times of the key being queued, 0 when not measured
+static uint32_t bench_key_scan_start = 0;
+static uint32_t bench_key_scan_end = 0;
+static uint32_t bench_key_decode_end = 0;
+
+// Stage times per key FIFO slot, 0 when not measured. Written by the deferred
+// decode before the key is published, the I2C ISR only clears scan on delivery
+typedef struct
+{
+    uint32_t scan;    // start of the scan that accepted the key
+    uint32_t queued;  // stored in the FIFO
+    uint32_t irq;     // IRQ edge that signalled it
+} bench_key_t;
+
+static volatile bench_key_t bench_keys[KEY_FIFO_SIZE];
+
+// Deferred decode only: slots queued and not signalled yet
+static uint32_t bench_key_unsignalled = 0;
+
+_Static_assert(KEY_FIFO_SIZE <= 32, "one bit per key FIFO slot");
+
+// Pend time of the ISR entry probe
+static volatile uint32_t bench_pend_time = 0;
+
+static uint8_t bench_bucket(uint32_t cycles)
+{
+    uint8_t bucket;
+
+    if (cycles < (1U << BENCH_HIST_SHIFT))
+        return 0;
+
+    bucket = (uint8_t)(31 - __builtin_clz(cycles) - BENCH_HIST_SHIFT + 1);
+    return bucket < BENCH_HIST_BUCKETS ? bucket : BENCH_HIST_BUCKETS - 1;
+}
+
+static void bench_clear(void)
+{
+    memset(bench_stats, 0, sizeof(bench_stats));
+    for (uint8_t i = 0; i < BENCH_NUM_PROBES; i++)
+        bench_stats[i].min = UINT32_MAX;
+    bench_key_waiting = 0;
+
+    // Keys in flight would straddle the clear
+    for (uint8_t i = 0; i < KEY_FIFO_SIZE; i++)
+        bench_keys[i].scan = 0;
+}
+
+static void put_u32(uint8_t *buf, uint32_t value)
+{
+    buf[0] = (uint8_t)value;
+    buf[1] = (uint8_t)(value >> 8);
+    buf[2] = (uint8_t)(value >> 16);
+    buf[3] = (uint8_t)(value >> 24);
+}
+
+void bench_init(void)
+{
+    bench_clear();
+
+    // Same priority as I2C, so the probe sees what an I2C event would
+    HAL_NVIC_SetPriority(BENCH_IRQn, IRQ_PRIO_I2C, 0);
+    HAL_NVIC_EnableIRQ(BENCH_IRQn);
+}
+
+uint32_t bench_start(void)
+{
+    // 0 when stopped, so a sample that straddles a start is dropped; the
+    // forced low bit costs one cycle of resolution
+    if (bench_state != BENCH_STATE_RUNNING)
+        return 0;
+
+    return timebase_now() | 1;
+}
+
+static void bench_add(uint8_t probe, uint32_t cycles)
+{
+    // Called from the main loop, PendSV and the I2C ISR, masking covers
+    // all of them; a caller's mask is kept
+    uint32_t primask = __get_PRIMASK();
+
+    __disable_irq();
+
+    bench_stats_t *s = &bench_stats[probe];
+    uint8_t bucket = bench_bucket(cycles);
+
+    s->count++;
+    s->total += cycles;
+    if (cycles < s->min)
+        s->min = cycles;
+    if (cycles > s->max)
+        s->max = cycles;
+    if (s->hist[bucket] != UINT16_MAX)
+        s->hist[bucket]++;
+
+    __set_PRIMASK(primask);
+}
+
+void bench_record(uint8_t probe, uint32_t start)
+{
+    if (start == 0 || bench_state != BENCH_STATE_RUNNING)
+        return;
+
+    bench_add(probe, timebase_now() - start);
+}
+
+void bench_key_decoded(uint32_t scan_start, uint32_t scan_end)
+{
+    // Deferred decode, keyboard_find_key() just returned a key
+    bench_key_decode_end = bench_start();
+    bench_key_scan_start = scan_start | 1;
+    bench_key_scan_end = scan_end;
+}
+
+void bench_key_queued(uint8_t slot)
+{
+    volatile bench_key_t *key = &bench_keys[slot];
+    uint32_t decoded = bench_key_decode_end;
+
+    bench_key_decode_end = 0;
+    key->scan = 0;
+    key->irq = 0;
+    if (decoded == 0)
+        return;
+
+    key->queued = bench_start();
+    if (key->queued == 0)
+        return;
+
+    bench_add(BENCH_KEY_SCAN, bench_key_scan_end - bench_key_scan_start);
+    bench_add(BENCH_KEY_DECODE, decoded - bench_key_scan_end);
+    bench_add(BENCH_KEY_QUEUE, key->queued - decoded);
+
+    key->scan = bench_key_scan_start;
+    bench_key_unsignalled |= 1U << slot;
+
+    // Keys are signalled together, the oldest one waited longest
+    if (!bench_key_waiting)
+    {
+        bench_key_start = bench_key_scan_start;
+        bench_key_waiting = 1;
+    }
+}
+
+void bench_key_irq(void)
+{
+    uint32_t now = bench_start();
+
+    for (uint8_t slot = 0; bench_key_unsignalled != 0; slot++)
+    {
+        if (!(bench_key_unsignalled & (1U << slot)))
+            continue;
+
+        bench_key_unsignalled &= ~(1U << slot);
+        if (now != 0 && bench_keys[slot].scan != 0)
+        {
+            bench_keys[slot].irq = now;
+            bench_add(BENCH_KEY_IRQ, now - bench_keys[slot].queued);
+        }
+    }
+
+    if (!bench_key_waiting)
+        return;
+
+    bench_key_waiting = 0;
+    bench_record(BENCH_KEY_TO_IRQ, bench_key_start);
+}
+
+void bench_key_delivered(uint8_t slot)
+{
+    // I2C ISR, the master finished reading the key in this slot
+    volatile bench_key_t *key = &bench_keys[slot];
+    uint32_t scan = key->scan;
+    uint32_t now;
+
+    key->scan = 0;
+    now = bench_start();
+    if (scan == 0 || now == 0)
+        return;
+
+    // A host polling without waiting for the IRQ gets keys before it
+    if (key->irq != 0)
+        bench_add(BENCH_KEY_READ, now - key->irq);
+    bench_add(BENCH_KEY_TOTAL, now - scan);
+}
+
+void bench_poll(void)
+{
+    // One ISR entry sample per main loop iteration
+    if (bench_state != BENCH_STATE_RUNNING)
+        return;
+
+    bench_pend_time = bench_start();
+    HAL_NVIC_SetPendingIRQ(BENCH_IRQn);
+}
+
+void BENCH_IRQHandler(void)
+{
+    bench_record(BENCH_ISR_ENTRY, bench_pend_time);
+}
+
+void bench_command(uint8_t cmd)
+{
+    // I2C ISR context, probe updates are masked so they cannot interleave
+    switch (cmd)
+    {
+    case BENCH_CMD_START:
+        bench_clear();
+        bench_state = BENCH_STATE_RUNNING;
+        break;
+
+    case BENCH_CMD_STOP:
+        bench_state = BENCH_STATE_STOPPED;
+        break;
+
+    case BENCH_CMD_CLEAR:
+        bench_clear();
+        break;
+
+    default:
+        break;
+    }
+}
+
+void bench_get(uint8_t probe, bench_stats_t *stats)
+{
+    uint32_t primask = __get_PRIMASK();
+
+    __disable_irq();
+    *stats = bench_stats[probe];
+    __set_PRIMASK(primask);
+}
+
+uint8_t bench_get_status(uint8_t *buf)
+{
+    buf[0] = bench_state;
+    buf[1] = BENCH_NUM_PROBES;
+    buf[2] = BENCH_HIST_BUCKETS;
+    buf[3] = BENCH_HIST_SHIFT;
+    return 4;
+}
+
+uint8_t bench_read(uint8_t probe, uint8_t *buf)
+{
+    // [count, min, max, mean], 32-bit little endian, min is 0 without samples
+    const bench_stats_t *s;
+
+    if (probe >= BENCH_NUM_PROBES)
+        return 0;
+
+    s = &bench_stats[probe];
+    put_u32(&buf[0], s->count);
+    put_u32(&buf[4], s->count ? s->min : 0);
+    put_u32(&buf[8], s->max);
+    put_u32(&buf[12], s->count ? (uint32_t)(s->total / s->count) : 0);
+    return 16;
+}
+
+uint8_t bench_read_hist(uint8_t probe, uint8_t *buf)
+{
+    // BENCH_HIST_BUCKETS 16-bit little endian counts
+    if (probe >= BENCH_NUM_PROBES)
+        return 0;
+
+    for (uint8_t i = 0; i < BENCH_HIST_BUCKETS; i++)
+    {
+        buf[2 * i] = (uint8_t)bench_stats[probe].hist[i];
+        buf[2 * i + 1] = (uint8_t)(bench_stats[probe].hist[i] >> 8);
+    }
+
+    return 2 * BENCH_HIST_BUCKETS;
+}
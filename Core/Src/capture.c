@@ -0,0 +1,241 @@
+/**
+ * Blackberry Q10 keyboard STM32 driver
+ * A fun little weekend project to act as a BBQ10 STM32 driver that is able to communicate with I2C bus masters.
+ * Creates rising-edge IRQ pulse, sends pressed character over I2C when master reads from slave upon receiving interrupt.
+ *
+ * Copyright (C) 2025 Mustafa Ozcelikors
+ *
+ * See GPLv3 LICENSE file in repository for licensing details.
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#include "capture.h"
+#include "timebase.h"
+#include <string.h>
+
+#define CAPTURE_RECORD_MAX (5 + 5 + 1 + NUM_ROWS * NUM_COLS)
+
+// Ring and frame state, only written by the main loop
+static uint8_t capture_ring[CAPTURE_RING_SIZE];
+static volatile uint16_t capture_tail = 0;
+static volatile uint16_t capture_len = 0;
+static uint8_t capture_base[KEYBOARD_BITMAP_SIZE];
+static uint8_t capture_last[KEYBOARD_BITMAP_SIZE];
+static uint32_t capture_idle_scans = 0;
+static uint32_t capture_last_time = 0;
+
+static volatile uint8_t capture_state = CAPTURE_STATE_STOPPED;
+static volatile uint8_t capture_flags = 0;
+
+// Commands from the I2C ISR, picked up by capture_record()
+static volatile uint8_t capture_pending_cmd = 0xFF;
+
+static uint8_t capture_ring_at(uint16_t index)
+{
+    return capture_ring[(capture_tail + index) & (CAPTURE_RING_SIZE - 1)];
+}
+
+static void capture_clear(void)
+{
+    capture_tail = 0;
+    capture_len = 0;
+    capture_flags = 0;
+    capture_idle_scans = 0;
+    capture_last_time = timebase_now();
+    memset(capture_base, 0, sizeof(capture_base));
+    memset(capture_last, 0, sizeof(capture_last));
+}
+
+static void capture_evict(void)
+{
+    // Drop the oldest record, its flips move into the base frame
+    uint16_t i = 0;
+    uint8_t flips;
+
+    while (capture_ring_at(i++) & 0x80);  // idle scans
+    while (capture_ring_at(i++) & 0x80);  // dt_us
+
+    flips = capture_ring_at(i++);
+    for (uint8_t k = 0; k < flips; k++)
+    {
+        uint8_t bit = capture_ring_at(i++);
+        capture_base[bit >> 3] ^= (1 << (bit & 7));
+    }
+
+    capture_tail = (capture_tail + i) & (CAPTURE_RING_SIZE - 1);
+    capture_len -= i;
+    capture_flags |= CAPTURE_FLAG_WRAPPED;
+}
+
+static uint8_t capture_put_varint(uint8_t *out, uint32_t value)
+{
+    uint8_t len = 0;
+
+    while (value >= 0x80)
+    {
+        out[len++] = (uint8_t)(value | 0x80);
+        value >>= 7;
+    }
+
+    out[len++] = (uint8_t)value;
+    return len;
+}
+
+static void capture_emit(const uint8_t frame[KEYBOARD_BITMAP_SIZE], uint32_t idle_scans)
+{
+    uint8_t record[CAPTURE_RECORD_MAX];
+    uint8_t flips = 0;
+    uint8_t len;
+    uint16_t head;
+
+    len = capture_put_varint(record, idle_scans);
+    len += capture_put_varint(&record[len], timebase_elapsed_us(capture_last_time));
+    len++;  // flip count, filled in below
+
+    for (uint8_t bit = 0; bit < NUM_ROWS * NUM_COLS; bit++)
+    {
+        if ((frame[bit >> 3] ^ capture_last[bit >> 3]) & (1 << (bit & 7)))
+        {
+            record[len++] = bit;
+            flips++;
+        }
+    }
+
+    record[len - flips - 1] = flips;
+
+    capture_idle_scans = 0;
+    capture_last_time = timebase_now();
+    memcpy(capture_last, frame, KEYBOARD_BITMAP_SIZE);
+
+    while (CAPTURE_RING_SIZE - capture_len < len)
+        capture_evict();
+
+    head = capture_tail + capture_len;
+    for (uint8_t i = 0; i < len; i++)
+        capture_ring[(head + i) & (CAPTURE_RING_SIZE - 1)] = record[i];
+
+    capture_len += len;
+}
+
+static void capture_apply_command(void)
+{
+    uint8_t cmd;
+
+    // Take and clear in one go, a command written in between would be lost
+    __disable_irq();
+    cmd = capture_pending_cmd;
+    capture_pending_cmd = 0xFF;
+    __enable_irq();
+
+    if (cmd == 0xFF)
+        return;
+
+    switch (cmd)
+    {
+    case CAPTURE_CMD_START:
+        capture_clear();
+        capture_state = CAPTURE_STATE_RUNNING;
+        break;
+
+    case CAPTURE_CMD_STOP:
+        // Last counted scan is written out, so the idle tail is not lost
+        if (capture_state == CAPTURE_STATE_RUNNING && capture_idle_scans > 0)
+            capture_emit(capture_last, capture_idle_scans - 1);
+
+        capture_state = CAPTURE_STATE_STOPPED;
+        break;
+
+    case CAPTURE_CMD_CLEAR:
+        capture_clear();
+        break;
+
+    default:
+        break;
+    }
+}
+
+void capture_record(const board_row_mask_t rows[NUM_COLS])
+{
+    uint8_t frame[KEYBOARD_BITMAP_SIZE] = {0};
+
+    capture_apply_command();
+
+    if (capture_state != CAPTURE_STATE_RUNNING)
+        return;
+
+    for (uint8_t c = 0; c < NUM_COLS; c++)
+    {
+        for (uint8_t r = 0; r < NUM_ROWS; r++)
+        {
+            if ((rows[c] >> r) & 1)
+            {
+                uint8_t bit = r * NUM_COLS + c;
+                frame[bit >> 3] |= (1 << (bit & 7));
+            }
+        }
+    }
+
+    // Unchanged scans are only counted
+    if (memcmp(frame, capture_last, sizeof(frame)) == 0 && capture_idle_scans < CAPTURE_MAX_IDLE_SCANS)
+    {
+        capture_idle_scans++;
+        return;
+    }
+
+    capture_emit(frame, capture_idle_scans);
+}
+
+void capture_command(uint8_t cmd)
+{
+    // Runs in I2C ISR, the ring is only touched by the main loop
+    capture_pending_cmd = cmd;
+}
+
+uint8_t capture_get_status(uint8_t *buf)
+{
+    uint16_t size = CAPTURE_HEADER_SIZE + capture_len;
+
+    buf[0] = capture_state;
+    buf[1] = capture_flags;
+    buf[2] = (uint8_t)size;
+    buf[3] = (uint8_t)(size >> 8);
+    return 4;
+}
+
+uint8_t capture_read(uint16_t offset, uint8_t *buf, uint8_t size)
+{
+    // Consistent only while stopped, the host stops recording before reading out
+    uint16_t image_size = CAPTURE_HEADER_SIZE + capture_len;
+    uint8_t n = 0;
+
+    while (n < size && offset < image_size)
+    {
+        if (offset == 0)
+            buf[n] = CAPTURE_FORMAT_VERSION;
+        else if (offset == 1)
+            buf[n] = NUM_ROWS;
+        else if (offset == 2)
+            buf[n] = NUM_COLS;
+        else if (offset < CAPTURE_HEADER_SIZE)
+            buf[n] = capture_base[offset - 3];
+        else
+            buf[n] = capture_ring_at(offset - CAPTURE_HEADER_SIZE);
+
+        n++;
+        offset++;
+    }
+
+    return n;
+}
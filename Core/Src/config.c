@@ -0,0 +1,282 @@
+/**
+ * Blackberry Q10 keyboard STM32 driver
+ * A fun little weekend project to act as a BBQ10 STM32 driver that is able to communicate with I2C bus masters.
+ * Creates rising-edge IRQ pulse, sends pressed character over I2C when master reads from slave upon receiving interrupt.
+ *
+ * Copyright (C) 2025 Mustafa Ozcelikors
+ *
+ * See GPLv3 LICENSE file in repository for licensing details.
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#include "config.h"
+#include "crashlog.h"
+#include "edge.h"
+#include "keyboard.h"
+#include "i2c_slave.h"
+#include "preempt.h"
+#include "trace.h"
+#include "watchdog.h"
+
+/* Page status words, only ever programmed towards zero */
+#define CONFIG_PAGE_ERASED    0xFFFFFFFFU
+#define CONFIG_PAGE_RECEIVING 0xEEEEEEEEU
+#define CONFIG_PAGE_VALID     0x00000000U
+
+#define CONFIG_RECORD_ERASED  0xFFFFFFFFU
+#define CONFIG_HEADER_SIZE    8  // status word + generation word
+
+typedef struct
+{
+    uint16_t def;
+    uint16_t min;
+    uint16_t max;
+} config_param_t;
+
+static const config_param_t config_params[CFG_NUM_PARAMS] = {
+    [CFG_SCAN_INTERVAL_MS]        = { KEYBOARD_SCAN_INTERVAL_MS, 0,    1000  },
+    [CFG_COL_SETTLE_US]           = { KEYBOARD_COL_SETTLE_US,    1,    10000 },
+    [CFG_PRESS_AND_HOLD_MS]       = { PRESS_AND_HOLD_MS,         10,   5000  },
+    [CFG_SYM_DEBOUNCE_MS]         = { SYM_DEBOUNCE_MS,           0,    5000  },
+    [CFG_I2C_ADDRESS]             = { KEYBOARD_I2C_ADDRESS,      0x08, 0x77  },
+    [CFG_IRQ_PULSE_MS]            = { IRQ_PULSE_MS,              1,    100   },
+    [CFG_IRQ_COALESCE_EVENTS]     = { IRQ_COALESCE_EVENTS,       0,    KEY_FIFO_SIZE },
+    [CFG_IRQ_COALESCE_TIMEOUT_US] = { IRQ_COALESCE_TIMEOUT_US,   0,    65535 },
+    [CFG_COL_SETTLE_AUTO]         = { KEYBOARD_COL_SETTLE_AUTO,  0,    1     },
+    [CFG_EDGE_STAMP]              = { EDGE_STAMP_ENABLE,         0,    1     },
+    [CFG_PARTIAL_SCAN]            = { KEYBOARD_PARTIAL_SCAN,     0,    1     },
+};
+
+// Live values, read by main loop and ISRs, written by config_set()
+static volatile uint16_t config_values[CFG_NUM_PARAMS];
+
+// Parameters changed since last config_service(), one bit per parameter
+static volatile uint32_t config_dirty = 0;
+
+// Active log page and its next free record, 0 while flash holds no valid page
+static uint32_t config_page = 0;
+static uint32_t config_write_addr = 0;
+
+static uint32_t config_flash_read(uint32_t addr)
+{
+    return *(volatile uint32_t *)(uintptr_t)addr;
+}
+
+static uint8_t config_record_check(uint8_t id, uint16_t value)
+{
+    // CRC-8 (poly 0x07) over id and value, detects records torn by a power loss
+    uint8_t data[3] = { id, (uint8_t)value, (uint8_t)(value >> 8) };
+    uint8_t crc = 0;
+
+    for (int i = 0; i < 3; i++)
+    {
+        crc ^= data[i];
+        for (int b = 0; b < 8; b++)
+            crc = (crc & 0x80) ? (uint8_t)((crc << 1) ^ 0x07) : (uint8_t)(crc << 1);
+    }
+
+    return crc;
+}
+
+static uint32_t config_record(uint8_t id, uint16_t value)
+{
+    return ((uint32_t)config_record_check(id, value) << 24) | ((uint32_t)id << 16) | value;
+}
+
+static uint8_t config_is_valid(uint8_t id, uint16_t value)
+{
+    return (id < CFG_NUM_PARAMS) && (value >= config_params[id].min) && (value <= config_params[id].max);
+}
+
+static uint32_t config_other_page(uint32_t page)
+{
+    return (page == CONFIG_PAGE0_ADDR) ? CONFIG_PAGE1_ADDR : CONFIG_PAGE0_ADDR;
+}
+
+static HAL_StatusTypeDef config_erase(uint32_t page)
+{
+    FLASH_EraseInitTypeDef erase = {0};
+    uint32_t sector_error = 0;
+    HAL_StatusTypeDef status;
+
+    erase.TypeErase = FLASH_TYPEERASE_SECTORS;
+    erase.Sector = (page == CONFIG_PAGE0_ADDR) ? CONFIG_PAGE0_SECTOR : CONFIG_PAGE1_SECTOR;
+    erase.NbSectors = 1;
+    erase.VoltageRange = FLASH_VOLTAGE_RANGE_3;
+
+    watchdog_stall_begin();
+    status = HAL_FLASHEx_Erase(&erase, &sector_error);
+    watchdog_stall_end();
+
+    return status;
+}
+
+static HAL_StatusTypeDef config_program(uint32_t addr, uint32_t word)
+{
+    return HAL_FLASH_Program(FLASH_TYPEPROGRAM_WORD, addr, word);
+}
+
+static void config_load_page(uint32_t page)
+{
+    uint32_t addr = page + CONFIG_HEADER_SIZE;
+
+    // Single pass over the log, the last record of each parameter wins
+    while (addr < page + CONFIG_PAGE_SIZE)
+    {
+        uint32_t record = config_flash_read(addr);
+        if (record == CONFIG_RECORD_ERASED)
+            break;
+
+        uint8_t id = (uint8_t)(record >> 16);
+        uint16_t value = (uint16_t)record;
+
+        if ((uint8_t)(record >> 24) == config_record_check(id, value) && config_is_valid(id, value))
+            config_values[id] = value;
+
+        addr += 4;
+    }
+
+    config_page = page;
+    config_write_addr = addr;
+}
+
+static void config_transfer(void)
+{
+    // Copy current values into a fresh page, then retire the full one.
+    // A power loss at any point leaves either the old or the new page valid.
+    uint32_t old_page = config_page;
+    uint32_t new_page = old_page ? config_other_page(old_page) : CONFIG_PAGE0_ADDR;
+    uint32_t generation = old_page ? config_flash_read(old_page + 4) + 1 : 1;
+    uint32_t addr = new_page + CONFIG_HEADER_SIZE;
+
+    if (config_erase(new_page) != HAL_OK)
+        return;
+
+    config_program(new_page, CONFIG_PAGE_RECEIVING);
+    config_program(new_page + 4, generation);
+
+    for (uint8_t id = 0; id < CFG_NUM_PARAMS; id++)
+    {
+        if (config_values[id] != config_params[id].def)
+        {
+            config_program(addr, config_record(id, config_values[id]));
+            addr += 4;
+        }
+    }
+
+    config_program(new_page, CONFIG_PAGE_VALID);
+
+    if (old_page)
+        config_erase(old_page);
+
+    config_page = new_page;
+    config_write_addr = addr;
+}
+
+void config_init(void)
+{
+    uint32_t status0 = config_flash_read(CONFIG_PAGE0_ADDR);
+    uint32_t status1 = config_flash_read(CONFIG_PAGE1_ADDR);
+    uint32_t page = 0;
+
+    for (uint8_t id = 0; id < CFG_NUM_PARAMS; id++)
+        config_values[id] = config_params[id].def;
+
+    if (status0 == CONFIG_PAGE_VALID && status1 == CONFIG_PAGE_VALID)
+    {
+        // Power lost before the old page was erased, newer generation wins
+        int32_t diff = (int32_t)(config_flash_read(CONFIG_PAGE0_ADDR + 4) - config_flash_read(CONFIG_PAGE1_ADDR + 4));
+        page = (diff > 0) ? CONFIG_PAGE0_ADDR : CONFIG_PAGE1_ADDR;
+    }
+    else if (status0 == CONFIG_PAGE_VALID)
+    {
+        page = CONFIG_PAGE0_ADDR;
+    }
+    else if (status1 == CONFIG_PAGE_VALID)
+    {
+        page = CONFIG_PAGE1_ADDR;
+    }
+
+    // No valid page means factory defaults, flash is formatted on first write
+    if (page == 0)
+        return;
+
+    config_load_page(page);
+
+    // Clean up leftovers of an interrupted transfer
+    if (config_flash_read(config_other_page(page)) != CONFIG_PAGE_ERASED)
+    {
+        HAL_FLASH_Unlock();
+        config_erase(config_other_page(page));
+        HAL_FLASH_Lock();
+    }
+}
+
+uint16_t config_get(uint8_t id)
+{
+    if (id >= CFG_NUM_PARAMS)
+        return 0;
+
+    return config_values[id];
+}
+
+uint8_t config_set(uint8_t id, uint16_t value)
+{
+    // Safe to call from ISR, flash is only written from config_service()
+    if (!config_is_valid(id, value))
+        return 0;
+
+    config_values[id] = value;
+    config_dirty |= (1U << id);
+
+    return 1;
+}
+
+void config_service(void)
+{
+    PREEMPT_POINT();
+    if (config_dirty == 0)
+        return;
+
+    crashlog_event(CRASHLOG_EV_CONFIG_SAVE, 0, (uint16_t)config_dirty);
+    TRACE("config: saving, dirty 0x%x", config_dirty);
+    HAL_FLASH_Unlock();
+
+    for (uint8_t id = 0; id < CFG_NUM_PARAMS; id++)
+    {
+        uint16_t value;
+
+        PREEMPT_POINT();
+        if (!(config_dirty & (1U << id)))
+            continue;
+
+        __disable_irq();
+        config_dirty &= ~(1U << id);
+        value = config_values[id];
+        __enable_irq();
+
+        if (config_page == 0 || config_write_addr >= config_page + CONFIG_PAGE_SIZE)
+        {
+            // Transfer writes the current value of every parameter
+            config_transfer();
+            continue;
+        }
+
+        config_program(config_write_addr, config_record(id, value));
+        config_write_addr += 4;
+    }
+
+    HAL_FLASH_Lock();
+}
@@ -0,0 +1,122 @@
+/**
+ * Blackberry Q10 keyboard STM32 driver
+ * A fun little weekend project to act as a BBQ10 STM32 driver that is able to communicate with I2C bus masters.
+ * Creates rising-edge IRQ pulse, sends pressed character over I2C when master reads from slave upon receiving interrupt.
+ *
+ * Copyright (C) 2025 Mustafa Ozcelikors
+ *
+ * See GPLv3 LICENSE file in repository for licensing details.
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#include "cpuload.h"
+
+/* Result slots, in REG_CPU_LOAD order */
+#define CPULOAD_WINDOW    0
+#define CPULOAD_BUSY      1
+#define CPULOAD_MAIN      2
+#define CPULOAD_SHARES    3  // one per interrupt context from here
+#define CPULOAD_IDLE      (CPULOAD_SHARES + CPULOAD_NUM_ISRS)
+#define CPULOAD_PEAK      (CPULOAD_IDLE + 1)
+#define CPULOAD_NUM_SLOTS (CPULOAD_PEAK + 1)
+
+_Static_assert(CPULOAD_NUM_SLOTS * 2 == CPULOAD_SIZE, "REG_CPU_LOAD layout");
+
+volatile uint32_t cpuload_isr[CPULOAD_NUM_ISRS];
+volatile uint32_t cpuload_isr_total = 0;
+volatile uint32_t cpuload_idle = 0;
+
+// SysTick only: window start and the counters at that point
+static uint32_t window_tick = 0;
+static uint32_t window_start = 0;
+static uint32_t window_isr[CPULOAD_NUM_ISRS];
+static uint32_t window_idle = 0;
+static uint16_t peak_busy = 0;
+
+// Double buffered results, the I2C ISR only ever copies the published one
+static uint16_t results[2][CPULOAD_NUM_SLOTS];
+static volatile uint8_t results_idx = 0;
+
+static uint16_t cpuload_share(uint32_t cycles, uint32_t window)
+{
+    // 0.01 % units, 64-bit since a full window is up to 16e6 cycles
+    if (cycles >= window)
+        return 10000;
+
+    return (uint16_t)(((uint64_t)cycles * 10000U) / window);
+}
+
+void cpuload_init(void)
+{
+    window_tick = HAL_GetTick();
+    window_start = timebase_now();
+}
+
+void cpuload_tick(void)
+{
+    // SysTick, once per ms; the divisions only run when a window closes
+    uint16_t *r = results[results_idx ^ 1];
+    uint32_t now, window, rest;
+
+    if (HAL_GetTick() - window_tick < CPULOAD_WINDOW_MS)
+        return;
+
+    now = timebase_now();
+    window = now - window_start;
+    rest = window;
+
+    window_tick = HAL_GetTick();
+    window_start = now;
+
+    r[CPULOAD_WINDOW] = (uint16_t)(window / (SystemCoreClock / 1000U));
+
+    for (uint8_t i = 0; i < CPULOAD_NUM_ISRS; i++)
+    {
+        uint32_t cycles = cpuload_isr[i] - window_isr[i];
+
+        window_isr[i] += cycles;
+        r[CPULOAD_SHARES + i] = cpuload_share(cycles, window);
+        rest -= cycles < rest ? cycles : rest;
+    }
+
+    uint32_t idle = cpuload_idle - window_idle;
+
+    window_idle += idle;
+    r[CPULOAD_IDLE] = cpuload_share(idle, window);
+    rest -= idle < rest ? idle : rest;
+
+    r[CPULOAD_MAIN] = cpuload_share(rest, window);
+    r[CPULOAD_BUSY] = 10000 - r[CPULOAD_IDLE];
+
+    if (r[CPULOAD_BUSY] > peak_busy)
+        peak_busy = r[CPULOAD_BUSY];
+    r[CPULOAD_PEAK] = peak_busy;
+
+    // Single byte store makes the new results visible atomically
+    results_idx ^= 1;
+}
+
+uint8_t cpuload_read(uint8_t *buf)
+{
+    const uint16_t *r = results[results_idx];
+
+    for (uint8_t i = 0; i < CPULOAD_NUM_SLOTS; i++)
+    {
+        buf[2 * i] = (uint8_t)r[i];
+        buf[2 * i + 1] = (uint8_t)(r[i] >> 8);
+    }
+
+    return CPULOAD_SIZE;
+}
@@ -0,0 +1,260 @@
+/**
+ * Blackberry Q10 keyboard STM32 driver
+ * A fun little weekend project to act as a BBQ10 STM32 driver that is able to communicate with I2C bus masters.
+ * Creates rising-edge IRQ pulse, sends pressed character over I2C when master reads from slave upon receiving interrupt.
+ *
+ * Copyright (C) 2025 Mustafa Ozcelikors
+ *
+ * See GPLv3 LICENSE file in repository for licensing details.
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#include "crashlog.h"
+#include "timebase.h"
+#include "watchdog.h"
+#include <string.h>
+
+#define CRASHLOG_MAGIC      0xC4A5D0C5U  // dump is complete
+#define CRASHLOG_RING_MAGIC 0x52494E47U  // ring and crash count survived a reset
+
+typedef struct
+{
+    uint32_t cycles;
+    uint8_t type;
+    uint8_t arg;
+    uint16_t data;
+} crashlog_event_t;
+
+// Laid out exactly like the image read over I2C
+typedef struct
+{
+    uint8_t version;
+    uint8_t cause;
+    uint8_t events;
+    uint8_t crashes;
+    uint32_t frame[8];
+    uint32_t sp;
+    uint32_t exc_return;
+    uint32_t cfsr;
+    uint32_t hfsr;
+    uint32_t mmfar;
+    uint32_t bfar;
+    uint32_t cycles;
+    uint32_t tick;
+    crashlog_event_t event[CRASHLOG_EVENTS];
+} crashlog_dump_t;
+
+typedef struct
+{
+    uint32_t magic;
+    uint32_t checksum;
+    crashlog_dump_t dump;
+
+    uint32_t ring_magic;
+    uint32_t ring_head;
+    uint8_t crashes;
+    crashlog_event_t ring[CRASHLOG_EVENTS];
+} crashlog_noinit_t;
+
+_Static_assert(sizeof(crashlog_dump_t) == CRASHLOG_IMAGE_SIZE, "crash dump image layout");
+
+// Not touched by the startup code, see the .noinit section of the linker script
+static crashlog_noinit_t crashlog __attribute__((section(".noinit")));
+
+static uint32_t crashlog_checksum(void)
+{
+    const uint32_t *words = (const uint32_t *)&crashlog.dump;
+    uint32_t sum = CRASHLOG_MAGIC;
+
+    for (uint32_t i = 0; i < sizeof(crashlog.dump) / 4; i++)
+        sum = ((sum << 1) | (sum >> 31)) ^ words[i];
+
+    return sum;
+}
+
+static uint8_t crashlog_valid(void)
+{
+    return crashlog.magic == CRASHLOG_MAGIC && crashlog.checksum == crashlog_checksum();
+}
+
+static void crashlog_count(void)
+{
+    if (crashlog.crashes != UINT8_MAX)
+        crashlog.crashes++;
+}
+
+static void crashlog_begin(uint8_t cause)
+{
+    crashlog_dump_t *d = &crashlog.dump;
+
+    // A fault inside the dump code must not see a half written dump as valid
+    crashlog.magic = 0;
+
+    memset(d, 0, sizeof(*d));
+    d->version = CRASHLOG_FORMAT_VERSION;
+    d->cause = cause;
+
+    crashlog_count();
+    d->crashes = crashlog.crashes;
+}
+
+static void crashlog_freeze(void)
+{
+    crashlog_dump_t *d = &crashlog.dump;
+    uint32_t head = crashlog.ring_head;
+    uint32_t n = head < CRASHLOG_EVENTS ? head : CRASHLOG_EVENTS;
+
+    d->cfsr = SCB->CFSR;
+    d->hfsr = SCB->HFSR;
+    d->mmfar = SCB->MMFAR;
+    d->bfar = SCB->BFAR;
+    d->cycles = timebase_now();
+    d->tick = HAL_GetTick();
+
+    // Freeze the flight recorder, oldest event first
+    for (uint32_t i = 0; i < n; i++)
+        d->event[i] = crashlog.ring[(head - n + i) & (CRASHLOG_EVENTS - 1)];
+    d->events = (uint8_t)n;
+
+    crashlog.checksum = crashlog_checksum();
+    crashlog.magic = CRASHLOG_MAGIC;
+    __DSB();
+}
+
+__attribute__((noreturn))
+static void crashlog_finish(void)
+{
+    crashlog_freeze();
+
+    // With a debugger attached stop here instead, the dump is already written
+    if (CoreDebug->DHCSR & CoreDebug_DHCSR_C_DEBUGEN_Msk)
+        __BKPT(0);
+
+    NVIC_SystemReset();
+}
+
+void crashlog_init(void)
+{
+    // Power-on leaves random RAM, start the ring and the crash count over
+    if (crashlog.ring_magic != CRASHLOG_RING_MAGIC)
+    {
+        memset(crashlog.ring, 0, sizeof(crashlog.ring));
+        crashlog.ring_head = 0;
+        crashlog.crashes = 0;
+        crashlog.ring_magic = CRASHLOG_RING_MAGIC;
+    }
+
+    if (!crashlog_valid())
+        crashlog.magic = 0;
+
+    // Whatever hung left no dump, the events before it are still in the ring.
+    // A dump the host has not read yet tells more, the hang is only counted.
+    if (watchdog_boot_reason() == WATCHDOG_BOOT_WATCHDOG && crashlog.magic)
+    {
+        crashlog_count();
+        crashlog_event(CRASHLOG_EV_WATCHDOG, crashlog.crashes, 0);
+    }
+    else if (watchdog_boot_reason() == WATCHDOG_BOOT_WATCHDOG)
+    {
+        crashlog_begin(CRASHLOG_CAUSE_WATCHDOG);
+        crashlog_freeze();
+
+        crashlog.dump.tick = 0;
+        if (crashlog.dump.events)
+            crashlog.dump.cycles = crashlog.dump.event[crashlog.dump.events - 1].cycles;
+        crashlog.checksum = crashlog_checksum();
+    }
+
+    // Report memory management, bus and usage faults as themselves instead of
+    // escalating them to HardFault
+    SCB->SHCSR |= SCB_SHCSR_MEMFAULTENA_Msk | SCB_SHCSR_BUSFAULTENA_Msk | SCB_SHCSR_USGFAULTENA_Msk;
+
+    crashlog_event(CRASHLOG_EV_BOOT, crashlog.magic ? crashlog.dump.cause : CRASHLOG_CAUSE_NONE, 0);
+}
+
+void crashlog_event(uint8_t type, uint8_t arg, uint16_t data)
+{
+    uint32_t now = timebase_now();
+    uint32_t primask = __get_PRIMASK();
+
+    // Logged from the main loop, PendSV and the I2C ISR, a caller's mask is kept
+    __disable_irq();
+
+    crashlog_event_t *e = &crashlog.ring[crashlog.ring_head++ & (CRASHLOG_EVENTS - 1)];
+
+    e->cycles = now;
+    e->type = type;
+    e->arg = arg;
+    e->data = data;
+
+    __set_PRIMASK(primask);
+}
+
+// Reached from the naked fault handlers in stm32f4xx_it.c, which only
+// reference it from assembly; used keeps link time optimization from dropping it
+__attribute__((used))
+void crashlog_fault(const uint32_t *frame, uint32_t exc_return)
+{
+    crashlog_begin((uint8_t)(SCB->ICSR & SCB_ICSR_VECTACTIVE_Msk));
+
+    memcpy(crashlog.dump.frame, frame, sizeof(crashlog.dump.frame));
+    crashlog.dump.sp = (uint32_t)(uintptr_t)frame;
+    crashlog.dump.exc_return = exc_return;
+
+    crashlog_finish();
+}
+
+void crashlog_error(uint8_t cause, uint32_t caller)
+{
+    __disable_irq();
+
+    crashlog_begin(cause);
+    crashlog.dump.frame[6] = caller;
+
+    crashlog_finish();
+}
+
+void crashlog_command(uint8_t cmd)
+{
+    // Runs in I2C ISR
+    if (cmd == CRASHLOG_CMD_CLEAR)
+        crashlog.magic = 0;
+}
+
+uint8_t crashlog_get_status(uint8_t *buf)
+{
+    uint16_t size = crashlog.magic ? CRASHLOG_IMAGE_SIZE : 0;
+
+    buf[0] = crashlog.magic ? CRASHLOG_STATE_DUMP : CRASHLOG_STATE_EMPTY;
+    buf[1] = crashlog.magic ? crashlog.dump.cause : CRASHLOG_CAUSE_NONE;
+    buf[2] = (uint8_t)size;
+    buf[3] = (uint8_t)(size >> 8);
+    buf[4] = crashlog.crashes;
+    return 5;
+}
+
+uint8_t crashlog_read(uint16_t offset, uint8_t *buf, uint8_t size)
+{
+    const uint8_t *image = (const uint8_t *)&crashlog.dump;
+    uint8_t n = 0;
+
+    if (!crashlog.magic)
+        return 0;
+
+    while (n < size && offset < CRASHLOG_IMAGE_SIZE)
+        buf[n++] = image[offset++];
+
+    return n;
+}
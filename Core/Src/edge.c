@@ -0,0 +1,183 @@
+/**
+ * Blackberry Q10 keyboard STM32 driver
+ * A fun little weekend project to act as a BBQ10 STM32 driver that is able to communicate with I2C bus masters.
+ * Creates rising-edge IRQ pulse, sends pressed character over I2C when master reads from slave upon receiving interrupt.
+ *
+ * Copyright (C) 2025 Mustafa Ozcelikors
+ *
+ * See GPLv3 LICENSE file in repository for licensing details.
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#include "edge.h"
+#include "config.h"
+#include "cpuload.h"
+#include "irq_prio.h"
+#include "ramcode.h"
+#include "timebase.h"
+
+static GPIO_TypeDef *const row_ports[NUM_ROWS] = BOARD_ROW_PORTS;
+static const uint16_t      row_pins[NUM_ROWS]  = BOARD_ROW_PINS;
+
+// EXTI lines of the rows in BOARD_EDGE_ROWS, a line is the row's pin number
+static uint32_t edge_lines = 0;
+static uint8_t edge_armed = 0;
+
+// First falling edge per row since edge_arm(), written by the EXTI handlers
+static volatile board_row_mask_t edge_seen = 0;
+static volatile uint32_t edge_stamp[NUM_ROWS];
+
+static IRQn_Type edge_irq_of_line(uint32_t line)
+{
+    static const IRQn_Type irqs[5] = { EXTI0_IRQn, EXTI1_IRQn, EXTI2_IRQn, EXTI3_IRQn, EXTI4_IRQn };
+
+    if (line < 5)
+        return irqs[line];
+    if (line < 10)
+        return EXTI9_5_IRQn;
+    return EXTI15_10_IRQn;
+}
+
+void edge_init(void)
+{
+    GPIO_InitTypeDef GPIO_InitStruct = {0};
+
+    __HAL_RCC_SYSCFG_CLK_ENABLE();
+
+    // Rows stay inputs with pull-up, the line routing and falling trigger are added
+    GPIO_InitStruct.Mode = GPIO_MODE_IT_FALLING;
+    GPIO_InitStruct.Pull = GPIO_PULLUP;
+    for (int r = 0; r < NUM_ROWS; r++)
+    {
+        if (!(BOARD_EDGE_ROWS & (1U << r)))
+            continue;
+
+        GPIO_InitStruct.Pin = row_pins[r];
+        HAL_GPIO_Init(row_ports[r], &GPIO_InitStruct);
+        edge_lines |= row_pins[r];
+    }
+
+    // HAL_GPIO_Init() unmasks the lines, they only interrupt while armed
+    EXTI->IMR &= ~edge_lines;
+    __HAL_GPIO_EXTI_CLEAR_IT(edge_lines);
+
+    for (uint32_t line = 0; line < 16; line++)
+    {
+        if (edge_lines & (1U << line))
+        {
+            HAL_NVIC_SetPriority(edge_irq_of_line(line), IRQ_PRIO_EDGE, 0);
+            HAL_NVIC_EnableIRQ(edge_irq_of_line(line));
+        }
+    }
+}
+
+void edge_arm(void)
+{
+    if (!config_get(CFG_EDGE_STAMP))
+        return;
+
+    // Rows of keys already down fall with the columns, those edges are not presses
+    edge_seen = 0;
+    board_park_cols();
+    __HAL_GPIO_EXTI_CLEAR_IT(edge_lines);
+    EXTI->IMR |= edge_lines;
+    edge_armed = 1;
+}
+
+uint8_t edge_parked(void)
+{
+    return edge_armed;
+}
+
+board_row_mask_t edge_disarm(uint32_t stamps[NUM_ROWS])
+{
+    board_row_mask_t seen;
+
+    if (!edge_armed)
+        return 0;
+
+    EXTI->IMR &= ~edge_lines;
+    board_release_cols();
+    edge_armed = 0;
+
+    seen = edge_seen;
+    for (int r = 0; r < NUM_ROWS; r++)
+    {
+        if (seen & (1U << r))
+            stamps[r] = edge_stamp[r];
+    }
+
+    return seen;
+}
+
+static HOT_CODE void edge_irq(void)
+{
+    // Stamp first, the rest of the handler is not part of the key's latency;
+    // the load meter's entry read is that stamp
+    cpuload_frame_t frame = cpuload_enter();
+    uint32_t now = frame.start;
+    uint32_t pending = __HAL_GPIO_EXTI_GET_IT(edge_lines);
+    board_row_mask_t seen = edge_seen;
+
+    __HAL_GPIO_EXTI_CLEAR_IT(pending);
+
+    for (int r = 0; r < NUM_ROWS; r++)
+    {
+        if ((BOARD_EDGE_ROWS & (1U << r)) && (pending & row_pins[r]) && !(seen & (1U << r)))
+        {
+            edge_stamp[r] = now;
+            seen |= (board_row_mask_t)(1U << r);
+        }
+    }
+
+    edge_seen = seen;
+
+    cpuload_exit(CPULOAD_EDGE, frame);
+}
+
+HOT_CODE void EXTI0_IRQHandler(void)
+{
+    edge_irq();
+}
+
+HOT_CODE void EXTI1_IRQHandler(void)
+{
+    edge_irq();
+}
+
+HOT_CODE void EXTI2_IRQHandler(void)
+{
+    edge_irq();
+}
+
+HOT_CODE void EXTI3_IRQHandler(void)
+{
+    edge_irq();
+}
+
+HOT_CODE void EXTI4_IRQHandler(void)
+{
+    edge_irq();
+}
+
+HOT_CODE void EXTI9_5_IRQHandler(void)
+{
+    edge_irq();
+}
+
+HOT_CODE void EXTI15_10_IRQHandler(void)
+{
+    edge_irq();
+}
@@ -22,18 +22,61 @@
  */
 
 #include "i2c_slave.h"
+#include "bench.h"
+#include "config.h"
+#include "cpuload.h"
+#include "crashlog.h"
+#include "irq_prio.h"
 #include "keyboard.h"
+#include "preempt.h"
+#include "ramcode.h"
+#include "registers.h"
+#include "stats.h"
+#include "timebase.h"
+#include "trace.h"
+#include "watchdog.h"
 
 I2C_HandleTypeDef hi2c1;
 
-uint8_t I2C_RxData[1];
+uint8_t I2C_RxData[I2C_RX_BUF_SIZE];
 
 // volatile because may be accessed from ISR
-volatile uint8_t I2C_TxData[1] = {0x00};
+volatile uint8_t I2C_TxData[I2C_TX_BUF_SIZE] = {0x00};
 volatile uint8_t i2c_busy = 0;
 
+// Register selected by the last master write, used by the next master read
+static volatile uint8_t i2c_reg_pointer = REG_KEY;
+static volatile uint8_t i2c_tx_reg = REG_KEY;
+static volatile uint8_t i2c_rx_active = 0;
+
+// Set once the latched key has been loaded for sending, it is only dropped from
+// the queue when the master ends the read with a NACK (delivered at least once)
+static volatile uint8_t key_tx_pending = 0;
+
+// Set by an error that leaves the peripheral with its interrupts disabled
+static volatile uint8_t i2c_listen_restart = 0;
+
+// Key event FIFO, head is only written by the deferred decode (PendSV) and tail only by I2C ISR
+static volatile char key_fifo[KEY_FIFO_SIZE];
+static volatile uint32_t key_fifo_stamp[KEY_FIFO_SIZE];
+static volatile uint8_t key_fifo_head = 0;
+static volatile uint8_t key_fifo_tail = 0;
+
+// Interrupt moderation state, deferred decode (PendSV) only
+static uint8_t irq_unreported_events = 0;
+static uint32_t irq_first_unreported_time = 0;
+
+// IRQ_KEYCHANGED pulse, raised by the deferred decode and lowered by the tick
+static volatile uint8_t irq_pulse_active = 0;
+static volatile uint32_t irq_pulse_start = 0;
+
 void I2C_Error_Handler(void);
 
+static uint8_t key_fifo_count(void)
+{
+    return (uint8_t)(key_fifo_head - key_fifo_tail);
+}
+
 void MX_I2C1_Init_Slave(void)
 {
     GPIO_InitTypeDef GPIO_InitStruct = {0};
@@ -54,7 +97,7 @@ void MX_I2C1_Init_Slave(void)
     hi2c1.Instance = I2C1;
     hi2c1.Init.ClockSpeed = 100000;
     hi2c1.Init.DutyCycle = I2C_DUTYCYCLE_2;
-    hi2c1.Init.OwnAddress1 = (KEYBOARD_I2C_ADDRESS << 1);
+    hi2c1.Init.OwnAddress1 = (config_get(CFG_I2C_ADDRESS) << 1);
     hi2c1.Init.AddressingMode = I2C_ADDRESSINGMODE_7BIT;
     hi2c1.Init.DualAddressMode = I2C_DUALADDRESS_DISABLE;
     hi2c1.Init.OwnAddress2 = 0;
@@ -69,106 +112,315 @@ void MX_I2C1_Init_Slave(void)
     /* Configure analog filter */
     HAL_I2CEx_ConfigAnalogFilter(&hi2c1, I2C_ANALOGFILTER_ENABLE);
 
-    /* Enable interrupts */
-    HAL_NVIC_SetPriority(I2C1_EV_IRQn, 0, 0);
+    /* Enable interrupts, above everything else (irq_prio.h) */
+    HAL_NVIC_SetPriority(I2C1_EV_IRQn, IRQ_PRIO_I2C, 0);
     HAL_NVIC_EnableIRQ(I2C1_EV_IRQn);
-    HAL_NVIC_SetPriority(I2C1_ER_IRQn, 0, 0);
+    HAL_NVIC_SetPriority(I2C1_ER_IRQn, IRQ_PRIO_I2C, 0);
     HAL_NVIC_EnableIRQ(I2C1_ER_IRQn);
 
     HAL_I2C_EnableListen_IT(&hi2c1);
 
-    // DEBUG:
-    volatile uint32_t cr1_val = I2C1->CR1;
-    volatile uint32_t cr2_val = I2C1->CR2;
-    volatile uint32_t oar1_val = I2C1->OAR1;
-    // cr1_val should have PE bit (bit 0) set = 0x0001 at minimum
-    // cr2_val should have ITEVTEN (bit 9) and ITERREN (bit 8) set
-    // oar1_val should be 0x4052 or 0xC052 (bit 14 must be 1, address in bits 1-7)
-    (void)cr1_val; (void)cr2_val; (void)oar1_val; // Prevent optimization
+    // CR1 needs PE (bit 0), CR2 ITEVTEN and ITERREN (bits 9, 8), OAR1 bit 14
+    // and the address in bits 7-1 for the slave to answer
+    TRACE("i2c: CR1 0x%04x CR2 0x%04x", I2C1->CR1, I2C1->CR2);
+    TRACE("i2c: OAR1 0x%04x", I2C1->OAR1);
 }
 
-void set_i2c_txdata(char c)
+void set_i2c_txdata(char c, uint32_t stamp)
 {
-	I2C_TxData[0] = c;
+    // Queue the key for the host, if the host is not keeping up the newest key is dropped
+    PREEMPT_POINT();
+    if (key_fifo_count() >= KEY_FIFO_SIZE)
+    {
+        stats_count(STATS_KEYS_DROPPED);
+        crashlog_event(CRASHLOG_EV_KEY_DROPPED, (uint8_t)c, 0);
+        TRACE("keys: FIFO full, dropped '%c'", c);
+        return;
+    }
+
+    key_fifo[key_fifo_head & (KEY_FIFO_SIZE - 1)] = c;
+    key_fifo_stamp[key_fifo_head & (KEY_FIFO_SIZE - 1)] = stamp;
+    bench_key_queued(key_fifo_head & (KEY_FIFO_SIZE - 1));
+    PREEMPT_POINT();
+    key_fifo_head++;
+
+    stats_count(STATS_KEYS_QUEUED);
+    stats_level(STATS_FIFO_HIGH_WATER, key_fifo_count());
+    crashlog_event(CRASHLOG_EV_KEY_QUEUED, (uint8_t)c, key_fifo_count());
+
+    if (irq_unreported_events == 0)
+        irq_first_unreported_time = timebase_now();
+
+    irq_unreported_events++;
 }
 
-void wait_i2c_busy(void)
+void i2c_irq_moderation_poll(void)
 {
-    // Only update when not in the middle of I2C transaction
-    while(i2c_busy);
+    uint8_t irq_coalesce_events = config_get(CFG_IRQ_COALESCE_EVENTS);
+    uint32_t irq_coalesce_timeout_us = config_get(CFG_IRQ_COALESCE_TIMEOUT_US);
+
+    // A pulse still high would hide the next rising edge, report once it ended
+    if (irq_unreported_events == 0 || irq_pulse_active)
+        return;
+
+    // Immediate mode bypasses coalescing
+    if (irq_coalesce_events == 0 || irq_coalesce_timeout_us == 0 ||
+        irq_unreported_events >= irq_coalesce_events ||
+        timebase_elapsed_us(irq_first_unreported_time) >= irq_coalesce_timeout_us)
+    {
+        stats_count(STATS_IRQ_PULSES);
+        crashlog_event(CRASHLOG_EV_IRQ_PULSE, 0, irq_unreported_events);
+        irq_unreported_events = 0;
+        bench_key_irq();
+        create_keychanged_irq_pulse();
+    }
+}
+
+void i2c_service(void)
+{
+    PREEMPT_POINT();
+    if (!i2c_listen_restart)
+        return;
+
+    // After a bus error the HAL leaves the handle in listen state with event and
+    // error interrupts off, the slave no longer answers until listening restarts
+    __disable_irq();
+
+    if (HAL_I2C_GetState(&hi2c1) == HAL_I2C_STATE_LISTEN)
+        HAL_I2C_DisableListen_IT(&hi2c1);
+
+    if (HAL_I2C_EnableListen_IT(&hi2c1) == HAL_OK)
+    {
+        i2c_listen_restart = 0;
+        stats_count(STATS_I2C_RECOVERIES);
+    }
+
+    __enable_irq();
+
+    crashlog_event(CRASHLOG_EV_I2C_RESTART, 0, 0);
+    TRACE("i2c: listen restart, retry pending %u", i2c_listen_restart);
 }
 
 void create_keychanged_irq_pulse(void)
 {
-	// Pulse on interrupt output pin KEY_CHANGED_IRQ
+	// Pulse on interrupt output pin KEY_CHANGED_IRQ, i2c_irq_pulse_tick() ends it
+	irq_pulse_start = HAL_GetTick();
 	HAL_GPIO_WritePin(GPIOB, GPIO_PIN_13, GPIO_PIN_SET);
-	HAL_Delay(2);
-	HAL_GPIO_WritePin(GPIOB, GPIO_PIN_13, GPIO_PIN_RESET);
+	irq_pulse_active = 1;
 }
 
-void HAL_I2C_ListenCpltCallback(I2C_HandleTypeDef *hi2c)
+void i2c_irq_pulse_tick(void)
 {
-    // Listen completed
+    // Runs from SysTick, same rounding as HAL_Delay(): at least the configured width
+    if (irq_pulse_active && HAL_GetTick() - irq_pulse_start > config_get(CFG_IRQ_PULSE_MS))
+    {
+        HAL_GPIO_WritePin(GPIOB, GPIO_PIN_13, GPIO_PIN_RESET);
+        irq_pulse_active = 0;
+    }
+}
+
+void i2c_watchdog_tick(void)
+{
+    // Runs from SysTick, listening with no transfer in flight and nothing to
+    // restart is progress, a transfer or a bus error that never ends is not
+    if (!i2c_busy && !i2c_listen_restart && HAL_I2C_GetState(&hi2c1) == HAL_I2C_STATE_LISTEN)
+        watchdog_progress(WATCHDOG_I2C);
+}
+
+static void i2c_write_complete(I2C_HandleTypeDef *hi2c)
+{
+    // A master write ends with STOP (listen complete / NACK error) or a repeated start
+    if (!i2c_rx_active)
+        return;
+
+    i2c_rx_active = 0;
+
+    uint8_t len = (uint8_t)(hi2c->pBuffPtr - I2C_RxData);
+    if (len == 0)
+        return;
+
+    i2c_reg_pointer = I2C_RxData[0];
+    stats_count(STATS_I2C_WRITES);
+    crashlog_event(CRASHLOG_EV_I2C_WRITE, I2C_RxData[0], len - 1);
+
+    if (len > 1)
+        registers_write(I2C_RxData[0], &I2C_RxData[1], len - 1);
+}
+
+static void i2c_key_delivered(void)
+{
+    // The master NACKed the end of a key read, the key reached the host
+    if (key_tx_pending && key_fifo_count() != 0)
+    {
+        stats_count(STATS_KEYS_DELIVERED);
+        crashlog_event(CRASHLOG_EV_KEY_DELIVERED, (uint8_t)key_fifo[key_fifo_tail & (KEY_FIFO_SIZE - 1)], 0);
+        bench_key_delivered(key_fifo_tail & (KEY_FIFO_SIZE - 1));
+        key_fifo_tail++;
+    }
+
+    key_tx_pending = 0;
+}
+
+HOT_CODE void HAL_I2C_ListenCpltCallback(I2C_HandleTypeDef *hi2c)
+{
+    // Listen completed, the master ended the transfer
+    uint32_t start = bench_start();
+
+    i2c_write_complete(hi2c);
+    i2c_key_delivered();
     i2c_busy = 0;
     HAL_I2C_EnableListen_IT(hi2c);
+
+    // Back to back transfers may never leave the slave idle at a tick
+    watchdog_progress(WATCHDOG_I2C);
+
+    bench_record(BENCH_I2C_LISTEN, start);
 }
 
-void HAL_I2C_AddrCallback(I2C_HandleTypeDef *hi2c,
-                          uint8_t TransferDirection,
-                          uint16_t AddrMatchCode)
+HOT_CODE void HAL_I2C_AddrCallback(I2C_HandleTypeDef *hi2c,
+                                   uint8_t TransferDirection,
+                                   uint16_t AddrMatchCode)
 {
+    uint32_t start = bench_start();
+
     if (hi2c->Instance != I2C1)
         return;
 
     i2c_busy = 1;
+    key_tx_pending = 0;
+
+    // Repeated start after a register select write
+    i2c_write_complete(hi2c);
+    stats_count(STATS_I2C_ADDR);
+    crashlog_event(CRASHLOG_EV_I2C_ADDR, TransferDirection, i2c_reg_pointer);
 
     if (TransferDirection == I2C_DIRECTION_TRANSMIT)
     {
-        // Master is writing to us
-        HAL_I2C_Slave_Seq_Receive_IT(hi2c, I2C_RxData, 1, I2C_FIRST_AND_LAST_FRAME);
+        // Master is writing to us, register address followed by optional data
+        i2c_rx_active = 1;
+        HAL_I2C_Slave_Seq_Receive_IT(hi2c, I2C_RxData, I2C_RX_BUF_SIZE, I2C_FIRST_AND_LAST_FRAME);
     }
     else
     {
-        // Master is reading from us
-        HAL_I2C_Slave_Seq_Transmit_IT(hi2c, (uint8_t*)I2C_TxData, 1, I2C_FIRST_AND_LAST_FRAME);
+        // Master is reading from us, latch selected register at address match
+        uint8_t len;
+
+        stats_count(STATS_I2C_READS);
+
+        i2c_tx_reg = i2c_reg_pointer;
+        i2c_reg_pointer = REG_KEY;
+
+        if (i2c_tx_reg == REG_KEY || i2c_tx_reg == REG_KEY_STAMPED)
+        {
+            // Oldest queued key (0 if queue is empty), with its stamp if asked for
+            uint32_t stamp = 0;
+
+            if (key_fifo_count() != 0)
+            {
+                I2C_TxData[0] = key_fifo[key_fifo_tail & (KEY_FIFO_SIZE - 1)];
+                stamp = key_fifo_stamp[key_fifo_tail & (KEY_FIFO_SIZE - 1)];
+            }
+            else
+            {
+                I2C_TxData[0] = 0;
+            }
+
+            len = 1;
+            if (i2c_tx_reg == REG_KEY_STAMPED)
+            {
+                for (int i = 0; i < 4; i++)
+                    I2C_TxData[1 + i] = (uint8_t)(stamp >> (8 * i));
+                len = 5;
+            }
+        }
+        else
+        {
+            len = registers_read(i2c_tx_reg, (uint8_t*)I2C_TxData, I2C_TX_BUF_SIZE);
+            if (len == 0)
+            {
+                // Unknown register reads as a single zero byte
+                I2C_TxData[0] = 0;
+                len = 1;
+            }
+        }
+
+        HAL_I2C_Slave_Seq_Transmit_IT(hi2c, (uint8_t*)I2C_TxData, len, I2C_FIRST_AND_LAST_FRAME);
     }
+
+    bench_record(BENCH_I2C_ADDR, start);
 }
 
-void HAL_I2C_SlaveRxCpltCallback(I2C_HandleTypeDef *hi2c)
+HOT_CODE void HAL_I2C_SlaveRxCpltCallback(I2C_HandleTypeDef *hi2c)
 {
-    // Process received data if needed
-    i2c_busy = 0;
+    // Receive buffer full, data is processed once the master ends the transfer
+    bench_record(BENCH_I2C_RX_CPLT, bench_start());
 }
 
-void HAL_I2C_SlaveTxCpltCallback(I2C_HandleTypeDef *hi2c)
+HOT_CODE void HAL_I2C_SlaveTxCpltCallback(I2C_HandleTypeDef *hi2c)
 {
-    // Transmit complete
-    i2c_busy = 0;
+    // Last byte loaded into DR, it has not reached the master yet
+    uint32_t start = bench_start();
+
+    if ((i2c_tx_reg == REG_KEY || i2c_tx_reg == REG_KEY_STAMPED) && I2C_TxData[0] != 0)
+        key_tx_pending = 1;
+
+    bench_record(BENCH_I2C_TX_CPLT, start);
 }
 
 void HAL_I2C_ErrorCallback(I2C_HandleTypeDef *hi2c)
 {
+    uint32_t start = bench_start();
+    uint32_t errors = hi2c->ErrorCode;
+
     // Clear all error flags
     __HAL_I2C_CLEAR_FLAG(hi2c, I2C_FLAG_BERR | I2C_FLAG_ARLO | I2C_FLAG_AF | I2C_FLAG_OVR);
 
+    // STOP before the receive buffer is full is reported as NACK error, that
+    // is how every master write ends
+    if (i2c_rx_active)
+        errors &= ~HAL_I2C_ERROR_AF;
+
+    i2c_write_complete(hi2c);
+    crashlog_event(CRASHLOG_EV_I2C_ERROR, 0, (uint16_t)hi2c->ErrorCode);
+
+    if (errors & HAL_I2C_ERROR_AF)
+        stats_count(STATS_I2C_NACKS);
+    if (errors & ~HAL_I2C_ERROR_AF)
+        stats_count(STATS_I2C_BUS_ERRORS);
+    if (errors)
+        TRACE("i2c: error 0x%x", errors);
+
+    // A NACK is followed by listen complete, anything else (bus error, arbitration
+    // loss) leaves the key queued and listening to be restarted by i2c_service()
+    if (hi2c->ErrorCode & ~HAL_I2C_ERROR_AF)
+    {
+        key_tx_pending = 0;
+        i2c_listen_restart = 1;
+    }
+
     i2c_busy = 0;
     HAL_I2C_EnableListen_IT(hi2c);
+
+    bench_record(BENCH_I2C_ERROR, start);
 }
 
 void I2C_Error_Handler(void)
 {
-    __disable_irq();
-    while (1)
-    {
-    }
+    crashlog_error(CRASHLOG_CAUSE_I2C_ERROR, (uint32_t)(uintptr_t)__builtin_return_address(0));
 }
 
-void I2C1_EV_IRQHandler(void)
+HOT_CODE void I2C1_EV_IRQHandler(void)
 {
+    cpuload_frame_t frame = cpuload_enter();
+
     HAL_I2C_EV_IRQHandler(&hi2c1);
+    cpuload_exit(CPULOAD_I2C, frame);
 }
 
-void I2C1_ER_IRQHandler(void)
+HOT_CODE void I2C1_ER_IRQHandler(void)
 {
+    cpuload_frame_t frame = cpuload_enter();
+
     HAL_I2C_ER_IRQHandler(&hi2c1);
+    cpuload_exit(CPULOAD_I2C, frame);
 }
@@ -22,60 +22,22 @@
  */
 
 #include "keyboard.h"
-
-/* Definitions */
-#define NUM_COLS 5
-#define NUM_ROWS 7
-#define PRESS_AND_HOLD_COUNT 50
-
-/* Special characters */
-#define S_ALT    'a'
-#define S_ENTER  '\n'
-#define S_BACK   '\r'
-#define S_LSHIFT 'l'
-#define S_RSHIFT 'r'
-#define S_UNUSED  0
-#define S_SYM    'c'
-
-/* Alt, Left shift, and Right shift Row/col */
-#define ROW_ALT     4
-#define COL_ALT     0
-#define ROW_RSHIFT  3
-#define COL_RSHIFT  2
-#define ROW_LSHIFT  6
-#define COL_LSHIFT  1
-#define ROW_SYM     2
-#define COL_SYM     0
-
-/* Port and pin definitions */
-GPIO_TypeDef* col_ports[NUM_COLS] = {GPIOA,      GPIOA,      GPIOA,       GPIOA,       GPIOA     };
-uint16_t      col_pins[NUM_COLS]  = {GPIO_PIN_0, GPIO_PIN_1, GPIO_PIN_2,  GPIO_PIN_3,  GPIO_PIN_4 };
-
-GPIO_TypeDef* row_ports[NUM_ROWS] = {GPIOB,      GPIOB,      GPIOA,       GPIOB,       GPIOC,       GPIOB,       GPIOB       };
-uint16_t      row_pins[NUM_ROWS]  = {GPIO_PIN_0, GPIO_PIN_1, GPIO_PIN_12, GPIO_PIN_3,  GPIO_PIN_15, GPIO_PIN_5,  GPIO_PIN_15 };
-
-/* Primary key mapping  */
-const char key_mapping[NUM_ROWS][NUM_COLS] = {
-    { 'Q',       'E',       'R',       'U',       'O'       },
-    { 'W',       'S',       'G',       'H',       'L'       },
-    { S_SYM,     'D',       'T',       'Y',       'I'       },
-    { 'A',       'P',       S_RSHIFT,  S_ENTER,   S_BACK    },
-    { S_ALT,     'X',       'V',       'B',       '$'       },
-    { ' ',       'Z',       'C',       'N',       'M'       },
-    { S_UNUSED,  S_LSHIFT,  'F',       'J',       'K'       }
-};
-
-/* Alternate key mapping */
-// 0 = no alternate character
-const char alt_key_mapping[NUM_ROWS][NUM_COLS] = {
-    { '#',       '2',       '3',       '_',       '+'       },
-    { '1',       '4',       '/',       ':',       '"'       },
-    {  S_UNUSED, '5',       '(',       ')',       '-'       },
-    { '*',       '@',       S_UNUSED,  S_UNUSED,  S_UNUSED  },
-    {  S_UNUSED, '8',       '?',       '!',       S_UNUSED  },
-    {  S_UNUSED, '7',       '9',       ',',       '.'       },
-    { '0',        S_UNUSED, '6',       ';',       '\''      }
-};
+#include "capture.h"
+#include "config.h"
+#include "edge.h"
+#include "keymap.h"
+#include "preempt.h"
+#include "ramcode.h"
+#include "selftest.h"
+#include "timebase.h"
+#include <string.h>
+
+/* Port and pin definitions, the scan itself is unrolled in board_gen.h */
+static GPIO_TypeDef *const col_ports[NUM_COLS] = BOARD_COL_PORTS;
+static const uint16_t      col_pins[NUM_COLS]  = BOARD_COL_PINS;
+
+static GPIO_TypeDef *const row_ports[NUM_ROWS] = BOARD_ROW_PORTS;
+static const uint16_t      row_pins[NUM_ROWS]  = BOARD_ROW_PINS;
 
 /* Global variables */
 // Following are volatile mostly because of live debugging purposes
@@ -91,6 +53,24 @@ volatile uint8_t lshift_key_pressed = 0;
 uint8_t press_and_hold_active = 0;
 uint8_t caps_lock_mode = 0;
 
+// Last caps lock toggle, sym only toggles again once the debounce time has passed
+static uint32_t sym_toggle_tick = 0;
+static uint8_t sym_toggled = 0;
+
+// Settle time per column measured at boot, used while CFG_COL_SETTLE_AUTO is set
+static uint16_t col_settle_cal[NUM_COLS];
+
+// When the key the last scan found went down, see keyboard_key_stamp()
+static uint32_t key_stamp = 0;
+
+// Key that went down last, the one decoded and repeated while keys roll over
+static uint8_t key_last_row = 0;
+static uint8_t key_last_col = 0;
+
+// Double buffered key state snapshot, I2C ISR only ever copies the published buffer
+static uint8_t key_state_snapshot[2][KEYBOARD_STATE_SIZE];
+static volatile uint8_t key_state_snapshot_idx = 0;
+
 /* Functions */
 static uint8_t is_lowercase(char c)
 {
@@ -124,89 +104,311 @@ static char to_lowercase (char c)
     return c + 32;
 }
 
-char keyboard_find_key()
+static void keyboard_publish_state(void)
 {
-    // Fill in key_pressed_end_result based on the GPIO matrix, identify additional keys pressed
-    for (int c = 0; c < NUM_COLS; c++)
+    uint8_t next = key_state_snapshot_idx ^ 1;
+    uint8_t *snapshot = key_state_snapshot[next];
+    uint8_t modifiers = 0;
+
+    memset(snapshot, 0, KEYBOARD_STATE_SIZE);
+
+    for (int r = 0; r < NUM_ROWS; r++)
     {
-        for (int r = 0; r < NUM_ROWS; r++)
+        for (int c = 0; c < NUM_COLS; c++)
         {
             if (key_state[r][c])
             {
-                // if alt, left shift, or right shift, we already set the flag in keyboard_scan()
-                if (key_mapping[r][c] == S_ALT ||
-                    key_mapping[r][c] == S_RSHIFT ||
-                    key_mapping[r][c] == S_LSHIFT ||
-                    key_mapping[r][c] == S_SYM)
-                {
-                    return S_UNUSED;
-                }
+                uint8_t bit = r * NUM_COLS + c;
+                snapshot[bit >> 3] |= (1 << (bit & 7));
+            }
+        }
+    }
 
-                else if (alt_key_pressed)
-                {
-                    if (alt_key_mapping[r][c] != S_UNUSED)
-                        key_pressed_end_result = alt_key_mapping[r][c];
-                    else
-                        key_pressed_end_result = key_mapping[r][c];
-
-                    alt_key_pressed = 0;
-                    rshift_key_pressed = 0;
-                    lshift_key_pressed = 0;
-                }
-                else if (rshift_key_pressed || lshift_key_pressed || caps_lock_mode)
-                {
-                    if (is_lowercase(key_pressed_end_result))
-                    {
-                        key_pressed_end_result = to_capitalletter(key_mapping[r][c]);
-                    }
-                    else
-                    {
-                        key_pressed_end_result = key_mapping[r][c];
-                    }
-
-                    alt_key_pressed = 0;
-                    rshift_key_pressed = 0;
-                    lshift_key_pressed = 0;
-                }
-                else if (is_uppercase(key_mapping[r][c]))
-                {
-                    key_pressed_end_result = to_lowercase(key_mapping[r][c]);
-                }
-                else
-                {
-                    key_pressed_end_result = key_mapping[r][c];
-                }
+    if (key_state[ROW_ALT][COL_ALT])
+        modifiers |= KEY_MOD_ALT;
+    if (key_state[ROW_LSHIFT][COL_LSHIFT])
+        modifiers |= KEY_MOD_LSHIFT;
+    if (key_state[ROW_RSHIFT][COL_RSHIFT])
+        modifiers |= KEY_MOD_RSHIFT;
+    if (key_state[ROW_SYM][COL_SYM])
+        modifiers |= KEY_MOD_SYM;
+    if (alt_key_pressed)
+        modifiers |= KEY_MOD_ALT_LATCH;
+    if (rshift_key_pressed || lshift_key_pressed)
+        modifiers |= KEY_MOD_SHIFT_LATCH;
+    if (caps_lock_mode)
+        modifiers |= KEY_MOD_CAPS_LOCK;
+
+    snapshot[KEYBOARD_BITMAP_SIZE] = modifiers;
+
+    // Single byte store makes the new snapshot visible atomically
+    PREEMPT_POINT();
+    key_state_snapshot_idx = next;
+}
 
-                last_pressed_key = key_pressed_end_result;
-            }
+static uint8_t keyboard_is_last_key(int r, int c)
+{
+    return key_last_row == r && key_last_col == c;
+}
+
+HOT_CODE char keyboard_find_key()
+{
+    // Decode through the RAM cached active keymap, swapped atomically on upload
+    const char (*key_mapping)[NUM_COLS] = keymap_active()->primary;
+    const char (*alt_key_mapping)[NUM_COLS] = keymap_active()->alt;
+
+    // Decode the key that went down last, not every key still held with it
+    int r = key_last_row;
+    int c = key_last_col;
+
+    keyboard_publish_state();
+
+    // Released already, a key held from before it does not count as pressed again
+    if (!key_state[r][c])
+        return S_UNUSED;
+
+    // if alt, left shift, or right shift, we already set the flag in keyboard_scan()
+    if (key_mapping[r][c] == S_ALT ||
+        key_mapping[r][c] == S_RSHIFT ||
+        key_mapping[r][c] == S_LSHIFT ||
+        key_mapping[r][c] == S_SYM)
+    {
+        return S_UNUSED;
+    }
+
+    else if (alt_key_pressed)
+    {
+        if (alt_key_mapping[r][c] != S_UNUSED)
+            key_pressed_end_result = alt_key_mapping[r][c];
+        else
+            key_pressed_end_result = key_mapping[r][c];
+
+        alt_key_pressed = 0;
+        rshift_key_pressed = 0;
+        lshift_key_pressed = 0;
+    }
+    else if (rshift_key_pressed || lshift_key_pressed || caps_lock_mode)
+    {
+        if (is_lowercase(key_pressed_end_result))
+        {
+            key_pressed_end_result = to_capitalletter(key_mapping[r][c]);
         }
-     }
+        else
+        {
+            key_pressed_end_result = key_mapping[r][c];
+        }
+
+        alt_key_pressed = 0;
+        rshift_key_pressed = 0;
+        lshift_key_pressed = 0;
+    }
+    else if (is_uppercase(key_mapping[r][c]))
+    {
+        key_pressed_end_result = to_lowercase(key_mapping[r][c]);
+    }
+    else
+    {
+        key_pressed_end_result = key_mapping[r][c];
+    }
+
+    last_pressed_key = key_pressed_end_result;
 
     return last_pressed_key;
 }
 
-void keyboard_row_test(void)
+static uint32_t keyboard_row_rise(int r, board_row_mask_t level, uint32_t timeout)
 {
+    // Discharge the row, then time its pull-up bringing it back to its level
     GPIO_InitTypeDef GPIO_InitStruct = {0};
-    GPIO_InitStruct.Mode  = GPIO_MODE_OUTPUT_PP;
-    GPIO_InitStruct.Pull  = GPIO_NOPULL;
+    uint32_t start;
+    uint32_t elapsed;
+
+    GPIO_InitStruct.Pin = row_pins[r];
+    GPIO_InitStruct.Mode = GPIO_MODE_OUTPUT_PP;
+    GPIO_InitStruct.Pull = GPIO_NOPULL;
     GPIO_InitStruct.Speed = GPIO_SPEED_FREQ_LOW;
+    HAL_GPIO_WritePin(row_ports[r], row_pins[r], GPIO_PIN_RESET);
+    HAL_GPIO_Init(row_ports[r], &GPIO_InitStruct);
+
+    GPIO_InitStruct.Mode = GPIO_MODE_INPUT;
+    GPIO_InitStruct.Pull = GPIO_PULLUP;
+    HAL_GPIO_Init(row_ports[r], &GPIO_InitStruct);
+    start = timebase_now();
+
+    do
+    {
+        elapsed = timebase_now() - start;
+    } while (((board_read_rows() ^ level) & (1U << r)) && elapsed < timeout);
+
+    return elapsed;
+}
+
+static void keyboard_cols_output(uint32_t outputs)
+{
+    // Columns in outputs are push-pull driven high, the others pulled-up inputs
+    GPIO_InitTypeDef GPIO_InitStruct = {0};
+
+    GPIO_InitStruct.Speed = GPIO_SPEED_FREQ_LOW;
+    for (int c = 0; c < NUM_COLS; c++)
+    {
+        uint8_t output = (outputs >> c) & 1;
+
+        HAL_GPIO_WritePin(col_ports[c], col_pins[c], GPIO_PIN_SET);
+        GPIO_InitStruct.Pin = col_pins[c];
+        GPIO_InitStruct.Mode = output ? GPIO_MODE_OUTPUT_PP : GPIO_MODE_INPUT;
+        GPIO_InitStruct.Pull = output ? GPIO_NOPULL : GPIO_PULLUP;
+        HAL_GPIO_Init(col_ports[c], &GPIO_InitStruct);
+    }
+}
+
+static void keyboard_calibrate_settle(void)
+{
+    uint32_t max_us = config_get(CFG_COL_SETTLE_US);
+    uint32_t cycles_per_us = SystemCoreClock / 1000000;
+    uint32_t timeout = max_us * cycles_per_us;
+
+    for (int c = 0; c < NUM_COLS; c++)
+    {
+        board_row_mask_t level;
+        uint32_t slowest = 0;
+        uint32_t settle_us;
+
+        // The rows' level with only this column driven, after the configured
+        // settle time. A key held on another column then ties the row being
+        // discharged to an input, not to a column driving it high.
+        keyboard_cols_output(1U << c);
+        HAL_GPIO_WritePin(col_ports[c], col_pins[c], GPIO_PIN_RESET);
+        timebase_delay_us(max_us);
+        level = board_read_rows();
+
+        for (int r = 0; r < NUM_ROWS && slowest < timeout; r++)
+        {
+            // Held low by a key on this column, there is no rise to time
+            if (level & (1U << r))
+                continue;
+
+            for (int i = 0; i < KEYBOARD_SETTLE_REPEATS; i++)
+            {
+                uint32_t rise = keyboard_row_rise(r, level, timeout);
+
+                if (rise > slowest)
+                    slowest = rise;
+            }
+        }
+
+        HAL_GPIO_WritePin(col_ports[c], col_pins[c], GPIO_PIN_SET);
+
+        // A row that never got back keeps the column at the configured time
+        settle_us = 2 * ((slowest + cycles_per_us - 1) / cycles_per_us) + KEYBOARD_SETTLE_MARGIN_US;
+        if (slowest >= timeout || settle_us > max_us)
+            settle_us = max_us;
+
+        col_settle_cal[c] = (uint16_t)settle_us;
+    }
 
-    for (int r = 0; r < NUM_ROWS; r++) {
-        GPIO_InitStruct.Pin = row_pins[r];
-        HAL_GPIO_Init(row_ports[r], &GPIO_InitStruct);
-        HAL_GPIO_WritePin(row_ports[r], row_pins[r], GPIO_PIN_SET);
-        HAL_Delay(1000);
-        HAL_GPIO_WritePin(row_ports[r], row_pins[r], GPIO_PIN_RESET);
-        HAL_Delay(1000);
+    keyboard_cols_output((1U << NUM_COLS) - 1);
+}
+
+static void keyboard_settle_us(uint16_t settle_us[NUM_COLS])
+{
+    // Calibrated times, bounded by the configured one should it shrink later
+    uint16_t max_us = config_get(CFG_COL_SETTLE_US);
+    uint8_t calibrated = config_get(CFG_COL_SETTLE_AUTO);
+
+    for (int c = 0; c < NUM_COLS; c++)
+        settle_us[c] = (calibrated && col_settle_cal[c] < max_us) ? col_settle_cal[c] : max_us;
+}
+
+static void keyboard_drive_cols(uint32_t low)
+{
+    // Columns in low driven low, the others released high
+    for (int c = 0; c < NUM_COLS; c++)
+    {
+        if (low & (1U << c))
+            BOARD_PORT_BSRR(col_ports[c], (uint32_t)col_pins[c] << 16);
+        else
+            BOARD_PORT_BSRR(col_ports[c], col_pins[c]);
+    }
+}
+
+static board_row_mask_t keyboard_probe_cols(uint32_t low, uint16_t settle_us)
+{
+    keyboard_drive_cols(low);
+    timebase_delay_us(settle_us);
+    return board_read_rows();
+}
+
+static uint8_t keyboard_partial_scan(board_row_mask_t rows[NUM_COLS], const uint16_t settle_us[NUM_COLS],
+                                     const board_row_mask_t *parked)
+{
+    // Returns 1 with rows[] filled in, 0 when the full scan has to decide.
+    // parked: the rows read low with the columns parked, saves the first probe.
+    uint32_t all = (1U << NUM_COLS) - 1;
+    uint32_t clear = 0;
+    uint32_t first = 0;
+    uint32_t count = NUM_COLS;
+    uint16_t settle = 0;
+    board_row_mask_t active;
+    uint8_t present = 0;
+    uint8_t resolved = 0;
+
+    for (int c = 0; c < NUM_COLS; c++)
+    {
+        if (settle_us[c] > settle)
+            settle = settle_us[c];
+    }
+
+    memset(rows, 0, NUM_COLS * sizeof(rows[0]));
+
+    active = parked ? *parked : keyboard_probe_cols(all, settle);
+    if (active == 0)
+    {
+        resolved = 1;
     }
+    else if (!(active & (active - 1)))
+    {
+        // Halve the candidates, the lower half driven low on its own. A half
+        // that leaves the row high has no key, the other half is not probed.
+        while (count > 1)
+        {
+            uint32_t half_cols = ((1U << (count / 2)) - 1) << first;
+
+            if (keyboard_probe_cols(half_cols, settle) & active)
+            {
+                count /= 2;
+                present = (count == 1);
+            }
+            else
+            {
+                clear |= half_cols;
+                first += count / 2;
+                count -= count / 2;
+            }
+        }
+
+        // The column left must still pull the row low and no other column may
+        if (!present)
+            present = (keyboard_probe_cols(1U << first, settle) & active) != 0;
+
+        if (present)
+        {
+            uint32_t others = all & ~clear & ~(1U << first);
+
+            if (others == 0 || !(keyboard_probe_cols(others, settle) & active))
+            {
+                rows[first] = active;
+                resolved = 1;
+            }
+        }
+    }
+
+    board_release_cols();
+    return resolved;
 }
 
 void keyboard_init(void)
 {
-    __HAL_RCC_GPIOA_CLK_ENABLE();
-    __HAL_RCC_GPIOB_CLK_ENABLE();
-    __HAL_RCC_GPIOC_CLK_ENABLE();
+    BOARD_GPIO_CLK_ENABLE();
 
     GPIO_InitTypeDef GPIO_InitStruct = {0};
 
@@ -227,87 +429,171 @@ void keyboard_init(void)
         GPIO_InitStruct.Pin = row_pins[i];
         HAL_GPIO_Init(row_ports[i], &GPIO_InitStruct);
     }
+
+    keyboard_calibrate_settle();
 }
 
-void keyboard_scan(void)
+HOT_CODE void keyboard_scan(void)
 {
-    static uint8_t press_and_hold_ctr = 0;
-    uint8_t new_state[NUM_ROWS][NUM_COLS] = {0};
+    static uint8_t press_and_hold_timing = 0;
+    static uint32_t press_and_hold_start = 0;
+    board_row_mask_t rows[NUM_COLS];
+    uint16_t settle_us[NUM_COLS];
+    uint32_t stamps[NUM_ROWS];
+    board_row_mask_t parked_rows = 0;
+    uint8_t parked = edge_parked();
+    board_row_mask_t edges;
+    board_row_mask_t held = 0;
+    uint8_t stamped = 0;
     uint8_t any_key_pressed = 0;
 
     key_changed = 0;
+    key_stamp = timebase_now();
 
-    for (int c = 0; c < NUM_COLS; c++)
+    // Parked columns have every key down pulling its row low already
+    if (parked)
+        parked_rows = board_read_rows();
+
+    // Columns back from parking, rows that fell since the last scan come with a stamp
+    edges = edge_disarm(stamps);
+
+    // The self-test borrows the matrix one step per scan, no keys meanwhile
+    if (selftest_step())
+        return;
+
+    keyboard_settle_us(settle_us);
+    if (!config_get(CFG_PARTIAL_SCAN) || !keyboard_partial_scan(rows, settle_us, parked ? &parked_rows : NULL))
+        board_scan(rows, settle_us);
+    edge_arm();
+
+    capture_record(rows);
+    selftest_observe(rows);
+
+    // A row a key already held low did not fall for a new key on it
+    for (int r = 0; r < NUM_ROWS; r++)
     {
-        HAL_GPIO_WritePin(col_ports[c], col_pins[c], GPIO_PIN_RESET);
+        for (int c = 0; c < NUM_COLS; c++)
+        {
+            if (key_state[r][c])
+                held |= (board_row_mask_t)(1U << r);
+        }
+    }
 
-        HAL_Delay(1);
+    for (int c = 0; c < NUM_COLS; c++)
+    {
+        if (rows[c]) {
+            any_key_pressed = 1;  // track if any key is pressed, this is to make sure if all zeros (all keys released), we dont send anything
+        }
 
         for (int r = 0; r < NUM_ROWS; r++) {
-            new_state[r][c] = (HAL_GPIO_ReadPin(row_ports[r], row_pins[r]) == GPIO_PIN_RESET);
+            uint8_t pressed = (rows[c] >> r) & 1;
 
-            if (new_state[r][c]) {
-                any_key_pressed = 1;  // track if any key is pressed, this is to make sure if all zeros (all keys released), we dont send anything
-            }
-
-            if (new_state[r][c] != key_state[r][c])
+            if (pressed != key_state[r][c])
             {
-                key_state[r][c] = new_state[r][c];
-                key_changed = 1;
+                // The first new key takes its row's edge stamp, the scan confirms which key it was
+                if (pressed && !stamped)
+                {
+                    if ((edges & ~held) & (1U << r))
+                        key_stamp = stamps[r];
+                    stamped = 1;
+                }
+
+                key_state[r][c] = pressed;
+
+                // Only a key going down is sent, releasing one of several held keys is not
+                if (pressed)
+                {
+                    key_last_row = (uint8_t)r;
+                    key_last_col = (uint8_t)c;
+                    key_changed = 1;
+                }
             }
         }
-
-        HAL_GPIO_WritePin(col_ports[c], col_pins[c], GPIO_PIN_SET);
     }
 
     // If all keys are released (all zeros), do not mark as changed (key_changed=0).
-    // At the same time, detect press_and_hold situation and register key (key_changed=1) if certain amount of holds have occured (press_and_hold_ctr > PRESS_AND_HOLD_COUNT)
+    // At the same time, detect press_and_hold situation and register key (key_changed=1) once the last key pressed has been held for
+    // CFG_PRESS_AND_HOLD_MS, timed on the tick since the scan period depends on the settle calibration. Rollover restarts the timer.
     if (!any_key_pressed) {
         key_changed = 0;
-        press_and_hold_ctr = 0;
+        press_and_hold_timing = 0;
         press_and_hold_active = 0;
     }
     else
     {
-        press_and_hold_ctr++;
-        if (press_and_hold_ctr > PRESS_AND_HOLD_COUNT)
+        if (!press_and_hold_timing || key_changed)
+        {
+            press_and_hold_timing = 1;
+            press_and_hold_active = 0;
+            press_and_hold_start = HAL_GetTick();
+        }
+        if (HAL_GetTick() - press_and_hold_start >= config_get(CFG_PRESS_AND_HOLD_MS))
         {
             press_and_hold_active = 1;
             key_changed = 1;
         }
     }
 
-    // If alt, rshift, or lshift is pressed, do not mark as changed
-    if (key_state[ROW_ALT][COL_ALT])
+    // If alt, rshift, or lshift is the last key pressed, latch it for the next key. A key that goes down
+    // while the modifier is still held is sent right away and takes the latch, keyboard_find_key() skips
+    // the modifier itself
+    if (key_state[ROW_ALT][COL_ALT] && keyboard_is_last_key(ROW_ALT, COL_ALT))
     {
-        key_changed = 0;
         alt_key_pressed = 1;
     }
-    else if (key_state[ROW_RSHIFT][COL_RSHIFT])
+    else if (key_state[ROW_RSHIFT][COL_RSHIFT] && keyboard_is_last_key(ROW_RSHIFT, COL_RSHIFT))
     {
-        key_changed = 0;
         rshift_key_pressed = 1;
     }
-    else if (key_state[ROW_LSHIFT][COL_LSHIFT])
+    else if (key_state[ROW_LSHIFT][COL_LSHIFT] && keyboard_is_last_key(ROW_LSHIFT, COL_LSHIFT))
     {
-        key_changed = 0;
         lshift_key_pressed = 1;
     }
     else if (key_state[ROW_SYM][COL_SYM])  // sym will activate caps lock mode
     {
-        if(caps_lock_mode)
-            caps_lock_mode = 0;
-        else
-            caps_lock_mode = 1;
+        // Debounce caps lock mode to avoid toggling rapidly, without stalling the scan
+        if (!sym_toggled || HAL_GetTick() - sym_toggle_tick >= config_get(CFG_SYM_DEBOUNCE_MS))
+        {
+            if(caps_lock_mode)
+                caps_lock_mode = 0;
+            else
+                caps_lock_mode = 1;
 
-        key_changed = 0;
-        
-        // Debounce caps lock mode to avoid toggling rapidly
-        HAL_Delay(500);
+            sym_toggle_tick = HAL_GetTick();
+            sym_toggled = 1;
+        }
     }
+
+    keyboard_publish_state();
 }
 
 uint8_t keyboard_is_key_changed()
 {
     return key_changed;
 }
+
+uint32_t keyboard_key_stamp(void)
+{
+    return key_stamp;
+}
+
+uint8_t keyboard_get_state(uint8_t *buf)
+{
+    // Called from I2C ISR at address match, copies the last published snapshot
+    memcpy(buf, key_state_snapshot[key_state_snapshot_idx], KEYBOARD_STATE_SIZE);
+    return KEYBOARD_STATE_SIZE;
+}
+
+uint8_t keyboard_get_settle(uint8_t *buf)
+{
+    uint16_t settle_us[NUM_COLS];
+
+    keyboard_settle_us(settle_us);
+    for (int c = 0; c < NUM_COLS; c++)
+    {
+        buf[2 * c] = (uint8_t)settle_us[c];
+        buf[2 * c + 1] = (uint8_t)(settle_us[c] >> 8);
+    }
+
+    return 2 * NUM_COLS;
+}
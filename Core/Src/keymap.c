@@ -0,0 +1,248 @@
+/**
+ * Blackberry Q10 keyboard STM32 driver
+ * A fun little weekend project to act as a BBQ10 STM32 driver that is able to communicate with I2C bus masters.
+ * Creates rising-edge IRQ pulse, sends pressed character over I2C when master reads from slave upon receiving interrupt.
+ *
+ * Copyright (C) 2025 Mustafa Ozcelikors
+ *
+ * See GPLv3 LICENSE file in repository for licensing details.
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#include "keymap.h"
+#include "crashlog.h"
+#include "preempt.h"
+#include "trace.h"
+#include "watchdog.h"
+#include <string.h>
+
+/* Built-in keymap */
+static const keymap_t default_keymap = {
+    /* Primary and alternate key mapping from the board description, 0 = no character */
+    .primary = BOARD_KEYMAP_PRIMARY,
+    .alt     = BOARD_KEYMAP_ALT
+};
+
+// RAM cached keymaps, decode reads keymaps[keymap_idx], uploads go to the other one
+static keymap_t keymaps[2];
+static volatile uint8_t keymap_idx = 0;
+
+// CRC of each copy as of its activation, the status read returns the active one's
+static uint16_t keymap_crcs[2];
+static uint16_t keymap_default_crc;
+
+static volatile uint8_t keymap_status = KEYMAP_STATUS_IDLE;
+static volatile uint8_t keymap_save_pending = 0;
+static volatile uint8_t keymap_erase_pending = 0;
+
+// Activation waiting for keymap_service() to check the upload against this CRC
+static volatile uint8_t keymap_activate_pending = 0;
+static uint16_t keymap_activate_crc;
+
+static uint16_t keymap_crc16(const uint8_t *data, uint32_t len)
+{
+    // CRC-16/CCITT-FALSE
+    uint16_t crc = 0xFFFF;
+
+    for (uint32_t i = 0; i < len; i++)
+    {
+        crc ^= (uint16_t)data[i] << 8;
+        for (int b = 0; b < 8; b++)
+            crc = (crc & 0x8000) ? (uint16_t)((crc << 1) ^ 0x1021) : (uint16_t)(crc << 1);
+    }
+
+    return crc;
+}
+
+static uint32_t keymap_flash_read(uint32_t addr)
+{
+    return *(volatile uint32_t *)(uintptr_t)addr;
+}
+
+void keymap_init(void)
+{
+    // Slot layout: magic, length | crc << 16, keymap
+    const keymap_t *stored = (const keymap_t *)(uintptr_t)(KEYMAP_SLOT_ADDR + 8);
+    uint32_t info = keymap_flash_read(KEYMAP_SLOT_ADDR + 4);
+
+    keymap_default_crc = keymap_crc16((const uint8_t *)&default_keymap, KEYMAP_SIZE);
+
+    if (keymap_flash_read(KEYMAP_SLOT_ADDR) == KEYMAP_SLOT_MAGIC &&
+        (info & 0xFFFF) == KEYMAP_SIZE &&
+        (info >> 16) == keymap_crc16((const uint8_t *)stored, KEYMAP_SIZE))
+    {
+        memcpy(&keymaps[0], stored, KEYMAP_SIZE);
+        keymap_crcs[0] = (uint16_t)(info >> 16);
+    }
+    else
+    {
+        memcpy(&keymaps[0], &default_keymap, KEYMAP_SIZE);
+        keymap_crcs[0] = keymap_default_crc;
+    }
+
+    keymap_idx = 0;
+    keymap_activate_pending = 0;
+}
+
+const keymap_t *keymap_active(void)
+{
+    return &keymaps[keymap_idx];
+}
+
+uint8_t keymap_read(uint8_t offset, uint8_t *buf, uint8_t size)
+{
+    if (offset >= KEYMAP_SIZE)
+        return 0;
+
+    if (size > KEYMAP_SIZE - offset)
+        size = KEYMAP_SIZE - offset;
+
+    memcpy(buf, (const uint8_t *)keymap_active() + offset, size);
+    return size;
+}
+
+void keymap_write(uint8_t offset, const uint8_t *data, uint8_t len)
+{
+    // Upload goes to the inactive copy, decode is not affected until activation
+    uint8_t *staging = (uint8_t *)&keymaps[keymap_idx ^ 1];
+
+    // The upload being checked stays as the command found it
+    if (offset >= KEYMAP_SIZE || keymap_activate_pending)
+        return;
+
+    if (len > KEYMAP_SIZE - offset)
+        len = KEYMAP_SIZE - offset;
+
+    memcpy(staging + offset, data, len);
+
+    // A new upload during a save leaves the save's status to keymap_service()
+    if (!keymap_save_pending && !keymap_erase_pending)
+        keymap_status = KEYMAP_STATUS_IDLE;
+}
+
+void keymap_command(uint8_t cmd, uint16_t crc)
+{
+    // Runs in I2C ISR, the CRC check and flash work are left to keymap_service().
+    // A command while one is in progress is dropped, the status stays that one's
+    if (keymap_activate_pending || keymap_save_pending || keymap_erase_pending)
+        return;
+
+    switch (cmd)
+    {
+    case KEYMAP_CMD_ACTIVATE:
+        keymap_activate_crc = crc;
+        keymap_activate_pending = 1;
+        keymap_status = KEYMAP_STATUS_BUSY;
+        break;
+
+    case KEYMAP_CMD_DEFAULT:
+        memcpy(&keymaps[keymap_idx ^ 1], &default_keymap, KEYMAP_SIZE);
+        keymap_crcs[keymap_idx ^ 1] = keymap_default_crc;
+        keymap_idx ^= 1;
+        keymap_erase_pending = 1;
+        keymap_status = KEYMAP_STATUS_BUSY;
+        break;
+
+    default:
+        break;
+    }
+}
+
+uint8_t keymap_get_status(uint8_t *buf)
+{
+    uint16_t crc = keymap_crcs[keymap_idx];
+
+    buf[0] = keymap_status;
+    buf[1] = (uint8_t)crc;
+    buf[2] = (uint8_t)(crc >> 8);
+    return 3;
+}
+
+static void keymap_activate(void)
+{
+    // Main loop, the I2C ISR takes no commands and no uploads meanwhile
+    uint16_t crc = keymap_crc16((const uint8_t *)&keymaps[keymap_idx ^ 1], KEYMAP_SIZE);
+
+    if (crc != keymap_activate_crc)
+    {
+        keymap_status = KEYMAP_STATUS_BAD_CRC;
+        keymap_activate_pending = 0;
+        return;
+    }
+
+    // Single byte store switches decode over atomically, the save keeps
+    // further commands out and the status busy until it is done
+    keymap_crcs[keymap_idx ^ 1] = crc;
+    keymap_idx ^= 1;
+    keymap_save_pending = 1;
+    keymap_activate_pending = 0;
+}
+
+void keymap_service(void)
+{
+    FLASH_EraseInitTypeDef erase = {0};
+    uint32_t sector_error = 0;
+    uint32_t words[(KEYMAP_SIZE + 3) / 4];
+    HAL_StatusTypeDef status;
+
+    PREEMPT_POINT();
+    if (keymap_activate_pending)
+        keymap_activate();
+
+    PREEMPT_POINT();
+    if (!keymap_save_pending && !keymap_erase_pending)
+        return;
+
+    crashlog_event(CRASHLOG_EV_KEYMAP_SAVE, keymap_save_pending, 0);
+    TRACE("keymap: save %u, erase %u", keymap_save_pending, keymap_erase_pending);
+
+    // Private copy, the host may start another upload while flash is busy
+    memset(words, 0xFF, sizeof(words));
+    memcpy(words, keymap_active(), KEYMAP_SIZE);
+
+    erase.TypeErase = FLASH_TYPEERASE_SECTORS;
+    erase.Sector = KEYMAP_SLOT_SECTOR;
+    erase.NbSectors = 1;
+    erase.VoltageRange = FLASH_VOLTAGE_RANGE_3;
+
+    HAL_FLASH_Unlock();
+
+    watchdog_stall_begin();
+    status = HAL_FLASHEx_Erase(&erase, &sector_error);
+    watchdog_stall_end();
+
+    if (status == HAL_OK && keymap_save_pending)
+    {
+        uint16_t crc = keymap_crc16((const uint8_t *)words, KEYMAP_SIZE);
+
+        status = HAL_FLASH_Program(FLASH_TYPEPROGRAM_WORD, KEYMAP_SLOT_ADDR + 4, ((uint32_t)crc << 16) | KEYMAP_SIZE);
+
+        for (uint32_t i = 0; i < sizeof(words) / 4 && status == HAL_OK; i++)
+            status = HAL_FLASH_Program(FLASH_TYPEPROGRAM_WORD, KEYMAP_SLOT_ADDR + 8 + i * 4, words[i]);
+
+        // Magic last, an interrupted write leaves the slot invalid instead of corrupt
+        if (status == HAL_OK)
+            status = HAL_FLASH_Program(FLASH_TYPEPROGRAM_WORD, KEYMAP_SLOT_ADDR, KEYMAP_SLOT_MAGIC);
+    }
+
+    HAL_FLASH_Lock();
+
+    // Status before the pending flags, a command taken in between would be overwritten
+    PREEMPT_POINT();
+    keymap_status = (status == HAL_OK) ? KEYMAP_STATUS_OK : KEYMAP_STATUS_FLASH_ERR;
+
+    keymap_save_pending = 0;
+    keymap_erase_pending = 0;
+}
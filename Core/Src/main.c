@@ -22,8 +22,8 @@
  */
 
 #include "main.h"
-#include "keyboard.h"
-#include "i2c_slave.h"
+#include "app.h"
+#include "crashlog.h"
 
 void SystemClock_Config(void);
 static void MX_GPIO_Init(void);
@@ -36,31 +36,11 @@ int main(void)
 
     MX_GPIO_Init();
 
-    MX_I2C1_Init_Slave();
-
-    keyboard_init();
-
-#if 0
-    keyboard_row_test();
-#endif
+    app_init();
 
     while (1)
     {
-        keyboard_scan();
-
-        if (keyboard_is_key_changed())
-        {
-            char pressed = keyboard_find_key();
-
-            if (pressed)
-            {
-            	wait_i2c_busy();
-                set_i2c_txdata(pressed);
-                create_keychanged_irq_pulse();
-            }
-        }
-
-        HAL_Delay(1); // debounce/scan interval
+        app_step();
     }
 }
 
@@ -140,10 +120,8 @@ void Error_Handler(void)
 {
     /* USER CODE BEGIN Error_Handler_Debug */
     /* User can add his own implementation to report the HAL error return state */
-    __disable_irq();
-    while (1)
-    {
-    }
+    /* Leave a crash dump naming the caller and reset, see crashlog.h */
+    crashlog_error(CRASHLOG_CAUSE_ERROR, (uint32_t)(uintptr_t)__builtin_return_address(0));
     /* USER CODE END Error_Handler_Debug */
 }
 #ifdef USE_FULL_ASSERT
@@ -0,0 +1,48 @@
+/**
+ * Blackberry Q10 keyboard STM32 driver
+ * A fun little weekend project to act as a BBQ10 STM32 driver that is able to communicate with I2C bus masters.
+ * Creates rising-edge IRQ pulse, sends pressed character over I2C when master reads from slave upon receiving interrupt.
+ *
+ * Copyright (C) 2025 Mustafa Ozcelikors
+ *
+ * See GPLv3 LICENSE file in repository for licensing details.
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#include "ramcode.h"
+
+#ifdef VECTORS_IN_RAM
+#include <string.h>
+
+// Core exceptions plus the STM32F411 interrupts, SPI5 is the last one
+#define RAMCODE_VECTORS (16 + SPI5_IRQn + 1)
+
+extern const uint32_t g_pfnVectors[];
+
+// VTOR needs the table aligned to its size rounded up to a power of two
+static uint32_t ram_vectors[RAMCODE_VECTORS] __attribute__((section(".ram_vector"), aligned(512)));
+#endif
+
+void ramcode_init(void)
+{
+#ifdef VECTORS_IN_RAM
+    // Both tables are complete, an interrupt during the switch sees either
+    memcpy(ram_vectors, g_pfnVectors, sizeof(ram_vectors));
+    __DSB();
+    SCB->VTOR = (uint32_t)ram_vectors;
+    __DSB();
+    __ISB();
+#endif
+}
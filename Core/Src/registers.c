@@ -0,0 +1,221 @@
+/**
+ * Blackberry Q10 keyboard STM32 driver
+ * A fun little weekend project to act as a BBQ10 STM32 driver that is able to communicate with I2C bus masters.
+ * Creates rising-edge IRQ pulse, sends pressed character over I2C when master reads from slave upon receiving interrupt.
+ *
+ * Copyright (C) 2025 Mustafa Ozcelikors
+ *
+ * See GPLv3 LICENSE file in repository for licensing details.
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#include "registers.h"
+#include "bench.h"
+#include "capture.h"
+#include "config.h"
+#include "cpuload.h"
+#include "crashlog.h"
+#include "keyboard.h"
+#include "keymap.h"
+#include "selftest.h"
+#include "stats.h"
+#include "trace.h"
+#include "watchdog.h"
+
+/* Register access runs in I2C ISR context, keep handlers short */
+
+// Parameter selected for REG_CONFIG reads
+static uint8_t config_selected = 0;
+
+// Offset selected for REG_KEYMAP_DATA reads
+static uint8_t keymap_offset = 0;
+
+// Offset selected for REG_CAPTURE_DATA reads
+static uint16_t capture_offset = 0;
+
+// Probe selected for REG_BENCH_DATA and REG_BENCH_HIST reads
+static uint8_t bench_selected = 0;
+
+// Offset selected for REG_CRASH_DATA reads
+static uint16_t crash_offset = 0;
+
+// Offset selected for REG_STATS_DATA reads
+static uint8_t stats_offset = 0;
+
+// Ring slot selected for REG_TRACE_DATA reads
+static uint8_t trace_slot = 0;
+
+// Offset selected for REG_SELFTEST_DATA reads
+static uint8_t selftest_offset = 0;
+
+uint8_t registers_read(uint8_t reg, uint8_t *buf, uint8_t size)
+{
+    switch (reg)
+    {
+    case REG_KEY_STATE:
+        if (size < KEYBOARD_STATE_SIZE)
+            return 0;
+        return keyboard_get_state(buf);
+
+    case REG_CONFIG:
+    {
+        uint16_t value = config_get(config_selected);
+        buf[0] = (uint8_t)value;
+        buf[1] = (uint8_t)(value >> 8);
+        return 2;
+    }
+
+    case REG_KEYMAP_DATA:
+        return keymap_read(keymap_offset, buf, size);
+
+    case REG_KEYMAP_CTRL:
+        return keymap_get_status(buf);
+
+    case REG_CAPTURE_CTRL:
+        return capture_get_status(buf);
+
+    case REG_CAPTURE_DATA:
+        return capture_read(capture_offset, buf, size);
+
+    case REG_BENCH_CTRL:
+        return bench_get_status(buf);
+
+    case REG_BENCH_DATA:
+        if (size < 16)
+            return 0;
+        return bench_read(bench_selected, buf);
+
+    case REG_BENCH_HIST:
+        if (size < 2 * BENCH_HIST_BUCKETS)
+            return 0;
+        return bench_read_hist(bench_selected, buf);
+
+    case REG_CRASH_CTRL:
+        return crashlog_get_status(buf);
+
+    case REG_CRASH_DATA:
+        return crashlog_read(crash_offset, buf, size);
+
+    case REG_BOOT_REASON:
+        return watchdog_get_status(buf);
+
+    case REG_STATS_CTRL:
+        return stats_get_status(buf);
+
+    case REG_STATS_DATA:
+        return stats_read(stats_offset, buf, size);
+
+    case REG_TRACE_CTRL:
+        return trace_get_status(buf);
+
+    case REG_TRACE_DATA:
+        return trace_read(trace_slot, buf, size);
+
+    case REG_CPU_LOAD:
+        return cpuload_read(buf);
+
+    case REG_SELFTEST_CTRL:
+        return selftest_get_status(buf);
+
+    case REG_SELFTEST_DATA:
+        return selftest_read(selftest_offset, buf, size);
+
+    case REG_COL_SETTLE:
+        return keyboard_get_settle(buf);
+
+    default:
+        return 0;
+    }
+}
+
+void registers_write(uint8_t reg, const uint8_t *data, uint8_t len)
+{
+    switch (reg)
+    {
+    case REG_CONFIG:
+        config_selected = data[0];
+
+        // Stored in RAM right away, persisted to flash by the main loop
+        if (len >= 3)
+            config_set(data[0], (uint16_t)(data[1] | (data[2] << 8)));
+        break;
+
+    case REG_KEYMAP_DATA:
+        keymap_offset = data[0];
+
+        if (len > 1)
+            keymap_write(data[0], &data[1], len - 1);
+        break;
+
+    case REG_KEYMAP_CTRL:
+        if (len >= 3)
+            keymap_command(data[0], (uint16_t)(data[1] | (data[2] << 8)));
+        break;
+
+    case REG_CAPTURE_CTRL:
+        capture_command(data[0]);
+        break;
+
+    case REG_CAPTURE_DATA:
+        if (len >= 2)
+            capture_offset = (uint16_t)(data[0] | (data[1] << 8));
+        break;
+
+    case REG_BENCH_CTRL:
+        bench_command(data[0]);
+        break;
+
+    case REG_BENCH_DATA:
+    case REG_BENCH_HIST:
+        bench_selected = data[0];
+        break;
+
+    case REG_CRASH_CTRL:
+        crashlog_command(data[0]);
+        break;
+
+    case REG_CRASH_DATA:
+        if (len >= 2)
+            crash_offset = (uint16_t)(data[0] | (data[1] << 8));
+        break;
+
+    case REG_STATS_CTRL:
+        stats_command(data[0]);
+        break;
+
+    case REG_STATS_DATA:
+        stats_offset = data[0];
+        break;
+
+    case REG_TRACE_CTRL:
+        trace_command(data[0]);
+        break;
+
+    case REG_TRACE_DATA:
+        trace_slot = data[0];
+        break;
+
+    case REG_SELFTEST_CTRL:
+        selftest_command(data[0]);
+        break;
+
+    case REG_SELFTEST_DATA:
+        selftest_offset = data[0];
+        break;
+
+    default:
+        break;
+    }
+}
@@ -0,0 +1,293 @@
+/**
+ * Blackberry Q10 keyboard STM32 driver
+ * A fun little weekend project to act as a BBQ10 STM32 driver that is able to communicate with I2C bus masters.
+ * Creates rising-edge IRQ pulse, sends pressed character over I2C when master reads from slave upon receiving interrupt.
+ *
+ * Copyright (C) 2025 Mustafa Ozcelikors
+ *
+ * See GPLv3 LICENSE file in repository for licensing details.
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#include "selftest.h"
+#include "config.h"
+#include "timebase.h"
+#include "trace.h"
+
+/* Pin tables, the test drives and reads single lines */
+static GPIO_TypeDef *const col_ports[NUM_COLS] = BOARD_COL_PORTS;
+static const uint16_t      col_pins[NUM_COLS]  = BOARD_COL_PINS;
+
+static GPIO_TypeDef *const row_ports[NUM_ROWS] = BOARD_ROW_PORTS;
+static const uint16_t      row_pins[NUM_ROWS]  = BOARD_ROW_PINS;
+
+/* Steps, one per main loop iteration */
+#define SELFTEST_STEP_IDLE      0
+#define SELFTEST_STEP_COLS      1
+#define SELFTEST_STEP_COL_SHORT (SELFTEST_STEP_COLS + NUM_COLS)
+#define SELFTEST_STEP_ROW_SHORT (SELFTEST_STEP_COL_SHORT + NUM_COLS)
+#define SELFTEST_NUM_STEPS      (SELFTEST_STEP_ROW_SHORT + NUM_ROWS)
+
+#define SELFTEST_ALL_COLS ((uint32_t)((1ULL << NUM_COLS) - 1))
+
+typedef struct
+{
+    uint8_t  status;
+    uint8_t  faults;
+    uint8_t  rows;
+    uint8_t  cols;
+    uint32_t stuck_rows;
+    uint32_t stuck_cols;
+    uint32_t shorted_rows;
+    uint32_t shorted_cols;
+    uint32_t unseen_rows;
+    uint32_t unseen_cols;
+    uint32_t duration_us;
+    uint32_t closed[NUM_COLS];
+} selftest_result_t;
+
+_Static_assert(sizeof(selftest_result_t) == SELFTEST_SIZE, "self-test result layout");
+_Static_assert(NUM_COLS <= 32, "one bit per column");
+
+static selftest_result_t selftest_result = { .rows = NUM_ROWS, .cols = NUM_COLS };
+static uint8_t selftest_next = 0;
+static uint32_t selftest_start;
+
+// Commands from the I2C ISR, picked up by selftest_step()
+static volatile uint8_t selftest_pending_cmd = 0;
+
+static void selftest_line_mode(GPIO_TypeDef *port, uint16_t pin, uint32_t mode)
+{
+    GPIO_InitTypeDef GPIO_InitStruct = {0};
+
+    GPIO_InitStruct.Pin = pin;
+    GPIO_InitStruct.Mode = mode;
+    GPIO_InitStruct.Pull = (mode == GPIO_MODE_INPUT) ? GPIO_PULLUP : GPIO_NOPULL;
+    GPIO_InitStruct.Speed = GPIO_SPEED_FREQ_LOW;
+    HAL_GPIO_Init(port, &GPIO_InitStruct);
+}
+
+static void selftest_drive_low(GPIO_TypeDef *port, uint16_t pin)
+{
+    // Output register first, so the line never glitches high
+    HAL_GPIO_WritePin(port, pin, GPIO_PIN_RESET);
+    selftest_line_mode(port, pin, GPIO_MODE_OUTPUT_PP);
+}
+
+static void selftest_cols_mode(uint32_t mode)
+{
+    // Columns go back to idle high outputs, as keyboard_init() leaves them
+    for (int c = 0; c < NUM_COLS; c++)
+    {
+        HAL_GPIO_WritePin(col_ports[c], col_pins[c], GPIO_PIN_SET);
+        selftest_line_mode(col_ports[c], col_pins[c], mode);
+    }
+}
+
+static uint32_t selftest_cols_low(void)
+{
+    uint32_t low = 0;
+
+    for (int c = 0; c < NUM_COLS; c++)
+    {
+        if (HAL_GPIO_ReadPin(col_ports[c], col_pins[c]) == GPIO_PIN_RESET)
+            low |= 1U << c;
+    }
+
+    return low;
+}
+
+static void selftest_begin(void)
+{
+    selftest_result.faults = 0;
+    selftest_result.stuck_rows = 0;
+    selftest_result.stuck_cols = 0;
+    selftest_result.shorted_rows = 0;
+    selftest_result.shorted_cols = 0;
+    selftest_result.unseen_rows = BOARD_ROW_ALL;
+    selftest_result.unseen_cols = SELFTEST_ALL_COLS;
+    selftest_result.duration_us = 0;
+
+    for (int c = 0; c < NUM_COLS; c++)
+        selftest_result.closed[c] = 0;
+
+    // A test restarted halfway finds the columns as it left them
+    selftest_cols_mode(GPIO_MODE_OUTPUT_PP);
+
+    selftest_next = SELFTEST_STEP_IDLE;
+    selftest_start = timebase_now();
+    selftest_result.status = SELFTEST_STATE_RUNNING;
+}
+
+static void selftest_finish(void)
+{
+    selftest_result_t *res = &selftest_result;
+    uint8_t faults = 0;
+
+    if (res->stuck_rows)
+        faults |= SELFTEST_FAULT_STUCK_ROW;
+    if (res->stuck_cols)
+        faults |= SELFTEST_FAULT_STUCK_COL;
+    if (res->shorted_rows)
+        faults |= SELFTEST_FAULT_ROW_SHORT;
+    if (res->shorted_cols)
+        faults |= SELFTEST_FAULT_COL_SHORT;
+
+    for (int c = 0; c < NUM_COLS; c++)
+    {
+        if (res->closed[c])
+            faults |= SELFTEST_FAULT_CLOSED;
+    }
+
+    res->faults = faults;
+    res->duration_us = timebase_elapsed_us(selftest_start);
+
+    // Status last, the host polls it and then reads the rest
+    res->status = faults ? SELFTEST_STATE_FAIL : SELFTEST_STATE_PASS;
+
+    TRACE("selftest: faults 0x%x in %u us", faults, res->duration_us);
+}
+
+static void selftest_run_step(uint8_t step)
+{
+    selftest_result_t *res = &selftest_result;
+    uint32_t settle_us = config_get(CFG_COL_SETTLE_US);
+
+    if (step == SELFTEST_STEP_IDLE)
+    {
+        // Columns idle high, nothing may be low
+        res->stuck_rows = board_read_rows();
+        res->stuck_cols = selftest_cols_low();
+    }
+    else if (step < SELFTEST_STEP_COL_SHORT)
+    {
+        // One column low, the rows it pulls low with nothing pressed are closed
+        int c = step - SELFTEST_STEP_COLS;
+
+        HAL_GPIO_WritePin(col_ports[c], col_pins[c], GPIO_PIN_RESET);
+        timebase_delay_us(settle_us);
+        res->closed[c] = board_read_rows() & ~res->stuck_rows;
+        if (HAL_GPIO_ReadPin(col_ports[c], col_pins[c]) != GPIO_PIN_RESET)
+            res->stuck_cols |= 1U << c;
+        HAL_GPIO_WritePin(col_ports[c], col_pins[c], GPIO_PIN_SET);
+    }
+    else if (step < SELFTEST_STEP_ROW_SHORT)
+    {
+        // One column low, the others pulled-up inputs that must stay high
+        int c = step - SELFTEST_STEP_COL_SHORT;
+        uint32_t others;
+
+        if (c == 0)
+            selftest_cols_mode(GPIO_MODE_INPUT);
+
+        selftest_drive_low(col_ports[c], col_pins[c]);
+        timebase_delay_us(settle_us);
+        others = selftest_cols_low() & ~(1U << c) & ~res->stuck_cols;
+        if (others)
+            res->shorted_cols |= others | (1U << c);
+        selftest_line_mode(col_ports[c], col_pins[c], GPIO_MODE_INPUT);
+    }
+    else
+    {
+        // One row low, it must follow and the other rows must stay high.
+        // The columns stay pulled-up inputs from the steps before, so a
+        // closed or pressed key on the row never ties it to a driven column.
+        int r = step - SELFTEST_STEP_ROW_SHORT;
+        uint32_t closed = 0;
+        uint32_t low;
+        uint32_t others;
+
+        selftest_drive_low(row_ports[r], row_pins[r]);
+        timebase_delay_us(settle_us);
+        low = board_read_rows();
+        selftest_line_mode(row_ports[r], row_pins[r], GPIO_MODE_INPUT);
+
+        if (!(low & (1U << r)))
+            res->stuck_rows |= 1U << r;
+
+        // Rows that share a closed key's column with this one follow it
+        for (int c = 0; c < NUM_COLS; c++)
+        {
+            if (res->closed[c] & (1U << r))
+                closed |= res->closed[c];
+        }
+
+        others = low & ~(1U << r) & ~res->stuck_rows & ~closed;
+        if (others)
+            res->shorted_rows |= others | (1U << r);
+
+        if (r == NUM_ROWS - 1)
+            selftest_cols_mode(GPIO_MODE_OUTPUT_PP);
+    }
+}
+
+uint8_t selftest_step(void)
+{
+    // Main loop, in place of a scan. Returns 1 when the test used the matrix.
+    if (selftest_pending_cmd == SELFTEST_CMD_START)
+    {
+        selftest_pending_cmd = 0;
+        selftest_begin();
+    }
+
+    if (selftest_result.status != SELFTEST_STATE_RUNNING)
+        return 0;
+
+    selftest_run_step(selftest_next++);
+
+    if (selftest_next == SELFTEST_NUM_STEPS)
+        selftest_finish();
+
+    return 1;
+}
+
+void selftest_observe(const board_row_mask_t rows[NUM_COLS])
+{
+    // Open line detection, a line a key has been seen on is connected
+    for (int c = 0; c < NUM_COLS; c++)
+    {
+        if (rows[c])
+        {
+            selftest_result.unseen_rows &= ~(uint32_t)rows[c];
+            selftest_result.unseen_cols &= ~(1U << c);
+        }
+    }
+}
+
+void selftest_command(uint8_t cmd)
+{
+    // Runs in I2C ISR, the matrix is only touched by the main loop
+    selftest_pending_cmd = cmd;
+}
+
+uint8_t selftest_get_status(uint8_t *buf)
+{
+    buf[0] = selftest_result.status;
+    buf[1] = selftest_result.faults;
+    buf[2] = SELFTEST_SIZE;
+    return 3;
+}
+
+uint8_t selftest_read(uint8_t offset, uint8_t *buf, uint8_t size)
+{
+    const uint8_t *image = (const uint8_t *)&selftest_result;
+    uint8_t n = 0;
+
+    // Little endian like the target, the host build included
+    while (n < size && offset < SELFTEST_SIZE)
+        buf[n++] = image[offset++];
+
+    return n;
+}
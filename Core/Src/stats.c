@@ -0,0 +1,105 @@
+/**
+ * Blackberry Q10 keyboard STM32 driver
+ * A fun little weekend project to act as a BBQ10 STM32 driver that is able to communicate with I2C bus masters.
+ * Creates rising-edge IRQ pulse, sends pressed character over I2C when master reads from slave upon receiving interrupt.
+ *
+ * Copyright (C) 2025 Mustafa Ozcelikors
+ *
+ * See GPLv3 LICENSE file in repository for licensing details.
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#include "stats.h"
+
+// Counters that are restarted on clear instead of taken against a baseline
+#define STATS_LEVELS ((1U << STATS_SCAN_MIN) | (1U << STATS_SCAN_MAX) | (1U << STATS_FIFO_HIGH_WATER))
+
+volatile uint32_t stats_counter[STATS_NUM_COUNTERS];
+
+// Counter values at the last clear, and the snapshot, only touched by the I2C ISR
+static uint32_t stats_base[STATS_NUM_COUNTERS];
+static uint32_t stats_base_tick = 0;
+static uint32_t stats_snapshot[STATS_NUM_COUNTERS];
+static uint8_t stats_snapshots = 0;
+
+void stats_init(void)
+{
+    stats_counter[STATS_SCAN_MIN] = UINT32_MAX;
+    stats_base_tick = HAL_GetTick();
+}
+
+void stats_scan(uint32_t cycles)
+{
+    stats_count(STATS_SCANS);
+
+    if (cycles < stats_counter[STATS_SCAN_MIN])
+        stats_counter[STATS_SCAN_MIN] = cycles;
+    stats_level(STATS_SCAN_MAX, cycles);
+}
+
+void stats_command(uint8_t cmd)
+{
+    // Runs in I2C ISR
+    uint32_t now = HAL_GetTick();
+
+    if (cmd != STATS_CMD_SNAPSHOT && cmd != STATS_CMD_SNAPSHOT_CLEAR)
+        return;
+
+    for (uint8_t i = 0; i < STATS_NUM_COUNTERS; i++)
+    {
+        uint32_t value = stats_counter[i];
+
+        if (STATS_LEVELS & (1U << i))
+        {
+            stats_snapshot[i] = value;
+            if (cmd == STATS_CMD_SNAPSHOT_CLEAR)
+                stats_counter[i] = (i == STATS_SCAN_MIN) ? UINT32_MAX : 0;
+        }
+        else
+        {
+            stats_snapshot[i] = value - stats_base[i];
+            if (cmd == STATS_CMD_SNAPSHOT_CLEAR)
+                stats_base[i] = value;
+        }
+    }
+
+    if (stats_snapshot[STATS_SCAN_MIN] == UINT32_MAX)
+        stats_snapshot[STATS_SCAN_MIN] = 0;
+
+    stats_snapshot[STATS_ELAPSED_MS] = now - stats_base_tick;
+    if (cmd == STATS_CMD_SNAPSHOT_CLEAR)
+        stats_base_tick = now;
+
+    stats_snapshots++;
+}
+
+uint8_t stats_get_status(uint8_t *buf)
+{
+    buf[0] = STATS_NUM_COUNTERS;
+    buf[1] = stats_snapshots;
+    return 2;
+}
+
+uint8_t stats_read(uint8_t offset, uint8_t *buf, uint8_t size)
+{
+    const uint8_t *snapshot = (const uint8_t *)stats_snapshot;
+    uint8_t n = 0;
+
+    // Little endian like the target, the host build included
+    while (n < size && offset < STATS_SIZE)
+        buf[n++] = snapshot[offset++];
+
+    return n;
+}
@@ -0,0 +1,75 @@
+/**
+ * Blackberry Q10 keyboard STM32 driver
+ * A fun little weekend project to act as a BBQ10 STM32 driver that is able to communicate with I2C bus masters.
+ * Creates rising-edge IRQ pulse, sends pressed character over I2C when master reads from slave upon receiving interrupt.
+ *
+ * Copyright (C) 2025 Mustafa Ozcelikors
+ *
+ * See GPLv3 LICENSE file in repository for licensing details.
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#include "timebase.h"
+#include "ramcode.h"
+
+static uint32_t cycles_per_us = 16;
+
+// Cycle count at the timebase_us() base and the microseconds since init there
+static uint32_t base_cycles = 0;
+static uint32_t base_us = 0;
+
+void timebase_init(void)
+{
+    cycles_per_us = SystemCoreClock / 1000000U;
+    if (cycles_per_us == 0)
+        cycles_per_us = 1;
+
+    // Enable trace block and start the free running cycle counter
+    CoreDebug->DEMCR |= CoreDebug_DEMCR_TRCENA_Msk;
+    DWT->CYCCNT = 0;
+    DWT->CTRL |= DWT_CTRL_CYCCNTENA_Msk;
+
+    base_cycles = DWT->CYCCNT;
+    base_us = 0;
+}
+
+HOT_CODE uint32_t timebase_now(void)
+{
+    return DWT->CYCCNT;
+}
+
+HOT_CODE uint32_t timebase_elapsed_us(uint32_t since)
+{
+    return (DWT->CYCCNT - since) / cycles_per_us;
+}
+
+uint32_t timebase_us(uint32_t stamp)
+{
+    // Base up to now in whole microseconds, then back to the stamp
+    uint32_t us = (DWT->CYCCNT - base_cycles) / cycles_per_us;
+
+    base_cycles += us * cycles_per_us;
+    base_us += us;
+
+    return base_us + (uint32_t)((int32_t)(stamp - base_cycles) / (int32_t)cycles_per_us);
+}
+
+HOT_CODE void timebase_delay_us(uint32_t us)
+{
+    uint32_t start = DWT->CYCCNT;
+    uint32_t cycles = us * cycles_per_us;
+
+    while ((DWT->CYCCNT - start) < cycles);
+}
@@ -0,0 +1,116 @@
+/**
+ * Blackberry Q10 keyboard STM32 driver
+ * A fun little weekend project to act as a BBQ10 STM32 driver that is able to communicate with I2C bus masters.
+ * Creates rising-edge IRQ pulse, sends pressed character over I2C when master reads from slave upon receiving interrupt.
+ *
+ * Copyright (C) 2025 Mustafa Ozcelikors
+ *
+ * See GPLv3 LICENSE file in repository for licensing details.
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#include "trace.h"
+#include "timebase.h"
+#include <string.h>
+
+typedef struct
+{
+    uint32_t header;
+    uint32_t cycles;
+    uint32_t args[TRACE_MAX_ARGS];
+} trace_record_t;
+
+_Static_assert(sizeof(trace_record_t) == TRACE_RECORD_SIZE, "trace record layout");
+
+// Written from every priority level, always with interrupts off
+static trace_record_t trace_ring[TRACE_RECORDS];
+static uint16_t trace_head = 0;
+
+static uint8_t trace_itm_put(uint32_t word)
+{
+    // Never waits: a full stimulus FIFO means the SWO pin is behind, the
+    // caller drops the rest of the record and the decoder resynchronizes
+    if (ITM->PORT[TRACE_ITM_PORT].u32 == 0)
+        return 0;
+
+    ITM->PORT[TRACE_ITM_PORT].u32 = word;
+    return 1;
+}
+
+void trace_write(uint32_t header, uint32_t arg0, uint32_t arg1)
+{
+    uint32_t now = timebase_now();
+    uint32_t primask = __get_PRIMASK();
+    trace_record_t rec;
+
+    rec.cycles = now;
+    rec.args[0] = arg0;
+    rec.args[1] = arg1;
+
+    // Traced from the main loop, PendSV and the ISRs, also with interrupts
+    // masked, which stay masked
+    __disable_irq();
+
+    rec.header = header | (uint8_t)trace_head;
+    trace_ring[trace_head & (TRACE_RECORDS - 1)] = rec;
+    trace_head++;
+
+    __set_PRIMASK(primask);
+
+    // Only set up by a debugger, which also picks the SWO baud rate. A trace
+    // point in an ISR can land between the words of the one it preempted.
+    if ((ITM->TCR & ITM_TCR_ITMENA_Msk) && (ITM->TER & (1UL << TRACE_ITM_PORT)))
+    {
+        if (trace_itm_put(rec.header) && trace_itm_put(rec.cycles) && trace_itm_put(rec.args[0]))
+            trace_itm_put(rec.args[1]);
+    }
+}
+
+void trace_command(uint8_t cmd)
+{
+    // I2C ISR context, trace points are masked so they cannot interleave
+    if (cmd == TRACE_CMD_CLEAR)
+    {
+        memset(trace_ring, 0, sizeof(trace_ring));
+        trace_head = 0;
+    }
+}
+
+uint8_t trace_get_status(uint8_t *buf)
+{
+    // [records written lo, hi, ring size in records, record size]
+    uint16_t head = trace_head;
+
+    buf[0] = (uint8_t)head;
+    buf[1] = (uint8_t)(head >> 8);
+    buf[2] = TRACE_RECORDS;
+    buf[3] = TRACE_RECORD_SIZE;
+    return 4;
+}
+
+uint8_t trace_read(uint8_t slot, uint8_t *buf, uint8_t size)
+{
+    // Whole records from the selected ring slot on, wrapping around; the
+    // sequence byte tells the host whether a record was overwritten meanwhile
+    uint8_t n = 0;
+
+    while (n + TRACE_RECORD_SIZE <= size)
+    {
+        memcpy(&buf[n], &trace_ring[slot++ & (TRACE_RECORDS - 1)], TRACE_RECORD_SIZE);
+        n += TRACE_RECORD_SIZE;
+    }
+
+    return n;
+}
@@ -0,0 +1,159 @@
+/**
+ * Blackberry Q10 keyboard STM32 driver
+ * A fun little weekend project to act as a BBQ10 STM32 driver that is able to communicate with I2C bus masters.
+ * Creates rising-edge IRQ pulse, sends pressed character over I2C when master reads from slave upon receiving interrupt.
+ *
+ * Copyright (C) 2025 Mustafa Ozcelikors
+ *
+ * See GPLv3 LICENSE file in repository for licensing details.
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#include "watchdog.h"
+#include "timebase.h"
+#include "trace.h"
+
+/* IWDG key register values */
+#define IWDG_KEY_RELOAD 0xAAAAU
+#define IWDG_KEY_START  0xCCCCU
+#define IWDG_KEY_UNLOCK 0x5555U
+
+/* LSI divided by 32 counts milliseconds, by 256 every 8 ms */
+#define IWDG_PR_DIV32   3U
+#define IWDG_PR_DIV256  6U
+
+// PR and RLR reach the LSI domain within 5 LSI cycles, give up after that
+#define WATCHDOG_SYNC_US 1000
+
+static uint8_t boot_reason = WATCHDOG_BOOT_POWER_ON;
+static uint8_t boot_flags = 0;
+
+// HAL tick of each pipeline's last progress, written from its own context
+static volatile uint32_t progress_tick[WATCHDOG_CHANNELS];
+
+static void watchdog_sync(void)
+{
+    uint32_t start = timebase_now();
+
+    while ((IWDG->SR & (IWDG_SR_PVU | IWDG_SR_RVU)) &&
+           timebase_elapsed_us(start) < WATCHDOG_SYNC_US)
+    {
+    }
+}
+
+static void watchdog_configure(uint32_t prescaler, uint32_t reload)
+{
+    watchdog_sync();
+
+    // A reload from SysTick in between would lock the registers again
+    __disable_irq();
+    IWDG->KR = IWDG_KEY_UNLOCK;
+    IWDG->PR = prescaler;
+    IWDG->RLR = reload;
+    __enable_irq();
+
+    watchdog_sync();
+    IWDG->KR = IWDG_KEY_RELOAD;
+}
+
+static void watchdog_read_boot_reason(void)
+{
+    uint32_t csr = RCC->CSR;
+
+    // Every reset also pulls NRST, so the pin flag comes last
+    if (csr & (RCC_CSR_IWDGRSTF | RCC_CSR_WWDGRSTF))
+        boot_reason = WATCHDOG_BOOT_WATCHDOG;
+    else if (csr & RCC_CSR_SFTRSTF)
+        boot_reason = WATCHDOG_BOOT_SOFTWARE;
+    else if (csr & RCC_CSR_LPWRRSTF)
+        boot_reason = WATCHDOG_BOOT_LOW_POWER;
+    else if (csr & RCC_CSR_PORRSTF)
+        boot_reason = WATCHDOG_BOOT_POWER_ON;
+    else if (csr & RCC_CSR_BORRSTF)
+        boot_reason = WATCHDOG_BOOT_BROWNOUT;
+    else if (csr & RCC_CSR_PINRSTF)
+        boot_reason = WATCHDOG_BOOT_PIN;
+
+    boot_flags = (uint8_t)(csr >> 24);
+    TRACE("boot: reason %u, reset flags 0x%02x", boot_reason, boot_flags);
+
+    // The flags accumulate until cleared, the next reset reports only its own
+    RCC->CSR |= RCC_CSR_RMVF;
+}
+
+void watchdog_init(void)
+{
+    uint32_t now = HAL_GetTick();
+
+    watchdog_read_boot_reason();
+
+    for (uint8_t i = 0; i < WATCHDOG_CHANNELS; i++)
+        progress_tick[i] = now;
+
+    // Keep it from resetting the chip while the core is halted in the debugger
+    DBGMCU->APB1FZ |= DBGMCU_APB1_FZ_DBG_IWDG_STOP;
+
+    // Starting it also starts the LSI, it cannot be stopped until the next reset
+    IWDG->KR = IWDG_KEY_START;
+    watchdog_configure(IWDG_PR_DIV32, WATCHDOG_TIMEOUT_MS - 1);
+}
+
+uint8_t watchdog_boot_reason(void)
+{
+    return boot_reason;
+}
+
+uint8_t watchdog_get_status(uint8_t *buf)
+{
+    buf[0] = boot_reason;
+    buf[1] = boot_flags;
+    return 2;
+}
+
+void watchdog_progress(uint8_t channel)
+{
+    progress_tick[channel] = HAL_GetTick();
+}
+
+void watchdog_tick(uint32_t deadline_ms)
+{
+    // Runs from SysTick, a pipeline overdue starves the watchdog
+    uint32_t now = HAL_GetTick();
+
+    for (uint8_t i = 0; i < WATCHDOG_CHANNELS; i++)
+    {
+        if (now - progress_tick[i] > deadline_ms)
+            return;
+    }
+
+    IWDG->KR = IWDG_KEY_RELOAD;
+}
+
+void watchdog_stall_begin(void)
+{
+    // A sector erase stalls every fetch from flash, SysTick included
+    watchdog_configure(IWDG_PR_DIV256, WATCHDOG_STALL_MS / 8 - 1);
+}
+
+void watchdog_stall_end(void)
+{
+    uint32_t now = HAL_GetTick();
+
+    // The stall was planned, the pipelines get a fresh deadline
+    for (uint8_t i = 0; i < WATCHDOG_CHANNELS; i++)
+        progress_tick[i] = now;
+
+    watchdog_configure(IWDG_PR_DIV32, WATCHDOG_TIMEOUT_MS - 1);
+}
@@ -5,34 +5,79 @@
 
 # Add inputs and outputs from these tool invocations to the build variables 
 C_SRCS += \
+../Core/Src/app.c \
+../Core/Src/bench.c \
+../Core/Src/capture.c \
+../Core/Src/config.c \
+../Core/Src/cpuload.c \
+../Core/Src/crashlog.c \
+../Core/Src/edge.c \
 ../Core/Src/i2c_slave.c \
 ../Core/Src/keyboard.c \
+../Core/Src/keymap.c \
 ../Core/Src/main.c \
+../Core/Src/ramcode.c \
+../Core/Src/registers.c \
+../Core/Src/selftest.c \
+../Core/Src/stats.c \
 ../Core/Src/stm32f4xx_hal_msp.c \
 ../Core/Src/stm32f4xx_it.c \
 ../Core/Src/syscalls.c \
 ../Core/Src/sysmem.c \
-../Core/Src/system_stm32f4xx.c 
+../Core/Src/system_stm32f4xx.c \
+../Core/Src/timebase.c \
+../Core/Src/trace.c \
+../Core/Src/watchdog.c 
 
 OBJS += \
+./Core/Src/app.o \
+./Core/Src/bench.o \
+./Core/Src/capture.o \
+./Core/Src/config.o \
+./Core/Src/cpuload.o \
+./Core/Src/crashlog.o \
+./Core/Src/edge.o \
 ./Core/Src/i2c_slave.o \
 ./Core/Src/keyboard.o \
+./Core/Src/keymap.o \
 ./Core/Src/main.o \
+./Core/Src/ramcode.o \
+./Core/Src/registers.o \
+./Core/Src/selftest.o \
+./Core/Src/stats.o \
 ./Core/Src/stm32f4xx_hal_msp.o \
 ./Core/Src/stm32f4xx_it.o \
 ./Core/Src/syscalls.o \
 ./Core/Src/sysmem.o \
-./Core/Src/system_stm32f4xx.o 
+./Core/Src/system_stm32f4xx.o \
+./Core/Src/timebase.o \
+./Core/Src/trace.o \
+./Core/Src/watchdog.o 
 
 C_DEPS += \
+./Core/Src/app.d \
+./Core/Src/bench.d \
+./Core/Src/capture.d \
+./Core/Src/config.d \
+./Core/Src/cpuload.d \
+./Core/Src/crashlog.d \
+./Core/Src/edge.d \
 ./Core/Src/i2c_slave.d \
 ./Core/Src/keyboard.d \
+./Core/Src/keymap.d \
 ./Core/Src/main.d \
+./Core/Src/ramcode.d \
+./Core/Src/registers.d \
+./Core/Src/selftest.d \
+./Core/Src/stats.d \
 ./Core/Src/stm32f4xx_hal_msp.d \
 ./Core/Src/stm32f4xx_it.d \
 ./Core/Src/syscalls.d \
 ./Core/Src/sysmem.d \
-./Core/Src/system_stm32f4xx.d 
+./Core/Src/system_stm32f4xx.d \
+./Core/Src/timebase.d \
+./Core/Src/trace.d \
+./Core/Src/watchdog.d 
 
 
 # Each subdirectory must supply rules for building sources it contributes
@@ -42,7 +87,7 @@ Core/Src/%.o Core/Src/%.su Core/Src/%.cyclo: ../Core/Src/%.c Core/Src/subdir.mk
 clean: clean-Core-2f-Src
 
 clean-Core-2f-Src:
-	-$(RM) ./Core/Src/i2c_slave.cyclo ./Core/Src/i2c_slave.d ./Core/Src/i2c_slave.o ./Core/Src/i2c_slave.su ./Core/Src/keyboard.cyclo ./Core/Src/keyboard.d ./Core/Src/keyboard.o ./Core/Src/keyboard.su ./Core/Src/main.cyclo ./Core/Src/main.d ./Core/Src/main.o ./Core/Src/main.su ./Core/Src/stm32f4xx_hal_msp.cyclo ./Core/Src/stm32f4xx_hal_msp.d ./Core/Src/stm32f4xx_hal_msp.o ./Core/Src/stm32f4xx_hal_msp.su ./Core/Src/stm32f4xx_it.cyclo ./Core/Src/stm32f4xx_it.d ./Core/Src/stm32f4xx_it.o ./Core/Src/stm32f4xx_it.su ./Core/Src/syscalls.cyclo ./Core/Src/syscalls.d ./Core/Src/syscalls.o ./Core/Src/syscalls.su ./Core/Src/sysmem.cyclo ./Core/Src/sysmem.d ./Core/Src/sysmem.o ./Core/Src/sysmem.su ./Core/Src/system_stm32f4xx.cyclo ./Core/Src/system_stm32f4xx.d ./Core/Src/system_stm32f4xx.o ./Core/Src/system_stm32f4xx.su
+	-$(RM) ./Core/Src/app.cyclo ./Core/Src/app.d ./Core/Src/app.o ./Core/Src/app.su ./Core/Src/bench.cyclo ./Core/Src/bench.d ./Core/Src/bench.o ./Core/Src/bench.su ./Core/Src/capture.cyclo ./Core/Src/capture.d ./Core/Src/capture.o ./Core/Src/capture.su ./Core/Src/config.cyclo ./Core/Src/config.d ./Core/Src/config.o ./Core/Src/config.su ./Core/Src/cpuload.cyclo ./Core/Src/cpuload.d ./Core/Src/cpuload.o ./Core/Src/cpuload.su ./Core/Src/crashlog.cyclo ./Core/Src/crashlog.d ./Core/Src/crashlog.o ./Core/Src/crashlog.su ./Core/Src/edge.cyclo ./Core/Src/edge.d ./Core/Src/edge.o ./Core/Src/edge.su ./Core/Src/i2c_slave.cyclo ./Core/Src/i2c_slave.d ./Core/Src/i2c_slave.o ./Core/Src/i2c_slave.su ./Core/Src/keyboard.cyclo ./Core/Src/keyboard.d ./Core/Src/keyboard.o ./Core/Src/keyboard.su ./Core/Src/keymap.cyclo ./Core/Src/keymap.d ./Core/Src/keymap.o ./Core/Src/keymap.su ./Core/Src/main.cyclo ./Core/Src/main.d ./Core/Src/main.o ./Core/Src/main.su ./Core/Src/ramcode.cyclo ./Core/Src/ramcode.d ./Core/Src/ramcode.o ./Core/Src/ramcode.su ./Core/Src/registers.cyclo ./Core/Src/registers.d ./Core/Src/registers.o ./Core/Src/registers.su ./Core/Src/selftest.cyclo ./Core/Src/selftest.d ./Core/Src/selftest.o ./Core/Src/selftest.su ./Core/Src/stats.cyclo ./Core/Src/stats.d ./Core/Src/stats.o ./Core/Src/stats.su ./Core/Src/stm32f4xx_hal_msp.cyclo ./Core/Src/stm32f4xx_hal_msp.d ./Core/Src/stm32f4xx_hal_msp.o ./Core/Src/stm32f4xx_hal_msp.su ./Core/Src/stm32f4xx_it.cyclo ./Core/Src/stm32f4xx_it.d ./Core/Src/stm32f4xx_it.o ./Core/Src/stm32f4xx_it.su ./Core/Src/syscalls.cyclo ./Core/Src/syscalls.d ./Core/Src/syscalls.o ./Core/Src/syscalls.su ./Core/Src/sysmem.cyclo ./Core/Src/sysmem.d ./Core/Src/sysmem.o ./Core/Src/sysmem.su ./Core/Src/system_stm32f4xx.cyclo ./Core/Src/system_stm32f4xx.d ./Core/Src/system_stm32f4xx.o ./Core/Src/system_stm32f4xx.su ./Core/Src/timebase.cyclo ./Core/Src/timebase.d ./Core/Src/timebase.o ./Core/Src/timebase.su ./Core/Src/trace.cyclo ./Core/Src/trace.d ./Core/Src/trace.o ./Core/Src/trace.su ./Core/Src/watchdog.cyclo ./Core/Src/watchdog.d ./Core/Src/watchdog.o ./Core/Src/watchdog.su
 
 .PHONY: clean-Core-2f-Src
 
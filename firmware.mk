@@ -0,0 +1,69 @@
+# Firmware build settings shared by Makefile and qemu/Makefile.
+#
+# CONFIG selects the profile:
+#   Debug    -O0 -g3 -DDEBUG, the flags of the CubeIDE Debug configuration
+#   Release  -O2 with link time optimization, so the HAL GPIO/I2C calls and
+#            the small helpers of the hot paths inline across files
+# Both drop unused functions and data at link time (--gc-sections).
+
+FW_ROOT := $(patsubst %/,%,$(dir $(lastword $(MAKEFILE_LIST))))
+
+BOARD ?= bbq10
+CONFIG ?= Release
+PREFIX ?= arm-none-eabi-
+
+CC := $(PREFIX)gcc
+OBJCOPY := $(PREFIX)objcopy
+SIZE := $(PREFIX)size
+NM := $(PREFIX)nm
+
+ifeq ($(CONFIG),Debug)
+FW_OPT := -O0 -g3 -DDEBUG
+else ifeq ($(CONFIG),Release)
+FW_OPT := -O2 -g -flto
+else
+$(error CONFIG must be Debug or Release)
+endif
+
+# HOT_CODE_IN_RAM=1 runs the functions marked HOT_CODE from SRAM,
+# VECTORS_IN_RAM=1 moves the vector table there too (Core/Inc/ramcode.h).
+# Each combination builds in its own directory.
+FW_VARIANT :=
+ifeq ($(HOT_CODE_IN_RAM),1)
+FW_OPT += -DHOT_CODE_IN_RAM
+FW_VARIANT := $(FW_VARIANT)-ramcode
+endif
+ifeq ($(VECTORS_IN_RAM),1)
+FW_OPT += -DVECTORS_IN_RAM
+FW_VARIANT := $(FW_VARIANT)-ramvec
+endif
+
+FW_ARCH := -mcpu=cortex-m4 -mthumb -mfpu=fpv4-sp-d16 -mfloat-abi=hard
+
+FW_CFLAGS := $(FW_ARCH) $(FW_OPT) -std=gnu11 -Wall -ffunction-sections -fdata-sections --specs=nano.specs
+FW_CPPFLAGS := -DUSE_HAL_DRIVER -DSTM32F411xE -MMD -MP \
+	-I$(FW_ROOT)/Core/Inc \
+	-I$(FW_ROOT)/Drivers/STM32F4xx_HAL_Driver/Inc \
+	-I$(FW_ROOT)/Drivers/STM32F4xx_HAL_Driver/Inc/Legacy \
+	-I$(FW_ROOT)/Drivers/CMSIS/Device/ST/STM32F4xx/Include \
+	-I$(FW_ROOT)/Drivers/CMSIS/Include
+FW_ASFLAGS := $(FW_ARCH) -g3 -x assembler-with-cpp
+FW_LDFLAGS := $(FW_ARCH) $(FW_OPT) -T$(FW_ROOT)/STM32F411CEUX_FLASH.ld \
+	--specs=nosys.specs --specs=nano.specs -Wl,--gc-sections -static
+FW_LIBS := -Wl,--start-group -lc -lm -Wl,--end-group
+
+FW_HAL_SRCS := $(addprefix $(FW_ROOT)/Drivers/STM32F4xx_HAL_Driver/Src/stm32f4xx_hal, \
+	.c _cortex.c _dma.c _dma_ex.c _exti.c _flash.c _flash_ex.c _flash_ramfunc.c \
+	_gpio.c _i2c.c _i2c_ex.c _pwr.c _pwr_ex.c _rcc.c _rcc_ex.c)
+FW_CORE_SRCS := $(wildcard $(FW_ROOT)/Core/Src/*.c)
+FW_STARTUP := $(FW_ROOT)/Core/Startup/startup_stm32f411ceux.s
+
+vpath %.c $(FW_ROOT)/Core/Src $(FW_ROOT)/Drivers/STM32F4xx_HAL_Driver/Src
+vpath %.s $(FW_ROOT)/Core/Startup
+
+FW_BOARD_GEN := $(FW_ROOT)/Core/Inc/board_gen.h
+
+$(FW_BOARD_GEN): $(FW_ROOT)/board/$(BOARD).txt $(FW_ROOT)/tools/gen_board.py FORCE
+	python3 $(FW_ROOT)/tools/gen_board.py $< $@
+
+FORCE:
@@ -0,0 +1,39 @@
+/**
+ * Blackberry Q10 keyboard STM32 driver
+ * A fun little weekend project to act as a BBQ10 STM32 driver that is able to communicate with I2C bus masters.
+ * Creates rising-edge IRQ pulse, sends pressed character over I2C when master reads from slave upon receiving interrupt.
+ *
+ * Copyright (C) 2025 Mustafa Ozcelikors
+ *
+ * See GPLv3 LICENSE file in repository for licensing details.
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#ifndef HOST_CAPTURE_DECODE_H_
+#define HOST_CAPTURE_DECODE_H_
+
+#include "capture.h"
+
+/* Decoder for the matrix capture image (see capture.h). Calls frame_fn once
+ * per recorded scan, idle scans included, with the frame bitmap and the time
+ * since the previous callback (0 for idle scans, whose time is not stored). */
+
+typedef void (*capture_frame_fn)(const uint8_t bits[KEYBOARD_BITMAP_SIZE], uint32_t dt_us, void *ctx);
+
+/* Returns the number of frames, or -1 if the image is malformed or was
+ * captured on a matrix of a different size */
+long capture_decode(const uint8_t *image, size_t size, capture_frame_fn frame_fn, void *ctx);
+
+#endif /* HOST_CAPTURE_DECODE_H_ */
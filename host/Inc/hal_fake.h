@@ -0,0 +1,110 @@
+/**
+ * Blackberry Q10 keyboard STM32 driver
+ * A fun little weekend project to act as a BBQ10 STM32 driver that is able to communicate with I2C bus masters.
+ * Creates rising-edge IRQ pulse, sends pressed character over I2C when master reads from slave upon receiving interrupt.
+ *
+ * Copyright (C) 2025 Mustafa Ozcelikors
+ *
+ * See GPLv3 LICENSE file in repository for licensing details.
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#ifndef HOST_HAL_FAKE_H_
+#define HOST_HAL_FAKE_H_
+
+#include "stm32f4xx_hal.h"
+
+/* Test side of the fake HAL: virtual time, the key matrix, the IRQ output and
+ * an I2C master that injects bus events into the firmware's I2C callbacks. */
+
+#define FAKE_CPU_HZ          16000000U  // HSI, as configured by SystemClock_Config()
+#define FAKE_DWT_READ_CYCLES 4          // virtual cycles spent per DWT->CYCCNT read (busy-wait loop)
+
+/* Flash region mapped at its real address, sectors 0-7 of the F411CE */
+#define FAKE_FLASH_BASE 0x08000000U
+#define FAKE_FLASH_SIZE 0x00080000U
+
+/* Power-on state of every peripheral and of virtual time, flash contents are
+ * kept. After a reset of the firmware's own (NVIC_SystemReset(), watchdog) the
+ * RCC reset flags report that reset instead of a power-on. */
+void fake_reset(void);
+
+/* Virtual time, advanced by HAL_Delay(), DWT reads, flash operations and the tests */
+uint64_t fake_now_cycles(void);
+uint64_t fake_now_us(void);
+void fake_advance_us(uint64_t us);
+
+/* One shot alarm, fn runs as soon as virtual time reaches at_us, interrupting
+ * whatever the firmware is doing (delays, busy-waits). It may re-arm itself
+ * and may use the I2C master, like an ISR it must not advance time itself. */
+void fake_set_alarm(uint64_t at_us, void (*fn)(void));
+
+/* Called at every PREEMPT_POINT() and __enable_irq() of the firmware while
+ * interrupts are enabled, and once per HAL_Delay(). Runs like an ISR. */
+void fake_set_preempt_hook(void (*fn)(const char *file, int line));
+
+/* Interrupt controller, priority last given to HAL_NVIC_SetPriority() */
+uint32_t fake_nvic_priority(IRQn_Type irq);
+
+/* NVIC_SystemReset() and a watchdog expiry call fn, which must not return
+ * (longjmp back into the test). Without a hook a reset ends the program with
+ * an error. */
+void fake_set_reset_hook(void (*fn)(void));
+
+/* Stops the independent watchdog from counting, like a debugger halting the
+ * core does. For harnesses that call into the firmware piecemeal instead of
+ * running its main loop. Cleared by fake_reset(). */
+void fake_watchdog_freeze(uint8_t frozen);
+
+/* Key matrix */
+void fake_key_set(uint8_t row, uint8_t col, uint8_t pressed);
+void fake_keys_release_all(void);
+
+/* Matrix wiring, a property of the board that fake_reset() keeps. A grounded
+ * pin reads low whatever drives it, a short pulls both pins low while either
+ * is grounded or an output driving low. A row with a rise time keeps reading
+ * low for that long once nothing pulls it low any more; 0, the default, is an
+ * ideal line. */
+void fake_pin_ground(GPIO_TypeDef *port, uint16_t pin);
+void fake_pin_short(GPIO_TypeDef *a, uint16_t a_pin, GPIO_TypeDef *b, uint16_t b_pin);
+void fake_row_rise_us(uint8_t row, uint32_t us);
+
+/* Pin changes so far that left a pressed key tying a row output to a column
+ * output driving the other level, two push-pull drivers shorted */
+uint32_t fake_drive_contentions(void);
+
+/* IRQ_KEYCHANGED output (PB13) */
+uint32_t fake_irq_pulses(void);
+uint64_t fake_irq_last_rise_us(void);
+void fake_set_irq_hook(void (*fn)(void));  // called on every rising edge
+
+/* I2C master, the byte level calls return 1 when the slave ACKed */
+uint8_t fake_i2c_start(uint8_t addr, uint8_t read);
+uint8_t fake_i2c_write_byte(uint8_t byte);
+uint8_t fake_i2c_read_byte(uint8_t ack);
+void fake_i2c_stop(void);
+void fake_i2c_bus_error(void);
+uint8_t fake_i2c_listening(void);    // slave would ACK its address right now
+uint32_t fake_i2c_callbacks(void);   // HAL callbacks run so far, for bounding ISR work
+
+uint8_t fake_i2c_write(uint8_t addr, const uint8_t *data, uint8_t len);
+uint8_t fake_i2c_read(uint8_t addr, uint8_t *buf, uint8_t len);
+uint8_t fake_i2c_read_reg(uint8_t addr, uint8_t reg, uint8_t *buf, uint8_t len);
+
+/* Flash */
+void fake_flash_erase_all(void);
+uint32_t fake_flash_erase_count(void);
+
+#endif /* HOST_HAL_FAKE_H_ */
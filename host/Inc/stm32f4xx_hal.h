@@ -0,0 +1,450 @@
+/**
+ * Blackberry Q10 keyboard STM32 driver
+ * A fun little weekend project to act as a BBQ10 STM32 driver that is able to communicate with I2C bus masters.
+ * Creates rising-edge IRQ pulse, sends pressed character over I2C when master reads from slave upon receiving interrupt.
+ *
+ * Copyright (C) 2025 Mustafa Ozcelikors
+ *
+ * See GPLv3 LICENSE file in repository for licensing details.
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#ifndef HOST_STM32F4XX_HAL_H_
+#define HOST_STM32F4XX_HAL_H_
+
+/* Host stand-in for the STM32F4 HAL, just enough of it for the firmware in
+ * Core/Src to build and run on a workstation. Peripherals are modelled in
+ * hal_fake.c, tests drive them through hal_fake.h. Values of constants match
+ * the real HAL where the firmware could observe them. */
+
+#include <stdint.h>
+#include <stddef.h>
+
+/* Status */
+typedef enum
+{
+    HAL_OK      = 0x00U,
+    HAL_ERROR   = 0x01U,
+    HAL_BUSY    = 0x02U,
+    HAL_TIMEOUT = 0x03U
+} HAL_StatusTypeDef;
+
+#define __IO volatile
+
+/* Clock */
+extern uint32_t SystemCoreClock;
+
+void HAL_Delay(uint32_t Delay);
+uint32_t HAL_GetTick(void);
+
+/* Core debug, DWT cycle counter follows virtual time */
+typedef struct
+{
+    __IO uint32_t CTRL;
+    __IO uint32_t CYCCNT;
+} DWT_Type;
+
+typedef struct
+{
+    __IO uint32_t DHCSR;
+    __IO uint32_t DEMCR;
+} CoreDebug_Type;
+
+DWT_Type *fake_dwt(void);
+extern CoreDebug_Type fake_core_debug;
+
+#define DWT       (fake_dwt())
+#define CoreDebug (&fake_core_debug)
+
+/* Instrumentation trace, never enabled without a debugger */
+typedef struct
+{
+    __IO union
+    {
+        __IO uint8_t  u8;
+        __IO uint16_t u16;
+        __IO uint32_t u32;
+    } PORT[32];
+    __IO uint32_t TER;
+    __IO uint32_t TCR;
+} ITM_Type;
+
+extern ITM_Type fake_itm;
+
+#define ITM (&fake_itm)
+
+#define ITM_TCR_ITMENA_Msk (1UL << 0)
+
+#define CoreDebug_DHCSR_C_DEBUGEN_Msk (1UL << 0)
+#define CoreDebug_DEMCR_TRCENA_Msk (1UL << 24)
+#define DWT_CTRL_CYCCNTENA_Msk     (1UL << 0)
+
+/* Reset and clock control, only the reset flags. Flags and the RMVF clear
+ * take effect at the next millisecond of virtual time. */
+typedef struct
+{
+    __IO uint32_t CSR;
+} RCC_TypeDef;
+
+extern RCC_TypeDef fake_rcc;
+
+#define RCC (&fake_rcc)
+
+#define RCC_CSR_LPWRRSTF (1UL << 31)
+#define RCC_CSR_WWDGRSTF (1UL << 30)
+#define RCC_CSR_IWDGRSTF (1UL << 29)
+#define RCC_CSR_SFTRSTF  (1UL << 28)
+#define RCC_CSR_PORRSTF  (1UL << 27)
+#define RCC_CSR_PINRSTF  (1UL << 26)
+#define RCC_CSR_BORRSTF  (1UL << 25)
+#define RCC_CSR_RMVF     (1UL << 24)
+
+/* Independent watchdog, clocked by a 32 kHz LSI in virtual time. A key write
+ * takes effect at the next register access or millisecond; when it expires the
+ * fake resets like NVIC_SystemReset() does. PR and RLR updates complete at once. */
+typedef struct
+{
+    __IO uint32_t KR;
+    __IO uint32_t PR;
+    __IO uint32_t RLR;
+    __IO uint32_t SR;
+} IWDG_TypeDef;
+
+IWDG_TypeDef *fake_iwdg(void);
+
+#define IWDG (fake_iwdg())
+
+#define IWDG_SR_PVU (1UL << 0)
+#define IWDG_SR_RVU (1UL << 1)
+
+typedef struct
+{
+    __IO uint32_t APB1FZ;
+} DBGMCU_TypeDef;
+
+extern DBGMCU_TypeDef fake_dbgmcu;
+
+#define DBGMCU (&fake_dbgmcu)
+
+#define DBGMCU_APB1_FZ_DBG_IWDG_STOP (1UL << 12)
+
+/* Interrupts, the host build is single threaded */
+typedef enum
+{
+    PendSV_IRQn  = -2,
+    SysTick_IRQn = -1,
+    EXTI0_IRQn   = 6,
+    EXTI1_IRQn   = 7,
+    EXTI2_IRQn   = 8,
+    EXTI3_IRQn   = 9,
+    EXTI4_IRQn   = 10,
+    EXTI9_5_IRQn = 23,
+    I2C1_EV_IRQn = 31,
+    I2C1_ER_IRQn = 32,
+    EXTI15_10_IRQn = 40,
+    SPI5_IRQn    = 85
+} IRQn_Type;
+
+/* PRIMASK, the interleaving simulator does not preempt while it is set and
+ * takes a pending interrupt as soon as it is cleared (preempt.h) */
+void fake_irq_disable(void);
+void fake_irq_enable(const char *file, int line);
+uint32_t fake_irq_masked(void);
+void fake_preempt_point(const char *file, int line);
+
+#define __disable_irq()  fake_irq_disable()
+#define __enable_irq()   fake_irq_enable(__FILE__, __LINE__)
+#define __get_PRIMASK()  fake_irq_masked()
+#define __set_PRIMASK(m) do { if (m) fake_irq_disable(); else fake_irq_enable(__FILE__, __LINE__); } while (0)
+#define PREEMPT_POINT()  fake_preempt_point(__FILE__, __LINE__)
+
+void HAL_NVIC_SetPriority(IRQn_Type IRQn, uint32_t PreemptPriority, uint32_t SubPriority);
+void HAL_NVIC_EnableIRQ(IRQn_Type IRQn);
+void HAL_NVIC_SetPendingIRQ(IRQn_Type IRQn);
+
+/* System control block, setting PENDSVSET pends PendSV_Handler(). Like on the
+ * core it is taken at the next __ISB() or unmasking, once no interrupt runs.
+ * The fault status registers only hold what a test writes into them. */
+typedef struct
+{
+    __IO uint32_t ICSR;
+    __IO uint32_t VTOR;
+    __IO uint32_t SHCSR;
+    __IO uint32_t CFSR;
+    __IO uint32_t HFSR;
+    __IO uint32_t MMFAR;
+    __IO uint32_t BFAR;
+} SCB_Type;
+
+extern SCB_Type fake_scb;
+
+#define SCB (&fake_scb)
+
+#define SCB_ICSR_PENDSVSET_Msk      (1UL << 28)
+#define SCB_ICSR_VECTACTIVE_Msk     (0x1FFUL << 0)
+#define SCB_SHCSR_USGFAULTENA_Msk   (1UL << 18)
+#define SCB_SHCSR_BUSFAULTENA_Msk   (1UL << 17)
+#define SCB_SHCSR_MEMFAULTENA_Msk   (1UL << 16)
+
+void fake_isb(void);
+
+#define __DSB() ((void)0)
+#define __ISB() fake_isb()
+#define __BKPT(value) ((void)0)
+
+/* Runs the hook set with fake_set_reset_hook(), which must not return */
+void NVIC_SystemReset(void) __attribute__((noreturn));
+
+/* Exception handlers the fake runs: SysTick every millisecond of virtual time
+ * (HAL_SYSTICK_IRQHandler() on the target) and PendSV when pended */
+void HAL_SYSTICK_Callback(void);
+void PendSV_Handler(void);
+
+/* EXTI line handlers, run on a falling edge of a line routed to a GPIO
+ * input while it is unmasked, at the level of the I2C interrupt */
+void EXTI0_IRQHandler(void);
+void EXTI1_IRQHandler(void);
+void EXTI2_IRQHandler(void);
+void EXTI3_IRQHandler(void);
+void EXTI4_IRQHandler(void);
+void EXTI9_5_IRQHandler(void);
+void EXTI15_10_IRQHandler(void);
+
+/* GPIO */
+typedef struct
+{
+    uint32_t outputs;  // pins configured as output or alternate function
+    uint32_t pullups;  // input pins with pull-up
+    uint32_t ODR;
+} GPIO_TypeDef;
+
+typedef struct
+{
+    uint32_t Pin;
+    uint32_t Mode;
+    uint32_t Pull;
+    uint32_t Speed;
+    uint32_t Alternate;
+} GPIO_InitTypeDef;
+
+typedef enum
+{
+    GPIO_PIN_RESET = 0,
+    GPIO_PIN_SET
+} GPIO_PinState;
+
+extern GPIO_TypeDef fake_gpio_ports[8];
+
+#define GPIOA (&fake_gpio_ports[0])
+#define GPIOB (&fake_gpio_ports[1])
+#define GPIOC (&fake_gpio_ports[2])
+#define GPIOD (&fake_gpio_ports[3])
+#define GPIOE (&fake_gpio_ports[4])
+#define GPIOH (&fake_gpio_ports[7])
+
+#define GPIO_PIN_0  ((uint16_t)0x0001)
+#define GPIO_PIN_1  ((uint16_t)0x0002)
+#define GPIO_PIN_2  ((uint16_t)0x0004)
+#define GPIO_PIN_3  ((uint16_t)0x0008)
+#define GPIO_PIN_4  ((uint16_t)0x0010)
+#define GPIO_PIN_5  ((uint16_t)0x0020)
+#define GPIO_PIN_6  ((uint16_t)0x0040)
+#define GPIO_PIN_7  ((uint16_t)0x0080)
+#define GPIO_PIN_8  ((uint16_t)0x0100)
+#define GPIO_PIN_9  ((uint16_t)0x0200)
+#define GPIO_PIN_10 ((uint16_t)0x0400)
+#define GPIO_PIN_11 ((uint16_t)0x0800)
+#define GPIO_PIN_12 ((uint16_t)0x1000)
+#define GPIO_PIN_13 ((uint16_t)0x2000)
+#define GPIO_PIN_14 ((uint16_t)0x4000)
+#define GPIO_PIN_15 ((uint16_t)0x8000)
+
+#define GPIO_MODE_INPUT     0x00000000U
+#define GPIO_MODE_OUTPUT_PP 0x00000001U
+#define GPIO_MODE_OUTPUT_OD 0x00000011U
+#define GPIO_MODE_AF_PP     0x00000002U
+#define GPIO_MODE_AF_OD     0x00000012U
+#define GPIO_MODE_IT_FALLING 0x10210000U
+
+#define GPIO_NOPULL   0x00000000U
+#define GPIO_PULLUP   0x00000001U
+#define GPIO_PULLDOWN 0x00000002U
+
+#define GPIO_SPEED_FREQ_LOW 0x00000000U
+#define GPIO_AF4_I2C1       ((uint8_t)0x04)
+
+void HAL_GPIO_Init(GPIO_TypeDef *GPIOx, GPIO_InitTypeDef *GPIO_Init);
+GPIO_PinState HAL_GPIO_ReadPin(GPIO_TypeDef *GPIOx, uint16_t GPIO_Pin);
+void HAL_GPIO_WritePin(GPIO_TypeDef *GPIOx, uint16_t GPIO_Pin, GPIO_PinState PinState);
+
+/* Raw port access of the generated scan code (board_io.h) goes to the matrix model */
+uint32_t fake_gpio_read(GPIO_TypeDef *port);
+void fake_gpio_bsrr(GPIO_TypeDef *port, uint32_t value);
+
+#define BOARD_PORT_READ(port)        fake_gpio_read(port)
+#define BOARD_PORT_BSRR(port, value) fake_gpio_bsrr((port), (value))
+
+/* Clock gates have no effect */
+#define __HAL_RCC_GPIOA_CLK_ENABLE() do {} while (0)
+#define __HAL_RCC_GPIOB_CLK_ENABLE() do {} while (0)
+#define __HAL_RCC_GPIOC_CLK_ENABLE() do {} while (0)
+#define __HAL_RCC_GPIOD_CLK_ENABLE() do {} while (0)
+#define __HAL_RCC_GPIOE_CLK_ENABLE() do {} while (0)
+#define __HAL_RCC_GPIOH_CLK_ENABLE() do {} while (0)
+#define __HAL_RCC_I2C1_CLK_ENABLE()  do {} while (0)
+#define __HAL_RCC_SYSCFG_CLK_ENABLE() do {} while (0)
+
+/* External interrupt lines, HAL_GPIO_Init() in an interrupt mode routes the
+ * pin's line to its port, sets the trigger and unmasks it. Only falling edges
+ * are modelled, an edge on a masked line is lost as on the target. PR is
+ * cleared through the HAL macro, being write 1 to clear. */
+typedef struct
+{
+    __IO uint32_t IMR;
+    __IO uint32_t EMR;
+    __IO uint32_t RTSR;
+    __IO uint32_t FTSR;
+    __IO uint32_t SWIER;
+    __IO uint32_t PR;
+} EXTI_TypeDef;
+
+extern EXTI_TypeDef fake_exti_regs;
+#define EXTI (&fake_exti_regs)
+
+void fake_exti_clear(uint32_t lines);
+
+#define __HAL_GPIO_EXTI_GET_IT(lines)   (EXTI->PR & (lines))
+#define __HAL_GPIO_EXTI_CLEAR_IT(lines) fake_exti_clear(lines)
+
+/* I2C */
+typedef struct
+{
+    __IO uint32_t CR1;
+    __IO uint32_t CR2;
+    __IO uint32_t OAR1;
+    __IO uint32_t SR1;
+} I2C_TypeDef;
+
+extern I2C_TypeDef fake_i2c1_regs;
+#define I2C1 (&fake_i2c1_regs)
+
+typedef struct
+{
+    uint32_t ClockSpeed;
+    uint32_t DutyCycle;
+    uint32_t OwnAddress1;
+    uint32_t AddressingMode;
+    uint32_t DualAddressMode;
+    uint32_t OwnAddress2;
+    uint32_t GeneralCallMode;
+    uint32_t NoStretchMode;
+} I2C_InitTypeDef;
+
+typedef enum
+{
+    HAL_I2C_STATE_RESET          = 0x00U,
+    HAL_I2C_STATE_READY          = 0x20U,
+    HAL_I2C_STATE_BUSY           = 0x24U,
+    HAL_I2C_STATE_BUSY_TX        = 0x21U,
+    HAL_I2C_STATE_BUSY_RX        = 0x22U,
+    HAL_I2C_STATE_LISTEN         = 0x28U,
+    HAL_I2C_STATE_BUSY_TX_LISTEN = 0x29U,
+    HAL_I2C_STATE_BUSY_RX_LISTEN = 0x2AU
+} HAL_I2C_StateTypeDef;
+
+typedef struct
+{
+    I2C_TypeDef *Instance;
+    I2C_InitTypeDef Init;
+    uint8_t *pBuffPtr;
+    uint16_t XferSize;
+    __IO uint16_t XferCount;
+    __IO uint32_t XferOptions;
+    __IO HAL_I2C_StateTypeDef State;
+    __IO uint32_t ErrorCode;
+} I2C_HandleTypeDef;
+
+#define I2C_DUTYCYCLE_2          0x00000000U
+#define I2C_ADDRESSINGMODE_7BIT  0x00004000U
+#define I2C_DUALADDRESS_DISABLE  0x00000000U
+#define I2C_GENERALCALL_DISABLE  0x00000000U
+#define I2C_NOSTRETCH_DISABLE    0x00000000U
+#define I2C_ANALOGFILTER_ENABLE  0x00000000U
+
+#define I2C_DIRECTION_RECEIVE    0x00000000U
+#define I2C_DIRECTION_TRANSMIT   0x00000001U
+
+#define I2C_FIRST_AND_LAST_FRAME 0x00000008U
+
+#define HAL_I2C_ERROR_NONE 0x00000000U
+#define HAL_I2C_ERROR_BERR 0x00000001U
+#define HAL_I2C_ERROR_ARLO 0x00000002U
+#define HAL_I2C_ERROR_AF   0x00000004U
+#define HAL_I2C_ERROR_OVR  0x00000008U
+
+#define I2C_FLAG_BERR 0x00010100U
+#define I2C_FLAG_ARLO 0x00010200U
+#define I2C_FLAG_AF   0x00010400U
+#define I2C_FLAG_OVR  0x00010800U
+
+#define __HAL_I2C_CLEAR_FLAG(__HANDLE__, __FLAG__) \
+    ((__HANDLE__)->Instance->SR1 = ~((__FLAG__) & 0x0000FFFFU))
+
+HAL_StatusTypeDef HAL_I2C_Init(I2C_HandleTypeDef *hi2c);
+HAL_StatusTypeDef HAL_I2CEx_ConfigAnalogFilter(I2C_HandleTypeDef *hi2c, uint32_t AnalogFilter);
+HAL_StatusTypeDef HAL_I2C_EnableListen_IT(I2C_HandleTypeDef *hi2c);
+HAL_StatusTypeDef HAL_I2C_DisableListen_IT(I2C_HandleTypeDef *hi2c);
+HAL_I2C_StateTypeDef HAL_I2C_GetState(I2C_HandleTypeDef *hi2c);
+HAL_StatusTypeDef HAL_I2C_Slave_Seq_Receive_IT(I2C_HandleTypeDef *hi2c, uint8_t *pData, uint16_t Size, uint32_t XferOptions);
+HAL_StatusTypeDef HAL_I2C_Slave_Seq_Transmit_IT(I2C_HandleTypeDef *hi2c, uint8_t *pData, uint16_t Size, uint32_t XferOptions);
+void HAL_I2C_EV_IRQHandler(I2C_HandleTypeDef *hi2c);
+void HAL_I2C_ER_IRQHandler(I2C_HandleTypeDef *hi2c);
+
+/* Callbacks implemented by the firmware */
+void HAL_I2C_AddrCallback(I2C_HandleTypeDef *hi2c, uint8_t TransferDirection, uint16_t AddrMatchCode);
+void HAL_I2C_ListenCpltCallback(I2C_HandleTypeDef *hi2c);
+void HAL_I2C_SlaveRxCpltCallback(I2C_HandleTypeDef *hi2c);
+void HAL_I2C_SlaveTxCpltCallback(I2C_HandleTypeDef *hi2c);
+void HAL_I2C_ErrorCallback(I2C_HandleTypeDef *hi2c);
+
+/* Flash, mapped at its real address so the firmware can read it directly */
+typedef struct
+{
+    uint32_t TypeErase;
+    uint32_t Banks;
+    uint32_t Sector;
+    uint32_t NbSectors;
+    uint32_t VoltageRange;
+} FLASH_EraseInitTypeDef;
+
+#define FLASH_TYPEERASE_SECTORS 0x00000000U
+#define FLASH_TYPEPROGRAM_WORD  0x00000002U
+#define FLASH_VOLTAGE_RANGE_3   0x00000002U
+
+#define FLASH_SECTOR_0 0U
+#define FLASH_SECTOR_1 1U
+#define FLASH_SECTOR_2 2U
+#define FLASH_SECTOR_3 3U
+#define FLASH_SECTOR_4 4U
+#define FLASH_SECTOR_5 5U
+#define FLASH_SECTOR_6 6U
+#define FLASH_SECTOR_7 7U
+
+HAL_StatusTypeDef HAL_FLASH_Unlock(void);
+HAL_StatusTypeDef HAL_FLASH_Lock(void);
+HAL_StatusTypeDef HAL_FLASH_Program(uint32_t TypeProgram, uint32_t Address, uint64_t Data);
+HAL_StatusTypeDef HAL_FLASHEx_Erase(FLASH_EraseInitTypeDef *pEraseInit, uint32_t *SectorError);
+
+#endif /* HOST_STM32F4XX_HAL_H_ */
@@ -0,0 +1,158 @@
+/**
+ * Blackberry Q10 keyboard STM32 driver
+ * A fun little weekend project to act as a BBQ10 STM32 driver that is able to communicate with I2C bus masters.
+ * Creates rising-edge IRQ pulse, sends pressed character over I2C when master reads from slave upon receiving interrupt.
+ *
+ * Copyright (C) 2025 Mustafa Ozcelikors
+ *
+ * See GPLv3 LICENSE file in repository for licensing details.
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+/* Host micro-benchmarks of the firmware hot paths. Wall clock numbers are
+ * for comparing changes on the same workstation, not target cycle counts;
+ * virtual time shows what the firmware spends in delays on the target. */
+
+#include "hal_fake.h"
+#include "app.h"
+#include "config.h"
+#include "i2c_slave.h"
+#include "keyboard.h"
+#include "registers.h"
+#include <stdio.h>
+#include <time.h>
+
+#define BENCH_ITERATIONS 200000
+
+static double wall_ns(void)
+{
+    struct timespec ts;
+
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec * 1e9 + ts.tv_nsec;
+}
+
+static void bench_report(const char *name, double ns, uint64_t virtual_us, int n)
+{
+    printf("%-28s %10.1f ns/op %12.1f virtual us/op\n", name, ns / n, (double)virtual_us / n);
+}
+
+static void bench_scan(const char *name, uint8_t key_held)
+{
+    uint64_t start_us;
+    double start;
+
+    fake_keys_release_all();
+    if (key_held)
+        fake_key_set(0, 0, 1);
+
+    start_us = fake_now_us();
+    start = wall_ns();
+
+    for (int i = 0; i < BENCH_ITERATIONS; i++)
+        keyboard_scan();
+
+    bench_report(name, wall_ns() - start, fake_now_us() - start_us, BENCH_ITERATIONS);
+}
+
+static void bench_decode(void)
+{
+    volatile char sink = 0;
+    double start;
+
+    fake_keys_release_all();
+    fake_key_set(0, 0, 1);
+    keyboard_scan();
+
+    start = wall_ns();
+
+    for (int i = 0; i < BENCH_ITERATIONS; i++)
+        sink = keyboard_find_key();
+
+    (void)sink;
+    bench_report("keyboard_find_key", wall_ns() - start, 0, BENCH_ITERATIONS);
+}
+
+static void bench_i2c_read(const char *name, uint8_t reg, uint8_t len)
+{
+    uint8_t buf[I2C_TX_BUF_SIZE];
+    double start = wall_ns();
+
+    for (int i = 0; i < BENCH_ITERATIONS; i++)
+    {
+        if (reg == REG_KEY)
+            fake_i2c_read(KEYBOARD_I2C_ADDRESS, buf, len);
+        else
+            fake_i2c_read_reg(KEYBOARD_I2C_ADDRESS, reg, buf, len);
+    }
+
+    bench_report(name, wall_ns() - start, 0, BENCH_ITERATIONS);
+}
+
+static void bench_main_loop(void)
+{
+    uint64_t start_us;
+    double start;
+    int n = BENCH_ITERATIONS / 10;
+
+    fake_keys_release_all();
+
+    start_us = fake_now_us();
+    start = wall_ns();
+
+    for (int i = 0; i < n; i++)
+        app_step();
+
+    bench_report("app_step (idle)", wall_ns() - start, fake_now_us() - start_us, n);
+}
+
+int main(void)
+{
+    fake_reset();
+    app_init();
+
+    // The benchmarks call the hot paths directly, not through the main loop
+    fake_watchdog_freeze(1);
+
+    // Calibrated settle time of ideal lines, only the margin is left
+    bench_scan("keyboard_scan (settle dflt)", 0);
+
+    // Same settle time, one probe of all columns when idle, a column search for
+    // a lone key. Parked columns make the first probe a plain read.
+    config_set(CFG_PARTIAL_SCAN, 1);
+    bench_scan("keyboard_scan (partial idle)", 0);
+    bench_scan("keyboard_scan (partial key)", 1);
+    config_set(CFG_EDGE_STAMP, 1);
+    bench_scan("keyboard_scan (parked idle)", 0);
+    bench_scan("keyboard_scan (parked key)", 1);
+    config_set(CFG_EDGE_STAMP, 0);
+    config_set(CFG_PARTIAL_SCAN, 0);
+    keyboard_scan();  // takes the columns out of parking
+
+    // Minimal settle time, wall clock is dominated by the scan code itself
+    config_set(CFG_COL_SETTLE_US, 1);
+    bench_scan("keyboard_scan (idle)", 0);
+    bench_scan("keyboard_scan (key held)", 1);
+
+    bench_decode();
+
+    bench_i2c_read("i2c read REG_KEY", REG_KEY, 1);
+    bench_i2c_read("i2c read REG_KEY_STATE", REG_KEY_STATE, KEYBOARD_STATE_SIZE);
+
+    config_set(CFG_COL_SETTLE_US, KEYBOARD_COL_SETTLE_US);
+    bench_main_loop();
+
+    return 0;
+}
@@ -0,0 +1,510 @@
+/**
+ * Blackberry Q10 keyboard STM32 driver
+ * A fun little weekend project to act as a BBQ10 STM32 driver that is able to communicate with I2C bus masters.
+ * Creates rising-edge IRQ pulse, sends pressed character over I2C when master reads from slave upon receiving interrupt.
+ *
+ * Copyright (C) 2025 Mustafa Ozcelikors
+ *
+ * See GPLv3 LICENSE file in repository for licensing details.
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+/* Typing replay benchmark: turns a text corpus into timed matrix press and
+ * release events at a given typing speed, runs them through the firmware's
+ * scan -> decode -> queue -> I2C path and models a host that drains the key
+ * queue some time after each IRQ edge. Reports what the host got compared to
+ * what was typed: dropped, duplicated, reordered and spurious keys, and the
+ * press to host-visible latency.
+ *
+ *   bench_typing [corpus.txt]
+ */
+
+#include "hal_fake.h"
+#include "app.h"
+#include "i2c_slave.h"
+#include "keyboard.h"
+#include "keymap.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/wait.h>
+#include <unistd.h>
+
+#define TYPING_MAX_CHARS      2048
+#define TYPING_MAX_EVENTS     (TYPING_MAX_CHARS * 4)
+#define TYPING_START_US       100000ULL
+#define TYPING_FLUSH_US       1000000ULL
+#define TYPING_MIN_DWELL_MS   70    // key hold time, uniform in [min, max]
+#define TYPING_MAX_DWELL_MS   130
+#define TYPING_JITTER_PCT     40    // inter-key interval varies +-40%
+#define TYPING_SAME_KEY_GAP_MS 10   // a key is released this long before it is pressed again
+#define TYPING_MATCH_WINDOW_MS 1000 // arrivals later than this count as a drop plus a spurious key
+#define HOST_MAX_KEYS_PER_IRQ 16    // same limit as the Linux driver
+
+typedef struct
+{
+    uint64_t t_us;
+    uint8_t row;
+    uint8_t col;
+    uint8_t pressed;
+} matrix_event_t;
+
+static const uint16_t wpm_sweep[] = { 40, 80, 120, 160, 200 };
+static const uint32_t host_latency_sweep_us[] = { 500, 5000 };
+
+static char corpus[TYPING_MAX_CHARS];
+static int corpus_len = 0;
+
+static matrix_event_t events[TYPING_MAX_EVENTS];
+static int num_events = 0;
+static int next_event = 0;
+
+static char expected[TYPING_MAX_CHARS];
+static uint64_t expected_us[TYPING_MAX_CHARS];
+static int num_expected = 0;
+static int num_skipped = 0;
+
+static char received[TYPING_MAX_CHARS * 2];
+static uint64_t received_us[TYPING_MAX_CHARS * 2];
+static int num_received = 0;
+
+// Host model: drain the queue host_latency_us after an IRQ edge
+static uint32_t host_latency_us = 0;
+static uint64_t host_drain_at = 0;
+static uint8_t host_rerun = 0;
+
+static uint32_t rng_state = 0x12345678;
+
+static uint32_t rng_next(void)
+{
+    // xorshift32, fixed seed so runs are comparable
+    rng_state ^= rng_state << 13;
+    rng_state ^= rng_state >> 17;
+    rng_state ^= rng_state << 5;
+    return rng_state;
+}
+
+static uint32_t rng_range(uint32_t min, uint32_t max)
+{
+    return min + rng_next() % (max - min + 1);
+}
+
+/* Corpus to matrix events */
+
+static uint8_t key_lookup(char ch, uint8_t *row, uint8_t *col, uint8_t *mod_row, uint8_t *mod_col)
+{
+    const keymap_t *map = keymap_active();
+
+    *mod_row = 0xFF;
+    *mod_col = 0xFF;
+
+    for (uint8_t r = 0; r < NUM_ROWS; r++)
+    {
+        for (uint8_t c = 0; c < NUM_COLS; c++)
+        {
+            char key = map->primary[r][c];
+
+            *row = r;
+            *col = c;
+
+            // Letters are stored upper case and decode to lower case without shift
+            if (ch >= 'a' && ch <= 'z' && key == ch - 'a' + 'A')
+                return 1;
+
+            if (ch >= 'A' && ch <= 'Z' && key == ch)
+            {
+                *mod_row = ROW_LSHIFT;
+                *mod_col = COL_LSHIFT;
+                return 1;
+            }
+
+            if (!(ch >= 'a' && ch <= 'z') && !(ch >= 'A' && ch <= 'Z') && key == ch)
+                return 1;
+        }
+    }
+
+    for (uint8_t r = 0; r < NUM_ROWS; r++)
+    {
+        for (uint8_t c = 0; c < NUM_COLS; c++)
+        {
+            if (map->alt[r][c] == ch)
+            {
+                *row = r;
+                *col = c;
+                *mod_row = ROW_ALT;
+                *mod_col = COL_ALT;
+                return 1;
+            }
+        }
+    }
+
+    return 0;
+}
+
+static uint64_t add_keystroke(uint64_t t_us, uint8_t row, uint8_t col, uint64_t last_release[NUM_ROWS][NUM_COLS])
+{
+    uint64_t dwell_us = rng_range(TYPING_MIN_DWELL_MS, TYPING_MAX_DWELL_MS) * 1000ULL;
+
+    if (t_us < last_release[row][col] + TYPING_SAME_KEY_GAP_MS * 1000ULL)
+        t_us = last_release[row][col] + TYPING_SAME_KEY_GAP_MS * 1000ULL;
+
+    events[num_events++] = (matrix_event_t){ t_us, row, col, 1 };
+    events[num_events++] = (matrix_event_t){ t_us + dwell_us, row, col, 0 };
+    last_release[row][col] = t_us + dwell_us;
+
+    return t_us;
+}
+
+static int event_compare(const void *a, const void *b)
+{
+    const matrix_event_t *ea = a;
+    const matrix_event_t *eb = b;
+
+    if (ea->t_us != eb->t_us)
+        return ea->t_us < eb->t_us ? -1 : 1;
+
+    // Releases first, a key is never pressed and released at the same instant
+    return (int)ea->pressed - (int)eb->pressed;
+}
+
+static void build_timeline(uint16_t wpm)
+{
+    // One word is five keystrokes
+    uint64_t interval_us = 12000000ULL / wpm;
+    uint64_t last_release[NUM_ROWS][NUM_COLS] = {{0}};
+    uint64_t t = TYPING_START_US;
+
+    num_events = 0;
+    num_expected = 0;
+    num_skipped = 0;
+
+    for (int i = 0; i < corpus_len; i++)
+    {
+        uint8_t row, col, mod_row, mod_col;
+        uint64_t jitter = interval_us * TYPING_JITTER_PCT / 100;
+
+        if (!key_lookup(corpus[i], &row, &col, &mod_row, &mod_col))
+        {
+            num_skipped++;
+            continue;
+        }
+
+        t += rng_range(interval_us - jitter, interval_us + jitter);
+
+        if (mod_row != 0xFF)
+        {
+            // Mode key is tapped first, the key follows at half the usual interval
+            t = add_keystroke(t, mod_row, mod_col, last_release);
+            t += rng_range(interval_us - jitter, interval_us + jitter) / 2;
+        }
+
+        t = add_keystroke(t, row, col, last_release);
+
+        expected[num_expected] = corpus[i];
+        expected_us[num_expected] = t;
+        num_expected++;
+    }
+
+    qsort(events, num_events, sizeof(events[0]), event_compare);
+    next_event = 0;
+}
+
+/* Host and matrix driven from the virtual clock */
+
+static void on_alarm(void);
+
+static void arm_alarm(void)
+{
+    uint64_t next = UINT64_MAX;
+
+    if (next_event < num_events)
+        next = events[next_event].t_us;
+
+    if (host_drain_at && host_drain_at < next)
+        next = host_drain_at;
+
+    if (next != UINT64_MAX)
+        fake_set_alarm(next, on_alarm);
+    else
+        fake_set_alarm(0, NULL);
+}
+
+static void host_drain(void)
+{
+    // Read one byte per transfer until the queue reports empty
+    for (int i = 0; i < HOST_MAX_KEYS_PER_IRQ; i++)
+    {
+        uint8_t key = 0;
+
+        if (!fake_i2c_read(KEYBOARD_I2C_ADDRESS, &key, 1) || key == 0)
+            break;
+
+        if (num_received < (int)(sizeof(received) / sizeof(received[0])))
+        {
+            received[num_received] = (char)key;
+            received_us[num_received] = fake_now_us();
+            num_received++;
+        }
+    }
+}
+
+static void on_irq(void)
+{
+    // Edge while a drain is pending runs the threaded handler once more
+    if (host_drain_at)
+        host_rerun = 1;
+    else
+        host_drain_at = fake_now_us() + host_latency_us;
+
+    arm_alarm();
+}
+
+static void on_alarm(void)
+{
+    uint64_t now = fake_now_us();
+
+    while (next_event < num_events && events[next_event].t_us <= now)
+    {
+        fake_key_set(events[next_event].row, events[next_event].col, events[next_event].pressed);
+        next_event++;
+    }
+
+    if (host_drain_at && host_drain_at <= now)
+    {
+        host_drain();
+        host_drain_at = 0;
+
+        if (host_rerun)
+        {
+            host_rerun = 0;
+            host_drain_at = now + host_latency_us;
+        }
+    }
+
+    arm_alarm();
+}
+
+/* Scoring */
+
+typedef struct
+{
+    int dropped;
+    int duplicated;
+    int reordered;
+    int spurious;
+    int num_latencies;
+    uint64_t latencies_us[TYPING_MAX_CHARS];
+} typing_score_t;
+
+static int u64_compare(const void *a, const void *b)
+{
+    uint64_t x = *(const uint64_t *)a;
+    uint64_t y = *(const uint64_t *)b;
+
+    return (x > y) - (x < y);
+}
+
+static uint8_t is_match(int i, int j)
+{
+    // A key can only reach the host after it was pressed
+    return expected[i] == received[j] && received_us[j] >= expected_us[i] &&
+           received_us[j] - expected_us[i] <= TYPING_MATCH_WINDOW_MS * 1000ULL;
+}
+
+static void score_run(typing_score_t *score)
+{
+    // Longest common subsequence pairs what was typed with what arrived in order
+    static uint16_t lcs[TYPING_MAX_CHARS + 1][TYPING_MAX_CHARS * 2 + 1];
+    static int exp_match[TYPING_MAX_CHARS];
+    static int rec_match[TYPING_MAX_CHARS * 2];
+    int n = num_expected;
+    int m = num_received;
+
+    memset(score, 0, sizeof(*score));
+
+    for (int i = n - 1; i >= 0; i--)
+    {
+        for (int j = m - 1; j >= 0; j--)
+        {
+            if (is_match(i, j))
+                lcs[i][j] = lcs[i + 1][j + 1] + 1;
+            else
+                lcs[i][j] = lcs[i + 1][j] > lcs[i][j + 1] ? lcs[i + 1][j] : lcs[i][j + 1];
+        }
+    }
+
+    for (int i = 0; i < n; i++)
+        exp_match[i] = -1;
+    for (int j = 0; j < m; j++)
+        rec_match[j] = -1;
+
+    for (int i = 0, j = 0; i < n && j < m;)
+    {
+        if (is_match(i, j))
+        {
+            exp_match[i] = j;
+            rec_match[j] = i;
+            i++;
+            j++;
+        }
+        else if (lcs[i + 1][j] >= lcs[i][j + 1])
+        {
+            i++;
+        }
+        else
+        {
+            j++;
+        }
+    }
+
+    // Unmatched arrivals: a key that did arrive but out of order, a repeat of
+    // the previous arrival, or something that was never typed
+    for (int j = 0; j < m; j++)
+    {
+        if (rec_match[j] >= 0)
+            continue;
+
+        for (int i = 0; i < n; i++)
+        {
+            if (exp_match[i] < 0 && is_match(i, j))
+            {
+                exp_match[i] = j;
+                rec_match[j] = i;
+                score->reordered++;
+                break;
+            }
+        }
+
+        if (rec_match[j] >= 0)
+            continue;
+
+        if (j > 0 && received[j] == received[j - 1])
+            score->duplicated++;
+        else
+            score->spurious++;
+    }
+
+    for (int i = 0; i < n; i++)
+    {
+        if (exp_match[i] < 0)
+        {
+            score->dropped++;
+            continue;
+        }
+
+        score->latencies_us[score->num_latencies++] = received_us[exp_match[i]] - expected_us[i];
+    }
+
+    qsort(score->latencies_us, score->num_latencies, sizeof(uint64_t), u64_compare);
+}
+
+static double percentile_ms(const typing_score_t *score, int pct)
+{
+    int idx;
+
+    if (score->num_latencies == 0)
+        return 0.0;
+
+    idx = (score->num_latencies - 1) * pct / 100;
+    return score->latencies_us[idx] / 1000.0;
+}
+
+/* Runs */
+
+static void run(uint16_t wpm, uint32_t latency_us)
+{
+    static typing_score_t score;
+    uint64_t end_us;
+
+    fake_reset();
+    app_init();
+
+    build_timeline(wpm);
+
+    num_received = 0;
+    host_latency_us = latency_us;
+    host_drain_at = 0;
+    host_rerun = 0;
+
+    fake_set_irq_hook(on_irq);
+    arm_alarm();
+
+    end_us = events[num_events - 1].t_us + TYPING_FLUSH_US;
+    while (fake_now_us() < end_us)
+        app_step();
+
+    // Anything still queued is picked up by a final read
+    host_drain();
+
+    score_run(&score);
+
+    printf("%4u %8u %6d %6d %6d %5d %8d %9d %8.1f %8.1f %8.1f %8.1f\n",
+           wpm, latency_us, num_expected, num_received,
+           score.dropped, score.duplicated, score.reordered, score.spurious,
+           percentile_ms(&score, 50), percentile_ms(&score, 90),
+           percentile_ms(&score, 99), percentile_ms(&score, 100));
+}
+
+static void load_corpus(const char *path)
+{
+    FILE *f = fopen(path, "r");
+
+    if (!f)
+    {
+        perror(path);
+        exit(2);
+    }
+
+    corpus_len = (int)fread(corpus, 1, sizeof(corpus), f);
+    fclose(f);
+
+    // Trailing newline would only add an enter key
+    while (corpus_len > 0 && corpus[corpus_len - 1] == '\n')
+        corpus_len--;
+}
+
+int main(int argc, char **argv)
+{
+    const char *path = argc > 1 ? argv[1] : "corpus/notes.txt";
+
+    load_corpus(path);
+
+    printf("corpus %s, %d characters\n", path, corpus_len);
+    printf(" wpm  host_us   keys   recv  dropd   dup  reorder  spurious  p50_ms   p90_ms   p99_ms   max_ms\n");
+
+    for (size_t w = 0; w < sizeof(wpm_sweep) / sizeof(wpm_sweep[0]); w++)
+    {
+        for (size_t l = 0; l < sizeof(host_latency_sweep_us) / sizeof(host_latency_sweep_us[0]); l++)
+        {
+            // Each run starts from power-on firmware state
+            pid_t pid;
+
+            fflush(stdout);
+            pid = fork();
+            if (pid == 0)
+            {
+                run(wpm_sweep[w], host_latency_sweep_us[l]);
+                if (num_skipped)
+                    fprintf(stderr, "  (%d characters have no key and were skipped)\n", num_skipped);
+                fflush(stdout);
+                exit(0);
+            }
+
+            waitpid(pid, NULL, 0);
+        }
+    }
+
+    return 0;
+}
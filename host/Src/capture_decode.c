@@ -0,0 +1,90 @@
+/**
+ * Blackberry Q10 keyboard STM32 driver
+ * A fun little weekend project to act as a BBQ10 STM32 driver that is able to communicate with I2C bus masters.
+ * Creates rising-edge IRQ pulse, sends pressed character over I2C when master reads from slave upon receiving interrupt.
+ *
+ * Copyright (C) 2025 Mustafa Ozcelikors
+ *
+ * See GPLv3 LICENSE file in repository for licensing details.
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#include "capture_decode.h"
+#include <string.h>
+
+static int get_varint(const uint8_t *image, size_t size, size_t *pos, uint32_t *value)
+{
+    *value = 0;
+
+    for (int shift = 0; shift < 35; shift += 7)
+    {
+        if (*pos >= size)
+            return 0;
+
+        uint8_t byte = image[(*pos)++];
+        *value |= (uint32_t)(byte & 0x7F) << shift;
+
+        if (!(byte & 0x80))
+            return 1;
+    }
+
+    return 0;
+}
+
+long capture_decode(const uint8_t *image, size_t size, capture_frame_fn frame_fn, void *ctx)
+{
+    uint8_t frame[KEYBOARD_BITMAP_SIZE];
+    size_t pos = CAPTURE_HEADER_SIZE;
+    long frames = 0;
+
+    if (size < CAPTURE_HEADER_SIZE || image[0] != CAPTURE_FORMAT_VERSION ||
+        image[1] != NUM_ROWS || image[2] != NUM_COLS)
+    {
+        return -1;
+    }
+
+    memcpy(frame, &image[3], sizeof(frame));
+
+    while (pos < size)
+    {
+        uint32_t idle, dt_us;
+        uint8_t flips;
+
+        if (!get_varint(image, size, &pos, &idle) || !get_varint(image, size, &pos, &dt_us) || pos >= size)
+            return -1;
+
+        for (uint32_t i = 0; i < idle; i++, frames++)
+            frame_fn(frame, 0, ctx);
+
+        flips = image[pos++];
+        if (pos + flips > size)
+            return -1;
+
+        for (uint8_t k = 0; k < flips; k++)
+        {
+            uint8_t bit = image[pos++];
+
+            if (bit >= NUM_ROWS * NUM_COLS)
+                return -1;
+
+            frame[bit >> 3] ^= (1 << (bit & 7));
+        }
+
+        frame_fn(frame, dt_us, ctx);
+        frames++;
+    }
+
+    return frames;
+}
@@ -0,0 +1,448 @@
+/**
+ * Blackberry Q10 keyboard STM32 driver
+ * A fun little weekend project to act as a BBQ10 STM32 driver that is able to communicate with I2C bus masters.
+ * Creates rising-edge IRQ pulse, sends pressed character over I2C when master reads from slave upon receiving interrupt.
+ *
+ * Copyright (C) 2025 Mustafa Ozcelikors
+ *
+ * See GPLv3 LICENSE file in repository for licensing details.
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+/* Fuzz harness for the I2C slave protocol state machine. Each input is read as
+ * a sequence of bus events (address matches, reads, writes, NACKs, STOPs and
+ * bus errors) interleaved with main loop work that queues keys, and is played
+ * against the firmware through the fake HAL's I2C master. Checked invariants:
+ *
+ *   - no lost or reordered keys: every key the firmware accepted is read back
+ *     in order, and a key only leaves the queue once the master NACKed its read
+ *   - nothing stuck: once the master released the bus and the main loop ran,
+ *     the slave answers its address again and i2c_busy is clear
+ *   - bounded ISR work: a bus event runs at most FUZZ_MAX_CALLBACKS HAL
+ *     callbacks and spends no (virtual) time in them beyond the cycle counter
+ *     reads of the benchmark probes
+ *
+ * Built as a plain program it replays the files given on the command line
+ * (crash reproducers, AFL with @@) or runs -runs=N random inputs. With
+ * -DFUZZ_LIBFUZZER and -fsanitize=fuzzer libFuzzer provides main() and the
+ * coverage guidance, see host/Makefile. */
+
+#include "hal_fake.h"
+#include "app.h"
+#include "i2c_slave.h"
+#include "registers.h"
+#include <dirent.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/stat.h>
+
+#define ADDR KEYBOARD_I2C_ADDRESS
+
+#define FUZZ_MAX_CALLBACKS 3    // error + listen complete, or address match + transmit complete
+#define FUZZ_MAX_TICK_CYCLES (3 * FAKE_DWT_READ_CYCLES)  // a SysTick landing in the event: CPU load bracket and window
+#define FUZZ_MAX_ISR_CYCLES (FUZZ_MAX_CALLBACKS * 2 * FAKE_DWT_READ_CYCLES + FUZZ_MAX_TICK_CYCLES)  // bench probes, no waiting
+#define FUZZ_MAX_INPUT     4096 // bytes per random input in standalone mode
+
+enum
+{
+    OP_START_WRITE,   // arg bit 7: other address
+    OP_START_READ,    // arg bit 7: other address
+    OP_WRITE_BYTE,    // arg: data
+    OP_READ_ACK,
+    OP_READ_NACK,
+    OP_STOP,
+    OP_BUS_ERROR,
+    OP_QUEUE_KEY,     // arg: key
+    OP_MAIN_LOOP,
+    OP_ADVANCE_TIME,  // arg: x 50 us
+    OP_COUNT
+};
+
+#define FUZZ_CHECK(cond) do { \
+    if (!(cond)) \
+        fuzz_fail(__FILE__, __LINE__, #cond); \
+} while (0)
+
+// Master's view of the transfer in progress
+static struct
+{
+    uint8_t addressed;
+    uint8_t reading;
+    uint8_t nacked;
+    uint8_t orphaned;     // left by a repeated start to another address, no STOP reaches the slave
+    uint8_t rx_bytes;     // bytes the slave ACKed in this write
+    uint8_t reg_pointer;  // register the next read returns
+    uint8_t tx_reg;       // register latched by this read
+    uint8_t key_latched;  // key this read carries, 0 if the queue was empty
+    uint8_t key_checked;
+    uint8_t tx_bytes;     // bytes the master read in this read
+} bus;
+
+// Keys accepted by the firmware and not yet delivered, oldest first
+static char pending[KEY_FIFO_SIZE];
+static uint8_t pending_head = 0;
+static uint8_t pending_count = 0;
+
+static const uint8_t *fuzz_data = NULL;
+static size_t fuzz_size = 0;
+
+static void fuzz_fail(const char *file, int line, const char *cond)
+{
+    fprintf(stderr, "%s:%d: FUZZ_CHECK(%s) failed\n", file, line, cond);
+
+#ifndef FUZZ_LIBFUZZER
+    // libFuzzer saves the input itself
+    FILE *f = fopen("crash-fuzz_i2c.bin", "wb");
+
+    if (f)
+    {
+        fwrite(fuzz_data, 1, fuzz_size, f);
+        fclose(f);
+        fprintf(stderr, "input written to crash-fuzz_i2c.bin\n");
+    }
+#endif
+
+    abort();
+}
+
+static char pending_front(void)
+{
+    return pending_count ? pending[pending_head] : 0;
+}
+
+static void pending_pop(void)
+{
+    pending_head = (pending_head + 1) % KEY_FIFO_SIZE;
+    pending_count--;
+}
+
+/* Bus events, each one runs in interrupt context on the target */
+
+static void bus_start(uint8_t read, uint8_t other)
+{
+    uint8_t acked = fake_i2c_start(other ? ADDR + 1 : ADDR, read);
+
+    if (bus.addressed && !bus.reading && other)
+        bus.orphaned = 1;
+
+    bus.addressed = acked;
+    bus.reading = read;
+    bus.nacked = 0;
+    bus.rx_bytes = 0;
+
+    FUZZ_CHECK(!(acked && other));
+
+    if (!acked)
+        return;
+
+    bus.orphaned = 0;
+
+    if (read)
+    {
+        bus.tx_reg = bus.reg_pointer;
+        bus.reg_pointer = REG_KEY;
+        bus.key_latched = (uint8_t)pending_front();
+        bus.key_checked = 0;
+        bus.tx_bytes = 0;
+    }
+}
+
+static uint8_t bus_key_reg(uint8_t reg)
+{
+    return reg == REG_KEY || reg == REG_KEY_STAMPED;
+}
+
+static void bus_write(uint8_t byte)
+{
+    if (!fake_i2c_write_byte(byte))
+        return;
+
+    FUZZ_CHECK(bus.addressed && !bus.reading);
+
+    // The first byte selects the register for the next read
+    if (bus.rx_bytes++ == 0)
+        bus.reg_pointer = byte;
+}
+
+static void bus_read(uint8_t ack)
+{
+    uint8_t byte = fake_i2c_read_byte(ack);
+
+    if (!bus.addressed || !bus.reading || bus.nacked)
+        return;
+
+    bus.tx_bytes++;
+
+    if (bus_key_reg(bus.tx_reg) && !bus.key_checked)
+    {
+        // The key latched at address match, never a later or an already delivered one
+        FUZZ_CHECK(byte == bus.key_latched);
+        bus.key_checked = 1;
+    }
+
+    if (ack)
+        return;
+
+    // NACK ends the read, the host has the key now. The slave loads a byte
+    // ahead of the bus, so the key counts once its frame has been loaded:
+    // the stamp's last byte is loaded as the master reads the fourth.
+    bus.nacked = 1;
+
+    if (bus_key_reg(bus.tx_reg) && bus.key_checked && bus.key_latched != 0 &&
+        (bus.tx_reg == REG_KEY || bus.tx_bytes >= 4))
+    {
+        pending_pop();
+    }
+}
+
+static void bus_stop(void)
+{
+    fake_i2c_stop();
+
+    if (bus.addressed)
+        bus.orphaned = 0;
+
+    bus.addressed = 0;
+}
+
+static void bus_error(void)
+{
+    fake_i2c_bus_error();
+    bus.addressed = 0;
+    bus.orphaned = 0;
+}
+
+static void bus_event(uint8_t op, uint8_t arg)
+{
+    uint64_t cycles = fake_now_cycles();
+    uint32_t callbacks = fake_i2c_callbacks();
+
+    switch (op)
+    {
+        case OP_START_WRITE: bus_start(0, arg & 0x80); break;
+        case OP_START_READ:  bus_start(1, arg & 0x80); break;
+        case OP_WRITE_BYTE:  bus_write(arg); break;
+        case OP_READ_ACK:    bus_read(1); break;
+        case OP_READ_NACK:   bus_read(0); break;
+        case OP_STOP:        bus_stop(); break;
+        case OP_BUS_ERROR:   bus_error(); break;
+    }
+
+    FUZZ_CHECK(fake_now_cycles() - cycles <= FUZZ_MAX_ISR_CYCLES);
+    FUZZ_CHECK(fake_i2c_callbacks() - callbacks <= FUZZ_MAX_CALLBACKS);
+}
+
+/* Main loop work, preempted by bus events only between these calls */
+
+static void queue_key(uint8_t arg)
+{
+    char key = (char)('a' + arg % 26);
+
+    set_i2c_txdata(key, 0);
+
+    // The firmware drops the newest key when the queue is full
+    if (pending_count < KEY_FIFO_SIZE)
+    {
+        pending[(pending_head + pending_count) % KEY_FIFO_SIZE] = key;
+        pending_count++;
+    }
+}
+
+static void main_loop(void)
+{
+    i2c_irq_moderation_poll();
+    i2c_service();
+
+    if (!bus.addressed)
+    {
+        FUZZ_CHECK(fake_i2c_listening());
+
+        if (!bus.orphaned)
+            FUZZ_CHECK(!i2c_busy);
+    }
+}
+
+static void drain(void)
+{
+    // Host side: read keys until the queue reports empty
+    for (int i = 0; i <= KEY_FIFO_SIZE; i++)
+    {
+        uint8_t key = 0xFF;
+
+        FUZZ_CHECK(fake_i2c_read_reg(ADDR, REG_KEY, &key, 1));
+        FUZZ_CHECK(key == (uint8_t)pending_front());
+
+        if (key == 0)
+            break;
+
+        pending_pop();
+    }
+
+    FUZZ_CHECK(pending_count == 0);
+    FUZZ_CHECK(!i2c_busy);
+}
+
+int LLVMFuzzerTestOneInput(const uint8_t *data, size_t size)
+{
+    fuzz_data = data;
+    fuzz_size = size;
+
+    // Power-on state per input, the previous input left the key queue empty
+    fake_reset();
+    app_init();
+    fake_watchdog_freeze(1);  // main_loop() is only part of the firmware's
+    memset(&bus, 0, sizeof(bus));
+    bus.reg_pointer = REG_KEY;
+    pending_head = 0;
+    pending_count = 0;
+
+    for (size_t i = 0; i + 1 < size; i += 2)
+    {
+        uint8_t op = data[i] % OP_COUNT;
+        uint8_t arg = data[i + 1];
+
+        switch (op)
+        {
+            case OP_QUEUE_KEY:    queue_key(arg); break;
+            case OP_MAIN_LOOP:    main_loop(); break;
+            case OP_ADVANCE_TIME: fake_advance_us((uint64_t)arg * 50); break;
+            default:              bus_event(op, arg); break;
+        }
+    }
+
+    // Master finishes its transfer properly, then the main loop runs
+    if (bus.addressed && bus.reading && !bus.nacked)
+        bus_event(OP_READ_NACK, 0);
+
+    bus_event(OP_STOP, 0);
+    main_loop();
+    drain();
+    return 0;
+}
+
+#ifndef FUZZ_LIBFUZZER
+
+static uint32_t rng_state = 1;
+
+static uint32_t rng_next(void)
+{
+    // xorshift32
+    rng_state ^= rng_state << 13;
+    rng_state ^= rng_state >> 17;
+    rng_state ^= rng_state << 5;
+    return rng_state;
+}
+
+static void run_file(const char *path)
+{
+    static uint8_t buf[1 << 16];
+    FILE *f = fopen(path, "rb");
+    size_t size;
+
+    if (!f)
+    {
+        perror(path);
+        exit(2);
+    }
+
+    size = fread(buf, 1, sizeof(buf), f);
+    fclose(f);
+
+    LLVMFuzzerTestOneInput(buf, size);
+}
+
+static int run_path(const char *path)
+{
+    struct stat st;
+
+    if (stat(path, &st) != 0)
+    {
+        perror(path);
+        exit(2);
+    }
+
+    if (!S_ISDIR(st.st_mode))
+    {
+        run_file(path);
+        return 1;
+    }
+
+    // Corpus directory, every file in it
+    DIR *dir = opendir(path);
+    struct dirent *e;
+    int runs = 0;
+
+    while (dir && (e = readdir(dir)) != NULL)
+    {
+        char file[4096];
+
+        if (e->d_name[0] == '.')
+            continue;
+
+        snprintf(file, sizeof(file), "%s/%s", path, e->d_name);
+        run_file(file);
+        runs++;
+    }
+
+    if (dir)
+        closedir(dir);
+
+    return runs;
+}
+
+int main(int argc, char **argv)
+{
+    static uint8_t input[FUZZ_MAX_INPUT];
+    long runs = 10000;
+    int files = 0;
+
+    // Same options as libFuzzer for the parts that make sense without it
+    for (int i = 1; i < argc; i++)
+    {
+        if (strncmp(argv[i], "-runs=", 6) == 0)
+            runs = atol(argv[i] + 6);
+        else if (strncmp(argv[i], "-seed=", 6) == 0)
+            rng_state = (uint32_t)atol(argv[i] + 6) | 1;
+        else if (argv[i][0] != '-')
+            files += run_path(argv[i]);
+    }
+
+    if (files)
+    {
+        printf("fuzz_i2c: %d inputs replayed\n", files);
+        return 0;
+    }
+
+    for (long n = 0; n < runs; n++)
+    {
+        size_t size = rng_next() % FUZZ_MAX_INPUT;
+
+        // Bias towards short transfers on the own address, pure noise rarely
+        // gets past the address match
+        for (size_t i = 0; i + 1 < size; i += 2)
+        {
+            input[i] = (uint8_t)rng_next();
+            input[i + 1] = (uint8_t)(rng_next() & ((rng_next() & 7) ? 0x7F : 0xFF));
+        }
+
+        LLVMFuzzerTestOneInput(input, size);
+    }
+
+    printf("fuzz_i2c: %ld random inputs, all invariants held\n", runs);
+    return 0;
+}
+
+#endif /* FUZZ_LIBFUZZER */
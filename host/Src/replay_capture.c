@@ -0,0 +1,123 @@
+/**
+ * Blackberry Q10 keyboard STM32 driver
+ * A fun little weekend project to act as a BBQ10 STM32 driver that is able to communicate with I2C bus masters.
+ * Creates rising-edge IRQ pulse, sends pressed character over I2C when master reads from slave upon receiving interrupt.
+ *
+ * Copyright (C) 2025 Mustafa Ozcelikors
+ *
+ * See GPLv3 LICENSE file in repository for licensing details.
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+/* Replays a matrix capture read out of the firmware (tools/capture_read.py)
+ * through the host build, one scan per recorded frame, and prints every key
+ * the firmware queues for the host with its replay time.
+ *
+ *   replay_capture <capture.bin>
+ */
+
+#include "hal_fake.h"
+#include "app.h"
+#include "capture_decode.h"
+#include "i2c_slave.h"
+#include <stdio.h>
+#include <stdlib.h>
+
+#define REPLAY_MAX_IMAGE (CAPTURE_HEADER_SIZE + CAPTURE_RING_SIZE)
+
+typedef struct
+{
+    uint64_t recorded_us;  // recorded time of the current frame, from capture start
+    uint64_t start_us;     // virtual time of the first replayed scan
+    long keys;
+} replay_t;
+
+static void print_key(uint8_t key)
+{
+    if (key >= 0x20 && key < 0x7F)
+        printf("'%c'", key);
+    else
+        printf("0x%02X", key);
+}
+
+static void replay_frame(const uint8_t bits[KEYBOARD_BITMAP_SIZE], uint32_t dt_us, void *ctx)
+{
+    replay_t *replay = ctx;
+    uint8_t key;
+
+    // Keep the replay no earlier than the recording, so timing dependent
+    // paths (debounce, IRQ moderation) see the recorded gaps
+    replay->recorded_us += dt_us;
+    if (fake_now_us() < replay->start_us + replay->recorded_us)
+        fake_advance_us(replay->start_us + replay->recorded_us - fake_now_us());
+
+    for (uint8_t r = 0; r < NUM_ROWS; r++)
+    {
+        for (uint8_t c = 0; c < NUM_COLS; c++)
+        {
+            uint8_t bit = r * NUM_COLS + c;
+            fake_key_set(r, c, (bits[bit >> 3] >> (bit & 7)) & 1);
+        }
+    }
+
+    app_step();
+
+    while (fake_i2c_read(KEYBOARD_I2C_ADDRESS, &key, 1) && key != 0)
+    {
+        printf("%10.3f ms  ", (fake_now_us() - replay->start_us) / 1000.0);
+        print_key(key);
+        printf("\n");
+        replay->keys++;
+    }
+}
+
+int main(int argc, char **argv)
+{
+    static uint8_t image[REPLAY_MAX_IMAGE];
+    replay_t replay = {0};
+    size_t size;
+    long frames;
+    FILE *f;
+
+    if (argc != 2)
+    {
+        fprintf(stderr, "usage: %s <capture.bin>\n", argv[0]);
+        return 2;
+    }
+
+    f = fopen(argv[1], "rb");
+    if (!f)
+    {
+        perror(argv[1]);
+        return 2;
+    }
+
+    size = fread(image, 1, sizeof(image), f);
+    fclose(f);
+
+    fake_reset();
+    app_init();
+    replay.start_us = fake_now_us();
+
+    frames = capture_decode(image, size, replay_frame, &replay);
+    if (frames < 0)
+    {
+        fprintf(stderr, "%s: not a %dx%d capture image\n", argv[1], NUM_ROWS, NUM_COLS);
+        return 1;
+    }
+
+    printf("%ld frames, %ld keys\n", frames, replay.keys);
+    return 0;
+}
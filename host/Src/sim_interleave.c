@@ -0,0 +1,590 @@
+/**
+ * Blackberry Q10 keyboard STM32 driver
+ * A fun little weekend project to act as a BBQ10 STM32 driver that is able to communicate with I2C bus masters.
+ * Creates rising-edge IRQ pulse, sends pressed character over I2C when master reads from slave upon receiving interrupt.
+ *
+ * Copyright (C) 2025 Mustafa Ozcelikors
+ *
+ * See GPLv3 LICENSE file in repository for licensing details.
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+/* Interleaving simulator for races between the main loop and the I2C ISR.
+ *
+ * The firmware marks every main loop access to state shared with the ISR
+ * with PREEMPT_POINT() (preempt.h), and interrupts are also taken on
+ * __enable_irq() and in HAL_Delay(). The deferred decode (PendSV) counts as
+ * main loop work, it runs right after the scan and the I2C interrupt preempts
+ * it the same way. A scenario runs some main loop work
+ * while a host transaction arrives as a fixed sequence of interrupts. The
+ * simulator first counts the preemption points of an undisturbed run, then
+ * replays the scenario once for every way of placing the interrupts on those
+ * points (in order, several may land on the same point, the rest arrive after
+ * the main loop work), each run in a fresh process. After every run the
+ * scenario checks its invariants: torn reads, lost updates, keys lost or
+ * duplicated, and the slave still answering. A run that does not finish
+ * (spinning on a flag no interrupt will set) is reported as a deadlock.
+ *
+ * Usage: sim_interleave [scenario name filter] */
+
+#include "hal_fake.h"
+#include "app.h"
+#include "capture.h"
+#include "config.h"
+#include "i2c_slave.h"
+#include "keyboard.h"
+#include "keymap.h"
+#include "registers.h"
+#include <signal.h>
+#include <stdarg.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/wait.h>
+#include <unistd.h>
+
+#define ADDR KEYBOARD_I2C_ADDRESS
+
+#define SIM_MAX_IRQS       4      // interrupts per scenario
+#define SIM_MAX_REPORTS    5      // failing schedules printed per scenario
+#define SIM_POINT_BUDGET   100000 // preemption points before a run counts as deadlocked
+#define SIM_TIMEOUT_S      5      // wall clock limit per run, catches spins without preemption points
+
+typedef struct
+{
+    const char *name;
+    void (*fn)(void);  // runs in interrupt context
+} sim_irq_t;
+
+typedef struct
+{
+    const char *name;
+    void (*setup)(void);     // before the main loop work, nothing preempts it
+    void (*main_work)(void); // preempted by the interrupts
+    sim_irq_t irqs[SIM_MAX_IRQS];
+    int num_irqs;
+    void (*check)(void);     // after all interrupts, nothing preempts it
+} sim_scenario_t;
+
+#define SIM_CHECK(cond) do { \
+    if (!(cond)) \
+        sim_fail("%s:%d: SIM_CHECK(%s) failed", __FILE__, __LINE__, #cond); \
+} while (0)
+
+// State of the run in the current (child) process
+static const sim_scenario_t *sim = NULL;
+static int sim_schedule[SIM_MAX_IRQS];
+static char sim_where[SIM_MAX_IRQS][64];
+static int sim_points = 0;
+static int sim_next_irq = 0;
+static int sim_report_fd = -1;
+
+static void sim_fail(const char *fmt, ...)
+{
+    char msg[512];
+    int len = 0;
+    va_list ap;
+
+    // Schedule first, then what went wrong
+    for (int i = 0; i < sim->num_irqs; i++)
+    {
+        len += snprintf(msg + len, sizeof(msg) - len, "%s%s @ %s", i ? ", " : "",
+                        sim->irqs[i].name, i < sim_next_irq ? sim_where[i] : "end");
+    }
+
+    len += snprintf(msg + len, sizeof(msg) - len, "\n      ");
+
+    va_start(ap, fmt);
+    vsnprintf(msg + len, sizeof(msg) - len, fmt, ap);
+    va_end(ap);
+
+    if (write(sim_report_fd, msg, strlen(msg)) < 0)
+        perror("sim_interleave");
+
+    _exit(1);
+}
+
+static void sim_run_irq(const char *where)
+{
+    snprintf(sim_where[sim_next_irq], sizeof(sim_where[0]), "%s", where);
+    sim->irqs[sim_next_irq].fn();
+    sim_next_irq++;
+}
+
+static void sim_preempt(const char *file, int line)
+{
+    const char *base = strrchr(file, '/');
+    char where[64];
+
+    snprintf(where, sizeof(where), "%s:%d", base ? base + 1 : file, line);
+
+    if (++sim_points > SIM_POINT_BUDGET)
+        sim_fail("deadlock: main loop work still running after %d preemption points", SIM_POINT_BUDGET);
+
+    while (sim_next_irq < sim->num_irqs && sim_schedule[sim_next_irq] == sim_points - 1)
+        sim_run_irq(where);
+}
+
+/* Host side building blocks, each one call is one interrupt (or a burst of
+ * interrupts of which only the last touches state the main loop sees) */
+
+static void host_write_reg(uint8_t reg, const uint8_t *data, uint8_t len)
+{
+    // Data bytes only land in the receive buffer, the STOP applies them
+    fake_i2c_start(ADDR, 0);
+    fake_i2c_write_byte(reg);
+    for (uint8_t i = 0; i < len; i++)
+        fake_i2c_write_byte(data[i]);
+    fake_i2c_stop();
+}
+
+static uint8_t host_read_key(void)
+{
+    uint8_t key = 0xFF;
+
+    SIM_CHECK(fake_i2c_read(ADDR, &key, 1));
+    return key;
+}
+
+/* Scenario: key queue, main loop queues two keys while the host reads */
+
+static char keys_received[8];
+static int num_keys_received = 0;
+
+static void keys_main(void)
+{
+    set_i2c_txdata('a', 0);
+    set_i2c_txdata('b', 0);
+}
+
+static void keys_addr(void)
+{
+    // Address match latches the oldest key
+    fake_i2c_start(ADDR, 1);
+}
+
+static void keys_nack(void)
+{
+    // NACK of the key byte ends the read
+    uint8_t key = fake_i2c_read_byte(0);
+
+    fake_i2c_stop();
+
+    if (key != 0)
+        keys_received[num_keys_received++] = (char)key;
+}
+
+static void keys_check(void)
+{
+    uint8_t key;
+
+    while ((key = host_read_key()) != 0 && num_keys_received < (int)sizeof(keys_received))
+        keys_received[num_keys_received++] = (char)key;
+
+    SIM_CHECK(num_keys_received == 2);
+    SIM_CHECK(keys_received[0] == 'a' && keys_received[1] == 'b');
+}
+
+/* Scenario: key state register read while the main loop publishes two changes */
+
+static uint8_t state_read[KEYBOARD_STATE_SIZE];
+
+static void state_main(void)
+{
+    fake_key_set(0, 0, 1);
+    app_step();
+    fake_key_set(0, 1, 1);
+    app_step();
+}
+
+static void state_select(void)
+{
+    fake_i2c_start(ADDR, 0);
+    fake_i2c_write_byte(REG_KEY_STATE);
+}
+
+static void state_addr(void)
+{
+    // Repeated start, the register is copied out at address match
+    fake_i2c_start(ADDR, 1);
+}
+
+static void state_data(void)
+{
+    for (int i = 0; i < KEYBOARD_STATE_SIZE; i++)
+        state_read[i] = fake_i2c_read_byte(i + 1 < KEYBOARD_STATE_SIZE);
+    fake_i2c_stop();
+}
+
+static void state_check(void)
+{
+    // Only a published state may be seen: none, (0,0) or (0,0)+(0,1) pressed
+    uint8_t valid[3][KEYBOARD_STATE_SIZE] = {{0}};
+    int match = 0;
+
+    valid[1][0] = 0x01;
+    valid[2][0] = 0x03;
+
+    for (int i = 0; i < 3; i++)
+        match |= memcmp(state_read, valid[i], KEYBOARD_STATE_SIZE) == 0;
+
+    if (!match)
+    {
+        sim_fail("torn key state read: %02X %02X ... modifiers %02X",
+                 state_read[0], state_read[1], state_read[KEYBOARD_BITMAP_SIZE]);
+    }
+}
+
+/* Scenario: config writes while the main loop persists earlier ones */
+
+static void config_setup(void)
+{
+    uint8_t set[3] = { CFG_SCAN_INTERVAL_MS, 3, 0 };
+
+    host_write_reg(REG_CONFIG, set, sizeof(set));
+}
+
+static void config_main(void)
+{
+    config_service();
+    config_service();
+}
+
+static void config_write_5(void)
+{
+    uint8_t set[3] = { CFG_IRQ_PULSE_MS, 5, 0 };
+
+    host_write_reg(REG_CONFIG, set, sizeof(set));
+}
+
+static void config_write_7(void)
+{
+    uint8_t set[3] = { CFG_IRQ_PULSE_MS, 7, 0 };
+
+    host_write_reg(REG_CONFIG, set, sizeof(set));
+}
+
+static void config_check(void)
+{
+    // Whatever is still dirty goes out now, then the flash must hold the last values
+    config_service();
+    config_init();
+
+    SIM_CHECK(config_get(CFG_SCAN_INTERVAL_MS) == 3);
+    SIM_CHECK(config_get(CFG_IRQ_PULSE_MS) == 7);
+}
+
+/* Scenario: capture commands picked up by the scan */
+
+static void capture_main(void)
+{
+    app_step();
+    app_step();
+}
+
+static void capture_start(void)
+{
+    uint8_t cmd = CAPTURE_CMD_START;
+
+    host_write_reg(REG_CAPTURE_CTRL, &cmd, 1);
+}
+
+static void capture_stop(void)
+{
+    uint8_t cmd = CAPTURE_CMD_STOP;
+
+    host_write_reg(REG_CAPTURE_CTRL, &cmd, 1);
+}
+
+static void capture_check(void)
+{
+    uint8_t status[4];
+
+    // The last command wins
+    app_step();
+    capture_get_status(status);
+    SIM_CHECK(status[0] == CAPTURE_STATE_STOPPED);
+}
+
+/* Scenario: keymap activation while the main loop stores the keymap */
+
+static uint8_t keymap_activate_cmd[3];
+
+static uint16_t crc16(const uint8_t *data, uint32_t len)
+{
+    // CRC-16/CCITT-FALSE, as expected by REG_KEYMAP_CTRL
+    uint16_t crc = 0xFFFF;
+
+    for (uint32_t i = 0; i < len; i++)
+    {
+        crc ^= (uint16_t)data[i] << 8;
+        for (int b = 0; b < 8; b++)
+            crc = (crc & 0x8000) ? (uint16_t)((crc << 1) ^ 0x1021) : (uint16_t)(crc << 1);
+    }
+
+    return crc;
+}
+
+static void keymap_setup(void)
+{
+    keymap_t map = *keymap_active();
+    uint16_t crc;
+
+    // Stage a keymap with two keys swapped, the first interrupt activates it
+    map.primary[0][0] = 'W';
+    map.primary[0][1] = 'Q';
+    keymap_write(0, (const uint8_t *)&map, KEYMAP_SIZE);
+
+    crc = crc16((const uint8_t *)&map, KEYMAP_SIZE);
+    keymap_activate_cmd[0] = KEYMAP_CMD_ACTIVATE;
+    keymap_activate_cmd[1] = (uint8_t)crc;
+    keymap_activate_cmd[2] = (uint8_t)(crc >> 8);
+}
+
+static void keymap_main(void)
+{
+    keymap_service();
+    keymap_service();
+}
+
+static void keymap_activate(void)
+{
+    host_write_reg(REG_KEYMAP_CTRL, keymap_activate_cmd, sizeof(keymap_activate_cmd));
+}
+
+static void keymap_default(void)
+{
+    uint8_t cmd[3] = { KEYMAP_CMD_DEFAULT, 0, 0 };
+
+    host_write_reg(REG_KEYMAP_CTRL, cmd, sizeof(cmd));
+}
+
+static void keymap_check(void)
+{
+    uint16_t active;
+
+    // Once the main loop caught up, a reboot must come back with the active keymap
+    keymap_service();
+    active = crc16((const uint8_t *)keymap_active(), KEYMAP_SIZE);
+
+    keymap_init();
+    SIM_CHECK(crc16((const uint8_t *)keymap_active(), KEYMAP_SIZE) == active);
+}
+
+/* Scenario: bus error while the main loop services the slave */
+
+static void bus_error_main(void)
+{
+    i2c_service();
+    i2c_irq_moderation_poll();
+    i2c_service();
+}
+
+static void bus_error_irq(void)
+{
+    fake_i2c_bus_error();
+}
+
+static void bus_error_read(void)
+{
+    // The slave may not answer yet, the host retries later
+    uint8_t key;
+
+    fake_i2c_read(ADDR, &key, 1);
+}
+
+static void bus_error_check(void)
+{
+    i2c_service();
+
+    SIM_CHECK(fake_i2c_listening());
+    SIM_CHECK(host_read_key() == 0);
+    SIM_CHECK(!i2c_busy);
+}
+
+static const sim_scenario_t scenarios[] =
+{
+    {
+        "key_queue", NULL, keys_main,
+        { { "addr", keys_addr }, { "nack", keys_nack }, { "addr", keys_addr }, { "nack", keys_nack } }, 4,
+        keys_check
+    },
+    {
+        "key_state", NULL, state_main,
+        { { "select", state_select }, { "addr", state_addr }, { "data", state_data } }, 3,
+        state_check
+    },
+    {
+        "config", config_setup, config_main,
+        { { "write 5", config_write_5 }, { "write 7", config_write_7 } }, 2,
+        config_check
+    },
+    {
+        "capture", NULL, capture_main,
+        { { "start", capture_start }, { "stop", capture_stop } }, 2,
+        capture_check
+    },
+    {
+        "keymap", keymap_setup, keymap_main,
+        { { "activate", keymap_activate }, { "default", keymap_default } }, 2,
+        keymap_check
+    },
+    {
+        "bus_error", NULL, bus_error_main,
+        { { "bus error", bus_error_irq }, { "read", bus_error_read } }, 2,
+        bus_error_check
+    },
+};
+
+/* Driver */
+
+static void sim_child(const sim_scenario_t *scenario, const int *schedule, int fd)
+{
+    sim = scenario;
+    sim_report_fd = fd;
+    memcpy(sim_schedule, schedule, sizeof(sim_schedule));
+    alarm(SIM_TIMEOUT_S);
+
+    fake_reset();
+    app_init();
+
+    if (sim->setup)
+        sim->setup();
+
+    fake_set_preempt_hook(sim_preempt);
+    sim->main_work();
+    fake_set_preempt_hook(NULL);
+
+    // Interrupts scheduled past the last point arrive once the work is done
+    while (sim_next_irq < sim->num_irqs)
+        sim_run_irq("end");
+
+    sim->check();
+}
+
+// Runs one schedule in a fresh process, returns 0 on success
+static int sim_run(const sim_scenario_t *scenario, const int *schedule, int *points, char *report, size_t size)
+{
+    int fds[2];
+    int status;
+    ssize_t len;
+    pid_t pid;
+
+    if (pipe(fds) != 0)
+    {
+        perror("pipe");
+        exit(2);
+    }
+
+    fflush(stdout);
+    pid = fork();
+    if (pid == 0)
+    {
+        close(fds[0]);
+        sim_child(scenario, schedule, fds[1]);
+        dprintf(fds[1], "%d", sim_points);
+        _exit(0);
+    }
+
+    close(fds[1]);
+    len = read(fds[0], report, size - 1);
+    report[len > 0 ? len : 0] = '\0';
+    close(fds[0]);
+    waitpid(pid, &status, 0);
+
+    if (WIFEXITED(status) && WEXITSTATUS(status) == 0)
+    {
+        if (points)
+            *points = atoi(report);
+        return 0;
+    }
+
+    if (WIFSIGNALED(status) && WTERMSIG(status) == SIGALRM)
+        snprintf(report, size, "deadlock: no progress for %d s", SIM_TIMEOUT_S);
+    else if (WIFSIGNALED(status))
+        snprintf(report, size, "killed by signal %d", WTERMSIG(status));
+
+    return 1;
+}
+
+static int sim_scenario(const sim_scenario_t *scenario)
+{
+    int schedule[SIM_MAX_IRQS];
+    char report[512];
+    int points = 0;
+    long runs = 0;
+    int failures = 0;
+
+    // Undisturbed run: every interrupt after the work, counts the points
+    for (int i = 0; i < SIM_MAX_IRQS; i++)
+        schedule[i] = -1;
+
+    if (sim_run(scenario, schedule, &points, report, sizeof(report)))
+    {
+        printf("FAIL %s (no preemption)\n      %s\n", scenario->name, report);
+        return 1;
+    }
+
+    // Every non-decreasing placement of the interrupts on points 0..points,
+    // placement "points" meaning after the work
+    for (int i = 0; i < scenario->num_irqs; i++)
+        schedule[i] = 0;
+
+    while (1)
+    {
+        runs++;
+
+        if (sim_run(scenario, schedule, NULL, report, sizeof(report)))
+        {
+            if (failures < SIM_MAX_REPORTS)
+                printf("  %s: %s\n", scenario->name, report);
+            failures++;
+        }
+
+        int i = scenario->num_irqs - 1;
+        while (i >= 0 && schedule[i] == points)
+            i--;
+
+        if (i < 0)
+            break;
+
+        schedule[i]++;
+        for (int j = i + 1; j < scenario->num_irqs; j++)
+            schedule[j] = schedule[i];
+    }
+
+    printf("%s %s: %d preemption points, %ld schedules, %d failed\n",
+           failures ? "FAIL" : "PASS", scenario->name, points, runs, failures);
+    return failures != 0;
+}
+
+int main(int argc, char **argv)
+{
+    int failed = 0;
+    int run = 0;
+
+    for (size_t i = 0; i < sizeof(scenarios) / sizeof(scenarios[0]); i++)
+    {
+        // Optional filter: run only scenarios whose name contains argv[1]
+        if (argc > 1 && !strstr(scenarios[i].name, argv[1]))
+            continue;
+
+        run++;
+        failed += sim_scenario(&scenarios[i]);
+    }
+
+    printf("%d/%d scenarios race free\n", run - failed, run);
+    return failed ? 1 : 0;
+}
@@ -0,0 +1,1538 @@
+/**
+ * Blackberry Q10 keyboard STM32 driver
+ * A fun little weekend project to act as a BBQ10 STM32 driver that is able to communicate with I2C bus masters.
+ * Creates rising-edge IRQ pulse, sends pressed character over I2C when master reads from slave upon receiving interrupt.
+ *
+ * Copyright (C) 2025 Mustafa Ozcelikors
+ *
+ * See GPLv3 LICENSE file in repository for licensing details.
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+/* Host tests of the firmware, each test runs in its own process so the
+ * firmware's static state starts from power-on every time. */
+
+#include "hal_fake.h"
+#include "app.h"
+#include "bench.h"
+#include "capture_decode.h"
+#include "config.h"
+#include "cpuload.h"
+#include "crashlog.h"
+#include "i2c_slave.h"
+#include "irq_prio.h"
+#include "keyboard.h"
+#include "keymap.h"
+#include "registers.h"
+#include "selftest.h"
+#include "stats.h"
+#include "trace.h"
+#include "watchdog.h"
+#include <setjmp.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/wait.h>
+#include <unistd.h>
+
+#define ADDR KEYBOARD_I2C_ADDRESS
+
+#define CHECK(cond) do { \
+    if (!(cond)) { \
+        fprintf(stderr, "%s:%d: CHECK(%s) failed\n", __FILE__, __LINE__, #cond); \
+        exit(1); \
+    } \
+} while (0)
+
+#define CHECK_EQ(a, b) do { \
+    long long a_ = (long long)(a), b_ = (long long)(b); \
+    if (a_ != b_) { \
+        fprintf(stderr, "%s:%d: CHECK_EQ(%s, %s) failed: %lld != %lld\n", \
+                __FILE__, __LINE__, #a, #b, a_, b_); \
+        exit(1); \
+    } \
+} while (0)
+
+/* Helpers */
+
+static void tap(uint8_t row, uint8_t col)
+{
+    fake_key_set(row, col, 1);
+    app_step();
+    fake_key_set(row, col, 0);
+    app_step();
+}
+
+static uint8_t read_key(void)
+{
+    uint8_t key = 0xFF;
+
+    CHECK(fake_i2c_read(ADDR, &key, 1));
+    return key;
+}
+
+static void write_reg(uint8_t reg, const uint8_t *data, uint8_t len)
+{
+    uint8_t buf[I2C_RX_BUF_SIZE];
+
+    buf[0] = reg;
+    memcpy(&buf[1], data, len);
+    CHECK(fake_i2c_write(ADDR, buf, len + 1));
+}
+
+static uint32_t scan_settle_us(void)
+{
+    // Settle delays of one scan, the columns' calibrated times
+    uint8_t buf[2 * NUM_COLS];
+    uint32_t sum = 0;
+
+    CHECK(fake_i2c_read_reg(ADDR, REG_COL_SETTLE, buf, sizeof(buf)));
+    for (int c = 0; c < NUM_COLS; c++)
+        sum += buf[2 * c] | (buf[2 * c + 1] << 8);
+
+    return sum;
+}
+
+static uint16_t crc16(const uint8_t *data, uint32_t len)
+{
+    // CRC-16/CCITT-FALSE, as expected by REG_KEYMAP_CTRL
+    uint16_t crc = 0xFFFF;
+
+    for (uint32_t i = 0; i < len; i++)
+    {
+        crc ^= (uint16_t)data[i] << 8;
+        for (int b = 0; b < 8; b++)
+            crc = (crc & 0x8000) ? (uint16_t)((crc << 1) ^ 0x1021) : (uint16_t)(crc << 1);
+    }
+
+    return crc;
+}
+
+/* Tests */
+
+static void test_key_press_is_queued(void)
+{
+    CHECK_EQ(read_key(), 0);
+
+    tap(0, 0);
+
+    CHECK_EQ(read_key(), 'q');
+    CHECK_EQ(read_key(), 0);
+}
+
+static void test_key_fifo_keeps_order(void)
+{
+    tap(0, 0);  // q
+    tap(0, 1);  // e
+    tap(0, 2);  // r
+
+    CHECK_EQ(read_key(), 'q');
+    CHECK_EQ(read_key(), 'e');
+    CHECK_EQ(read_key(), 'r');
+    CHECK_EQ(read_key(), 0);
+}
+
+static void test_modifiers_apply_to_next_key(void)
+{
+    tap(ROW_ALT, COL_ALT);
+    tap(0, 0);
+    CHECK_EQ(read_key(), '#');
+
+    tap(ROW_LSHIFT, COL_LSHIFT);
+    tap(0, 0);
+    CHECK_EQ(read_key(), 'Q');
+
+    tap(0, 0);
+    CHECK_EQ(read_key(), 'q');
+}
+
+static void test_rollover_sends_each_key_once(void)
+{
+    // Next key down before the previous one is up, releasing either sends nothing
+    fake_key_set(0, 0, 1);
+    app_step();
+    fake_key_set(0, 1, 1);
+    app_step();
+    fake_key_set(0, 0, 0);
+    app_step();
+    fake_key_set(0, 1, 0);
+    app_step();
+
+    CHECK_EQ(read_key(), 'q');
+    CHECK_EQ(read_key(), 'e');
+    CHECK_EQ(read_key(), 0);
+
+    // Shift still held when the key goes down applies to that key only
+    fake_key_set(ROW_LSHIFT, COL_LSHIFT, 1);
+    app_step();
+    fake_key_set(0, 0, 1);
+    app_step();
+    fake_key_set(0, 0, 0);
+    app_step();
+    tap(0, 1);
+    fake_key_set(ROW_LSHIFT, COL_LSHIFT, 0);
+    app_step();
+    tap(0, 2);
+
+    CHECK_EQ(read_key(), 'Q');
+    CHECK_EQ(read_key(), 'e');
+    CHECK_EQ(read_key(), 'r');
+    CHECK_EQ(read_key(), 0);
+}
+
+static void test_irq_is_coalesced(void)
+{
+    uint64_t pressed_at;
+
+    fake_key_set(0, 0, 1);
+    pressed_at = fake_now_us();
+
+    while (fake_irq_pulses() == 0)
+    {
+        app_step();
+        CHECK(fake_now_us() - pressed_at < 100000);
+    }
+
+    // One pulse after the coalescing timeout, not one per scan
+    CHECK(fake_irq_last_rise_us() - pressed_at >= IRQ_COALESCE_TIMEOUT_US);
+    CHECK_EQ(fake_irq_pulses(), 1);
+}
+
+static void test_irq_immediate_mode(void)
+{
+    CHECK(config_set(CFG_IRQ_COALESCE_EVENTS, 0));
+
+    tap(0, 0);
+    CHECK_EQ(fake_irq_pulses(), 1);
+
+    tap(0, 1);
+    CHECK_EQ(fake_irq_pulses(), 2);
+}
+
+static void test_irq_pulse_does_not_block(void)
+{
+    uint64_t rise;
+
+    CHECK(config_set(CFG_IRQ_COALESCE_EVENTS, 0));
+    CHECK(config_set(CFG_IRQ_PULSE_MS, 50));
+    app_step();  // settings written to flash
+
+    fake_key_set(0, 0, 1);
+    app_step();
+    fake_key_set(0, 0, 0);
+    CHECK_EQ(fake_irq_pulses(), 1);
+    rise = fake_irq_last_rise_us();
+
+    // The tick ends the pulse, the main loop keeps scanning meanwhile
+    CHECK(fake_now_us() - rise < 50000);
+    CHECK(GPIOB->ODR & GPIO_PIN_13);
+
+    // A key during the pulse gets its own edge once the pulse ended
+    tap(0, 1);
+    CHECK_EQ(fake_irq_pulses(), 1);
+
+    while (fake_irq_pulses() == 1)
+    {
+        app_step();
+        CHECK(fake_now_us() - rise < 100000);
+    }
+
+    CHECK(fake_irq_last_rise_us() - rise > 50000);
+    CHECK_EQ(read_key(), 'q');
+    CHECK_EQ(read_key(), 'e');
+}
+
+static void test_interrupt_priorities(void)
+{
+    // I2C above the tick above the deferred decode
+    CHECK(IRQ_PRIO_I2C < IRQ_PRIO_TICK && IRQ_PRIO_TICK < IRQ_PRIO_DEFERRED);
+
+    CHECK_EQ(fake_nvic_priority(I2C1_EV_IRQn), IRQ_PRIO_I2C);
+    CHECK_EQ(fake_nvic_priority(I2C1_ER_IRQn), IRQ_PRIO_I2C);
+    CHECK_EQ(fake_nvic_priority(BENCH_IRQn), IRQ_PRIO_I2C);
+    CHECK_EQ(fake_nvic_priority(EXTI0_IRQn), IRQ_PRIO_EDGE);
+    CHECK_EQ(fake_nvic_priority(EXTI15_10_IRQn), IRQ_PRIO_EDGE);
+    CHECK_EQ(fake_nvic_priority(PendSV_IRQn), IRQ_PRIO_DEFERRED);
+}
+
+static void test_sym_debounce_does_not_stall(void)
+{
+    uint8_t state[KEYBOARD_STATE_SIZE];
+    uint64_t start = fake_now_us();
+
+    fake_key_set(ROW_SYM, COL_SYM, 1);
+    app_step();
+    app_step();
+
+    // Toggled once, the scan goes on within the debounce time
+    CHECK(fake_now_us() - start < SYM_DEBOUNCE_MS * 1000);
+    CHECK(fake_i2c_read_reg(ADDR, REG_KEY_STATE, state, sizeof(state)));
+    CHECK(state[KEYBOARD_BITMAP_SIZE] & KEY_MOD_CAPS_LOCK);
+
+    // Held past the debounce time toggles again
+    while (fake_now_us() - start < (SYM_DEBOUNCE_MS + 20) * 1000)
+        app_step();
+
+    CHECK(fake_i2c_read_reg(ADDR, REG_KEY_STATE, state, sizeof(state)));
+    CHECK(!(state[KEYBOARD_BITMAP_SIZE] & KEY_MOD_CAPS_LOCK));
+}
+
+static void test_press_and_hold_is_timed(void)
+{
+    uint64_t start = fake_now_us();
+
+    // Held for many calibrated scans but short of the repeat delay, sent once
+    fake_key_set(0, 0, 1);
+    while (fake_now_us() - start < (PRESS_AND_HOLD_MS - 50) * 1000)
+        app_step();
+    fake_key_set(0, 0, 0);
+    app_step();
+
+    CHECK_EQ(read_key(), 'q');
+    CHECK_EQ(read_key(), 0);
+
+    // Held past it, the key repeats
+    start = fake_now_us();
+    fake_key_set(0, 0, 1);
+    while (fake_now_us() - start < (PRESS_AND_HOLD_MS + 20) * 1000)
+        app_step();
+    fake_key_set(0, 0, 0);
+    app_step();
+
+    CHECK_EQ(read_key(), 'q');
+    CHECK_EQ(read_key(), 'q');
+}
+
+static void test_key_state_register(void)
+{
+    uint8_t state[KEYBOARD_STATE_SIZE];
+    uint8_t bit = ROW_ALT * NUM_COLS + COL_ALT;
+
+    fake_key_set(ROW_ALT, COL_ALT, 1);
+    app_step();
+
+    CHECK(fake_i2c_read_reg(ADDR, REG_KEY_STATE, state, sizeof(state)));
+    CHECK(state[bit >> 3] & (1 << (bit & 7)));
+    CHECK(state[KEYBOARD_BITMAP_SIZE] & KEY_MOD_ALT);
+
+    // Selection falls back to the key queue after one read
+    CHECK_EQ(read_key(), 0);
+}
+
+static void test_other_address_is_not_acked(void)
+{
+    uint8_t key;
+
+    CHECK(!fake_i2c_read(ADDR + 1, &key, 1));
+    CHECK(fake_i2c_read(ADDR, &key, 1));
+}
+
+static void test_aborted_key_read_is_resent(void)
+{
+    tap(0, 0);
+
+    // STOP in the middle of the key byte: the key was already loaded for
+    // sending but never reached the host
+    CHECK(fake_i2c_start(ADDR, 1));
+    fake_i2c_stop();
+    app_step();
+
+    CHECK_EQ(read_key(), 'q');
+    CHECK_EQ(read_key(), 0);
+}
+
+static void test_bus_error_recovers(void)
+{
+    uint8_t key;
+
+    // The HAL disables the I2C interrupts after a bus error, the main loop
+    // has to restart listening
+    fake_i2c_bus_error();
+    CHECK(!fake_i2c_read(ADDR, &key, 1));
+
+    app_step();
+    CHECK(fake_i2c_read(ADDR, &key, 1));
+    CHECK(!i2c_busy);
+}
+
+static void test_config_persists(void)
+{
+    uint8_t set[3] = { CFG_IRQ_PULSE_MS, 5, 0 };
+    uint8_t value[2];
+
+    write_reg(REG_CONFIG, set, sizeof(set));
+    CHECK_EQ(config_get(CFG_IRQ_PULSE_MS), 5);
+
+    CHECK(fake_i2c_read_reg(ADDR, REG_CONFIG, value, sizeof(value)));
+    CHECK_EQ(value[0] | (value[1] << 8), 5);
+
+    // Main loop writes it out, a reboot reads it back
+    app_step();
+    config_init();
+    CHECK_EQ(config_get(CFG_IRQ_PULSE_MS), 5);
+}
+
+static void test_config_rejects_out_of_range(void)
+{
+    uint8_t set[3] = { CFG_PRESS_AND_HOLD_MS, 0x89, 0x13 };
+
+    write_reg(REG_CONFIG, set, sizeof(set));
+    CHECK_EQ(config_get(CFG_PRESS_AND_HOLD_MS), PRESS_AND_HOLD_MS);
+}
+
+static uint16_t upload_keymap(char q)
+{
+    // Active keymap with the 'q' key replaced, in REG_KEYMAP_DATA sized chunks
+    keymap_t map;
+    uint8_t chunk[I2C_RX_BUF_SIZE - 1];
+
+    memcpy(&map, keymap_active(), KEYMAP_SIZE);
+    map.primary[0][0] = q;
+
+    for (uint8_t offset = 0; offset < KEYMAP_SIZE; offset += sizeof(chunk) - 1)
+    {
+        uint8_t len = KEYMAP_SIZE - offset;
+        if (len > sizeof(chunk) - 1)
+            len = sizeof(chunk) - 1;
+
+        chunk[0] = offset;
+        memcpy(&chunk[1], (const uint8_t *)&map + offset, len);
+        write_reg(REG_KEYMAP_DATA, chunk, len + 1);
+    }
+
+    return crc16((const uint8_t *)&map, KEYMAP_SIZE);
+}
+
+static void test_keymap_upload(void)
+{
+    uint8_t status[3];
+    uint16_t crc = upload_keymap('%');
+
+    // Nothing changes before activation, reading a register also moves the
+    // register pointer back to REG_KEY
+    CHECK(fake_i2c_read_reg(ADDR, REG_KEYMAP_CTRL, status, sizeof(status)));
+    CHECK_EQ(status[0], KEYMAP_STATUS_IDLE);
+
+    tap(0, 0);
+    CHECK_EQ(read_key(), 'q');
+
+    uint8_t cmd[3] = { KEYMAP_CMD_ACTIVATE, (uint8_t)crc, (uint8_t)(crc >> 8) };
+    write_reg(REG_KEYMAP_CTRL, cmd, sizeof(cmd));
+
+    // The main loop checks the CRC, the I2C ISR only takes the command
+    CHECK(fake_i2c_read_reg(ADDR, REG_KEYMAP_CTRL, status, sizeof(status)));
+    CHECK_EQ(status[0], KEYMAP_STATUS_BUSY);
+    CHECK((status[1] | (status[2] << 8)) != crc);
+
+    app_step();
+    CHECK(fake_i2c_read_reg(ADDR, REG_KEYMAP_CTRL, status, sizeof(status)));
+    CHECK_EQ(status[0], KEYMAP_STATUS_OK);
+    CHECK_EQ(status[1] | (status[2] << 8), crc);
+
+    tap(0, 0);
+    CHECK_EQ(read_key(), '%');
+
+    // Stored by the main loop, survives a reboot
+    keymap_init();
+    CHECK_EQ(keymap_active()->primary[0][0], '%');
+    CHECK(fake_i2c_read_reg(ADDR, REG_KEYMAP_CTRL, status, sizeof(status)));
+    CHECK_EQ(status[1] | (status[2] << 8), crc);
+
+    // Back to the built-in keymap, its CRC with it, done once the slot is erased
+    cmd[0] = KEYMAP_CMD_DEFAULT;
+    write_reg(REG_KEYMAP_CTRL, cmd, sizeof(cmd));
+    CHECK(fake_i2c_read_reg(ADDR, REG_KEYMAP_CTRL, status, sizeof(status)));
+    CHECK_EQ(status[0], KEYMAP_STATUS_BUSY);
+
+    app_step();
+    CHECK(fake_i2c_read_reg(ADDR, REG_KEYMAP_CTRL, status, sizeof(status)));
+    CHECK_EQ(status[0], KEYMAP_STATUS_OK);
+    CHECK_EQ(status[1] | (status[2] << 8), crc16((const uint8_t *)keymap_active(), KEYMAP_SIZE));
+    CHECK_EQ(keymap_active()->primary[0][0], 'Q');
+}
+
+static void test_keymap_bad_crc(void)
+{
+    uint8_t cmd[3] = { KEYMAP_CMD_ACTIVATE, 0x12, 0x34 };
+    uint8_t status[3];
+
+    write_reg(REG_KEYMAP_CTRL, cmd, sizeof(cmd));
+    app_step();
+
+    CHECK(fake_i2c_read_reg(ADDR, REG_KEYMAP_CTRL, status, sizeof(status)));
+    CHECK_EQ(status[0], KEYMAP_STATUS_BAD_CRC);
+
+    tap(0, 0);
+    CHECK_EQ(read_key(), 'q');
+}
+
+static uint8_t keymap_status_while_saving[3];
+
+static void keymap_default_while_saving(void)
+{
+    uint8_t cmd[4] = { REG_KEYMAP_CTRL, KEYMAP_CMD_DEFAULT, 0, 0 };
+
+    CHECK(fake_i2c_write(ADDR, cmd, sizeof(cmd)));
+    CHECK(fake_i2c_read_reg(ADDR, REG_KEYMAP_CTRL, keymap_status_while_saving, sizeof(keymap_status_while_saving)));
+}
+
+static void test_keymap_command_while_saving(void)
+{
+    uint16_t crc = upload_keymap('%');
+    uint8_t cmd[3] = { KEYMAP_CMD_ACTIVATE, (uint8_t)crc, (uint8_t)(crc >> 8) };
+    uint8_t status[3];
+
+    // A command lands in the flash save of the activation, the 1 s sector erase
+    write_reg(REG_KEYMAP_CTRL, cmd, sizeof(cmd));
+    fake_set_alarm(fake_now_us() + 100000, keymap_default_while_saving);
+    app_step();
+
+    CHECK_EQ(keymap_status_while_saving[0], KEYMAP_STATUS_BUSY);
+
+    // The save reports its own outcome, the dropped command leaves nothing busy
+    CHECK(fake_i2c_read_reg(ADDR, REG_KEYMAP_CTRL, status, sizeof(status)));
+    CHECK_EQ(status[0], KEYMAP_STATUS_OK);
+    CHECK_EQ(status[1] | (status[2] << 8), crc);
+    CHECK_EQ(keymap_active()->primary[0][0], '%');
+
+    // Taken once the status is no longer busy
+    cmd[0] = KEYMAP_CMD_DEFAULT;
+    write_reg(REG_KEYMAP_CTRL, cmd, sizeof(cmd));
+    app_step();
+    CHECK(fake_i2c_read_reg(ADDR, REG_KEYMAP_CTRL, status, sizeof(status)));
+    CHECK_EQ(status[0], KEYMAP_STATUS_OK);
+    CHECK_EQ(keymap_active()->primary[0][0], 'Q');
+}
+
+static uint16_t capture_stop_and_read(uint8_t *image, uint16_t max)
+{
+    uint8_t cmd = CAPTURE_CMD_STOP;
+    uint8_t status[4];
+    uint16_t size;
+
+    write_reg(REG_CAPTURE_CTRL, &cmd, 1);
+    app_step();
+
+    CHECK(fake_i2c_read_reg(ADDR, REG_CAPTURE_CTRL, status, sizeof(status)));
+    CHECK_EQ(status[0], CAPTURE_STATE_STOPPED);
+
+    size = status[2] | (status[3] << 8);
+    CHECK(size <= max);
+
+    for (uint16_t offset = 0; offset < size; offset += I2C_TX_BUF_SIZE)
+    {
+        uint8_t select[3] = { REG_CAPTURE_DATA, (uint8_t)offset, (uint8_t)(offset >> 8) };
+        uint8_t len = size - offset < I2C_TX_BUF_SIZE ? size - offset : I2C_TX_BUF_SIZE;
+
+        // Offset select, repeated start, read
+        CHECK(fake_i2c_start(ADDR, 0));
+        for (int i = 0; i < 3; i++)
+            CHECK(fake_i2c_write_byte(select[i]));
+        CHECK(fake_i2c_start(ADDR, 1));
+        for (uint8_t i = 0; i < len; i++)
+            image[offset + i] = fake_i2c_read_byte(i + 1 < len);
+        fake_i2c_stop();
+    }
+
+    return size;
+}
+
+typedef struct
+{
+    uint8_t last[KEYBOARD_BITMAP_SIZE];
+    int changes;
+    int presses_of_q;
+} capture_check_t;
+
+static void capture_check_frame(const uint8_t bits[KEYBOARD_BITMAP_SIZE], uint32_t dt_us, void *ctx)
+{
+    capture_check_t *check = ctx;
+
+    if (memcmp(bits, check->last, KEYBOARD_BITMAP_SIZE) != 0)
+    {
+        check->changes++;
+        if ((bits[0] & 1) && !(check->last[0] & 1))
+            check->presses_of_q++;
+    }
+
+    memcpy(check->last, bits, KEYBOARD_BITMAP_SIZE);
+}
+
+static void test_capture_round_trip(void)
+{
+    static uint8_t image[CAPTURE_HEADER_SIZE + CAPTURE_RING_SIZE];
+    capture_check_t check = {0};
+    uint8_t cmd = CAPTURE_CMD_START;
+    uint16_t size;
+    long frames;
+
+    write_reg(REG_CAPTURE_CTRL, &cmd, 1);
+    app_step();
+
+    tap(0, 0);
+    tap(0, 1);
+    app_step();
+
+    size = capture_stop_and_read(image, sizeof(image));
+    frames = capture_decode(image, size, capture_check_frame, &check);
+
+    // Recording starts at the scan that applies the command, one scan per frame
+    CHECK_EQ(frames, 6);
+    CHECK_EQ(check.changes, 4);
+    CHECK_EQ(check.presses_of_q, 1);
+}
+
+static void test_capture_ring_wraps(void)
+{
+    static uint8_t image[CAPTURE_HEADER_SIZE + CAPTURE_RING_SIZE];
+    capture_check_t check = {0};
+    uint8_t cmd = CAPTURE_CMD_START;
+    uint8_t status[4];
+    uint16_t size;
+
+    write_reg(REG_CAPTURE_CTRL, &cmd, 1);
+    app_step();
+
+    // Each tap is two short records, enough of them to wrap the ring
+    for (int i = 0; i < CAPTURE_RING_SIZE / 2; i++)
+        tap(0, 0);
+
+    CHECK(fake_i2c_read_reg(ADDR, REG_CAPTURE_CTRL, status, sizeof(status)));
+    CHECK(status[1] & CAPTURE_FLAG_WRAPPED);
+
+    size = capture_stop_and_read(image, sizeof(image));
+    CHECK(capture_decode(image, size, capture_check_frame, &check) > 0);
+
+    // Base frame keeps the decode in step after eviction, the last frame is released
+    CHECK(check.presses_of_q > 0);
+    CHECK_EQ(check.last[0] & 1, 0);
+}
+
+static uint32_t get_u32(const uint8_t *buf)
+{
+    return buf[0] | (buf[1] << 8) | (buf[2] << 16) | ((uint32_t)buf[3] << 24);
+}
+
+static void test_bench_probes(void)
+{
+    uint8_t cmd = BENCH_CMD_START;
+    uint8_t probe = BENCH_SCAN;
+    uint8_t status[4];
+    uint8_t stats[16];
+    uint8_t hist[2 * BENCH_HIST_BUCKETS];
+    uint32_t count, min, max, mean, total = 0;
+
+    write_reg(REG_BENCH_CTRL, &cmd, 1);
+    CHECK(fake_i2c_read(ADDR, status, sizeof(status)));
+    CHECK_EQ(status[0], BENCH_STATE_RUNNING);
+    CHECK_EQ(status[1], BENCH_NUM_PROBES);
+
+    tap(0, 0);
+    CHECK_EQ(read_key(), 'q');
+
+    write_reg(REG_BENCH_DATA, &probe, 1);
+    CHECK(fake_i2c_read_reg(ADDR, REG_BENCH_DATA, stats, sizeof(stats)));
+    count = get_u32(&stats[0]);
+    min = get_u32(&stats[4]);
+    max = get_u32(&stats[8]);
+    mean = get_u32(&stats[12]);
+
+    // Two scans, each at least the settle time of every column
+    CHECK_EQ(count, 2);
+    CHECK(min >= scan_settle_us() * (SystemCoreClock / 1000000));
+    CHECK(min <= mean && mean <= max);
+
+    write_reg(REG_BENCH_HIST, &probe, 1);
+    CHECK(fake_i2c_read_reg(ADDR, REG_BENCH_HIST, hist, sizeof(hist)));
+    for (int i = 0; i < BENCH_HIST_BUCKETS; i++)
+        total += hist[2 * i] | (hist[2 * i + 1] << 8);
+    CHECK_EQ(total, count);
+
+    // The key read ran the address callback
+    probe = BENCH_I2C_ADDR;
+    write_reg(REG_BENCH_DATA, &probe, 1);
+    CHECK(fake_i2c_read_reg(ADDR, REG_BENCH_DATA, stats, sizeof(stats)));
+    CHECK(get_u32(&stats[0]) > 0);
+
+    // Recording and reading a probe keep a caller's interrupt mask
+    bench_stats_t s;
+
+    __disable_irq();
+    bench_record(BENCH_SCAN, bench_start());
+    bench_get(BENCH_SCAN, &s);
+    CHECK(__get_PRIMASK());
+    __enable_irq();
+    CHECK_EQ(s.count, count + 1);
+}
+
+static uint32_t bench_single_sample(uint8_t probe)
+{
+    uint8_t stats[16];
+
+    write_reg(REG_BENCH_DATA, &probe, 1);
+    CHECK(fake_i2c_read(ADDR, stats, sizeof(stats)));
+    CHECK_EQ(get_u32(&stats[0]), 1);
+    CHECK_EQ(get_u32(&stats[4]), get_u32(&stats[8]));
+    return get_u32(&stats[4]);
+}
+
+static void test_bench_key_stages(void)
+{
+    uint8_t cmd = BENCH_CMD_START;
+    uint32_t scan, decode, queue, irq, read, total;
+
+    // Slow coalescing, so a host can poll a key before the IRQ; let the
+    // config save finish first
+    config_set(CFG_IRQ_COALESCE_TIMEOUT_US, 50000);
+    app_step();
+
+    write_reg(REG_BENCH_CTRL, &cmd, 1);
+    CHECK_EQ(read_key(), BENCH_STATE_RUNNING);
+
+    fake_key_set(0, 0, 1);
+    while (fake_irq_pulses() == 0)
+        app_step();
+    fake_key_set(0, 0, 0);
+    app_step();
+    CHECK_EQ(read_key(), 'q');
+
+    // One key, one sample per stage, and the stages add up to the total
+    scan = bench_single_sample(BENCH_KEY_SCAN);
+    decode = bench_single_sample(BENCH_KEY_DECODE);
+    queue = bench_single_sample(BENCH_KEY_QUEUE);
+    irq = bench_single_sample(BENCH_KEY_IRQ);
+    read = bench_single_sample(BENCH_KEY_READ);
+    total = bench_single_sample(BENCH_KEY_TOTAL);
+
+    CHECK(scan >= scan_settle_us() * (SystemCoreClock / 1000000));
+    CHECK(irq >= 50000 * (SystemCoreClock / 1000000));
+    CHECK(read > 0);
+    CHECK_EQ(scan + decode + queue + irq + read, total);
+
+    // A key the host polls before the IRQ has no read stage
+    tap(0, 0);
+    CHECK_EQ(read_key(), 'q');
+    CHECK_EQ(bench_single_sample(BENCH_KEY_READ), read);
+}
+
+static void stats_snapshot(uint8_t cmd, uint32_t counters[STATS_NUM_COUNTERS])
+{
+    uint8_t image[STATS_SIZE];
+    uint8_t status[2];
+
+    write_reg(REG_STATS_CTRL, &cmd, 1);
+    CHECK(fake_i2c_read(ADDR, status, sizeof(status)));
+    CHECK_EQ(status[0], STATS_NUM_COUNTERS);
+
+    // Larger than one read, fetch it in halves
+    for (uint8_t offset = 0; offset < STATS_SIZE; offset += STATS_SIZE / 2)
+    {
+        write_reg(REG_STATS_DATA, &offset, 1);
+        CHECK(fake_i2c_read(ADDR, &image[offset], STATS_SIZE / 2));
+    }
+
+    for (int i = 0; i < STATS_NUM_COUNTERS; i++)
+        counters[i] = get_u32(&image[4 * i]);
+}
+
+static void test_stats_counters(void)
+{
+    uint32_t counters[STATS_NUM_COUNTERS];
+    uint32_t scan_min;
+
+    tap(0, 0);
+    CHECK_EQ(read_key(), 'q');
+
+    stats_snapshot(STATS_CMD_SNAPSHOT_CLEAR, counters);
+    CHECK_EQ(counters[STATS_SCANS], 2);
+    scan_min = counters[STATS_SCAN_MIN];
+    CHECK(scan_min <= counters[STATS_SCAN_MAX]);
+    CHECK_EQ(counters[STATS_KEYS_QUEUED], 1);
+    CHECK_EQ(counters[STATS_KEYS_DELIVERED], 1);
+    CHECK_EQ(counters[STATS_KEYS_DROPPED], 0);
+    CHECK_EQ(counters[STATS_FIFO_HIGH_WATER], 1);
+    CHECK_EQ(counters[STATS_IRQ_PULSES], fake_irq_pulses());
+    CHECK_EQ(counters[STATS_I2C_NACKS], 0);
+    CHECK_EQ(counters[STATS_I2C_BUS_ERRORS], 0);
+
+    // The key read, then the address match of the snapshot command itself
+    CHECK_EQ(counters[STATS_I2C_ADDR], 2);
+    CHECK_EQ(counters[STATS_I2C_READS], 1);
+    CHECK_EQ(counters[STATS_I2C_WRITES], 1);
+
+    // Most of the time went to the scan interval wait
+    CHECK(counters[STATS_IDLE_MS] > 0);
+    CHECK(counters[STATS_IDLE_MS] <= counters[STATS_ELAPSED_MS]);
+
+    // The clear started a new period, only the snapshot traffic is in it
+    stats_snapshot(STATS_CMD_SNAPSHOT, counters);
+    CHECK_EQ(counters[STATS_SCANS], 0);
+    CHECK_EQ(counters[STATS_SCAN_MIN], 0);
+    CHECK_EQ(counters[STATS_SCAN_MAX], 0);
+    CHECK_EQ(counters[STATS_KEYS_QUEUED], 0);
+    CHECK_EQ(counters[STATS_FIFO_HIGH_WATER], 0);
+    CHECK_EQ(counters[STATS_I2C_WRITES], 3);
+    CHECK_EQ(counters[STATS_I2C_NACKS], 0);
+    CHECK_EQ(counters[STATS_I2C_READS], 3);
+    CHECK(counters[STATS_I2C_ADDR] > 0);
+
+    // A scan takes at least its settle delays
+    CHECK(scan_min >= scan_settle_us() * (SystemCoreClock / 1000000));
+}
+
+static uint16_t trace_status(void)
+{
+    uint8_t status[4];
+
+    CHECK(fake_i2c_read_reg(ADDR, REG_TRACE_CTRL, status, sizeof(status)));
+    CHECK_EQ(status[2], TRACE_RECORDS);
+    CHECK_EQ(status[3], TRACE_RECORD_SIZE);
+    return (uint16_t)(status[0] | (status[1] << 8));
+}
+
+static void trace_record(uint8_t slot, uint32_t record[4])
+{
+    uint8_t buf[TRACE_RECORD_SIZE];
+
+    write_reg(REG_TRACE_DATA, &slot, 1);
+    CHECK(fake_i2c_read(ADDR, buf, sizeof(buf)));
+    for (int i = 0; i < 4; i++)
+        record[i] = get_u32(&buf[4 * i]);
+
+    // Sequence byte of the slot's latest record
+    CHECK_EQ(record[0] & 0xFF, slot);
+}
+
+static void test_trace_ring(void)
+{
+    uint32_t boot[4], cr[4], error[4], restart[4];
+    uint8_t key;
+    uint8_t cmd = TRACE_CMD_CLEAR;
+
+    // Boot reason and the I2C registers after init, then a bus error and the
+    // restart of listening
+    fake_i2c_bus_error();
+    CHECK(!fake_i2c_read(ADDR, &key, 1));
+    app_step();
+
+    CHECK_EQ(trace_status(), 5);
+    trace_record(0, boot);
+    trace_record(1, cr);
+    trace_record(3, error);
+    trace_record(4, restart);
+
+    CHECK_EQ((boot[0] >> 8) & 0xFF, 2);
+    CHECK_EQ(boot[2], WATCHDOG_BOOT_POWER_ON);
+    CHECK_EQ((cr[0] >> 8) & 0xFF, 2);
+    CHECK(cr[1] - boot[1] < 0x80000000U);
+    CHECK_EQ(error[2] & HAL_I2C_ERROR_BERR, HAL_I2C_ERROR_BERR);
+    CHECK_EQ(restart[2], 0);
+
+    // Each trace point has its own format string
+    CHECK(error[0] >> 16 != restart[0] >> 16);
+    CHECK(error[0] >> 16 != cr[0] >> 16);
+
+    // Unused arguments are 0
+    CHECK_EQ((error[0] >> 8) & 0xFF, 1);
+    CHECK_EQ(error[3], 0);
+
+    write_reg(REG_TRACE_CTRL, &cmd, 1);
+    CHECK_EQ(trace_status(), 0);
+
+    // A debugger enabled ITM but SWO is behind: the ring still gets the
+    // record, the port is left alone instead of waited on
+    ITM->TCR = ITM_TCR_ITMENA_Msk;
+    ITM->TER = 1UL << TRACE_ITM_PORT;
+    ITM->PORT[TRACE_ITM_PORT].u32 = 0;
+    TRACE("test: %u", 7);
+    CHECK_EQ(trace_status(), 1);
+    CHECK_EQ(ITM->PORT[TRACE_ITM_PORT].u32, 0);
+
+    // Room in the FIFO, the record goes out; the fake port keeps the last word
+    ITM->PORT[TRACE_ITM_PORT].u32 = 1;
+    TRACE("test: %u %u", 7, 8);
+    CHECK_EQ(trace_status(), 2);
+    CHECK_EQ(ITM->PORT[TRACE_ITM_PORT].u32, 8);
+
+    // A trace point with interrupts masked leaves them masked
+    __disable_irq();
+    TRACE("test: %u", 9);
+    CHECK(__get_PRIMASK());
+    __enable_irq();
+    CHECK_EQ(trace_status(), 3);
+}
+
+static void test_cpu_load(void)
+{
+    uint8_t buf[CPULOAD_SIZE];
+    uint16_t load[CPULOAD_SIZE / 2];
+    uint32_t scan_us = scan_settle_us();
+    uint32_t sum = 0;
+
+    CHECK(fake_i2c_read_reg(ADDR, REG_CPU_LOAD, buf, sizeof(buf)));
+    CHECK_EQ(buf[0] | (buf[1] << 8), 0);
+
+    while (fake_now_us() < 2500000)
+        app_step();
+
+    CHECK(fake_i2c_read_reg(ADDR, REG_CPU_LOAD, buf, sizeof(buf)));
+    for (int i = 0; i < CPULOAD_SIZE / 2; i++)
+        load[i] = buf[2 * i] | (buf[2 * i + 1] << 8);
+
+    // Window, busy, main, deferred, I2C, tick, edge, idle, peak; the shares
+    // of one window add up to 100 % but for rounding
+    CHECK(load[0] >= CPULOAD_WINDOW_MS && load[0] <= CPULOAD_WINDOW_MS + 1);
+    CHECK_EQ(load[1] + load[7], 10000);
+    for (int i = 2; i <= 7; i++)
+        sum += load[i];
+    CHECK(sum >= 9995 && sum <= 10000);
+
+    // With calibrated settle times the scan is short next to the scan
+    // interval wait, which is idle, and the tick does some work; the host
+    // build delivers I2C events without an interrupt handler
+    CHECK(load[7] > load[2]);
+    CHECK(load[7] >= 10000 * (KEYBOARD_SCAN_INTERVAL_MS * 1000) / (scan_us + 2000));
+    CHECK(load[5] > 0);
+    CHECK_EQ(load[4], 0);
+    CHECK_EQ(load[6], 0);
+    CHECK(load[8] >= load[1]);
+
+    // A row edge interrupt is charged to its own context
+    uint32_t edge = cpuload_isr[CPULOAD_EDGE];
+
+    CHECK(config_set(CFG_EDGE_STAMP, 1));
+    app_step();
+    fake_key_set(0, 0, 1);
+    CHECK(cpuload_isr[CPULOAD_EDGE] > edge);
+    app_step();
+    CHECK_EQ(read_key(), 'q');
+
+    // Accounting a frame keeps a caller's interrupt mask
+    __disable_irq();
+    cpuload_exit(CPULOAD_TICK, cpuload_enter());
+    CHECK(__get_PRIMASK());
+    __enable_irq();
+}
+
+static uint8_t selftest_run(uint8_t result[SELFTEST_SIZE])
+{
+    uint8_t cmd = SELFTEST_CMD_START;
+    uint8_t status[3];
+    int steps = 0;
+
+    write_reg(REG_SELFTEST_CTRL, &cmd, 1);
+    do
+    {
+        app_step();
+        CHECK(fake_i2c_read_reg(ADDR, REG_SELFTEST_CTRL, status, sizeof(status)));
+        CHECK(++steps <= 2 * NUM_COLS + NUM_ROWS + 2);
+    } while (status[0] == SELFTEST_STATE_RUNNING);
+
+    CHECK_EQ(status[2], SELFTEST_SIZE);
+    for (uint8_t offset = 0; offset < SELFTEST_SIZE; offset += 32)
+    {
+        uint8_t n = SELFTEST_SIZE - offset < 32 ? SELFTEST_SIZE - offset : 32;
+
+        write_reg(REG_SELFTEST_DATA, &offset, 1);
+        CHECK(fake_i2c_read(ADDR, &result[offset], n));
+    }
+
+    CHECK_EQ(result[0], status[0]);
+    CHECK_EQ(result[1], status[1]);
+    return status[0];
+}
+
+static void test_selftest_passes(void)
+{
+    uint8_t result[SELFTEST_SIZE];
+    uint8_t offset = 0;
+
+    CHECK_EQ(selftest_run(result), SELFTEST_STATE_PASS);
+    CHECK_EQ(result[1], 0);
+    CHECK_EQ(result[2], NUM_ROWS);
+    CHECK_EQ(result[3], NUM_COLS);
+    for (int offset = 4; offset < 20; offset += 4)
+        CHECK_EQ(get_u32(&result[offset]), 0);
+    for (int c = 0; c < NUM_COLS; c++)
+        CHECK_EQ(get_u32(&result[32 + 4 * c]), 0);
+
+    // One line per scan iteration, done in well under a second
+    CHECK(get_u32(&result[28]) > 0);
+    CHECK(get_u32(&result[28]) < 100000);
+
+    // Nothing pressed yet, every line is unseen; a key clears its row and column
+    CHECK_EQ(get_u32(&result[20]), BOARD_ROW_ALL);
+    CHECK_EQ(get_u32(&result[24]), (1U << NUM_COLS) - 1);
+
+    // The scan has the matrix back as it was
+    tap(0, 1);
+    CHECK_EQ(read_key(), 'e');
+
+    write_reg(REG_SELFTEST_DATA, &offset, 1);
+    CHECK(fake_i2c_read(ADDR, result, 28));
+    CHECK_EQ(get_u32(&result[20]), BOARD_ROW_ALL & ~(1U << 0));
+    CHECK_EQ(get_u32(&result[24]), ((1U << NUM_COLS) - 1) & ~(1U << 1));
+}
+
+static void test_selftest_finds_wiring_faults(void)
+{
+    GPIO_TypeDef *const col_ports[NUM_COLS] = BOARD_COL_PORTS;
+    const uint16_t col_pins[NUM_COLS] = BOARD_COL_PINS;
+    GPIO_TypeDef *const row_ports[NUM_ROWS] = BOARD_ROW_PORTS;
+    const uint16_t row_pins[NUM_ROWS] = BOARD_ROW_PINS;
+    uint8_t result[SELFTEST_SIZE];
+
+    // Row 0 grounded, rows 3 and 4 shorted, columns 1 and 2 shorted, column 4
+    // grounded, row 6 shorted to column 0 and the key at row 5, column 3 stuck
+    fake_pin_ground(row_ports[0], row_pins[0]);
+    fake_pin_short(row_ports[3], row_pins[3], row_ports[4], row_pins[4]);
+    fake_pin_short(col_ports[1], col_pins[1], col_ports[2], col_pins[2]);
+    fake_pin_ground(col_ports[4], col_pins[4]);
+    fake_pin_short(row_ports[6], row_pins[6], col_ports[0], col_pins[0]);
+    fake_key_set(5, 3, 1);
+
+    CHECK_EQ(selftest_run(result), SELFTEST_STATE_FAIL);
+    CHECK_EQ(result[1], SELFTEST_FAULT_STUCK_ROW | SELFTEST_FAULT_STUCK_COL |
+                        SELFTEST_FAULT_ROW_SHORT | SELFTEST_FAULT_COL_SHORT |
+                        SELFTEST_FAULT_CLOSED);
+    CHECK_EQ(get_u32(&result[4]), 1U << 0);
+    CHECK_EQ(get_u32(&result[8]), 1U << 4);
+    CHECK_EQ(get_u32(&result[12]), (1U << 3) | (1U << 4));
+    CHECK_EQ(get_u32(&result[16]), (1U << 1) | (1U << 2));
+    CHECK_EQ(get_u32(&result[32 + 4 * 0]), 1U << 6);
+    CHECK_EQ(get_u32(&result[32 + 4 * 3]), 1U << 5);
+    CHECK_EQ(get_u32(&result[32 + 4 * 1]), 0);
+
+    // Row 5 was driven low with the stuck key on it, never against a column
+    CHECK_EQ(fake_drive_contentions(), 0);
+}
+
+static jmp_buf reset_jmp;
+
+static void reset_hook(void)
+{
+    longjmp(reset_jmp, 1);
+}
+
+static void reboot(void)
+{
+    // Warm reset: .noinit and the rest of RAM keep their contents
+    fake_reset();
+    app_init();
+}
+
+static uint16_t crash_read(uint8_t *image, uint8_t *cause)
+{
+    uint8_t status[5];
+    uint16_t size;
+
+    CHECK(fake_i2c_read_reg(ADDR, REG_CRASH_CTRL, status, sizeof(status)));
+    size = status[2] | (status[3] << 8);
+    *cause = status[1];
+
+    if (status[0] == CRASHLOG_STATE_EMPTY)
+    {
+        CHECK_EQ(size, 0);
+        return 0;
+    }
+
+    CHECK_EQ(status[0], CRASHLOG_STATE_DUMP);
+    CHECK_EQ(size, CRASHLOG_IMAGE_SIZE);
+    CHECK(status[4] > 0);
+
+    for (uint16_t offset = 0; offset < size; offset += I2C_TX_BUF_SIZE)
+    {
+        uint8_t select[3] = { REG_CRASH_DATA, (uint8_t)offset, (uint8_t)(offset >> 8) };
+        uint8_t len = size - offset < I2C_TX_BUF_SIZE ? size - offset : I2C_TX_BUF_SIZE;
+
+        CHECK(fake_i2c_write(ADDR, select, sizeof(select)));
+        CHECK(fake_i2c_read(ADDR, &image[offset], len));
+    }
+
+    return size;
+}
+
+static void test_crash_dump_after_error(void)
+{
+    static uint8_t image[CRASHLOG_IMAGE_SIZE];
+    uint8_t cmd = CRASHLOG_CMD_CLEAR;
+    uint8_t cause;
+
+    CHECK_EQ(crash_read(image, &cause), 0);
+
+    tap(0, 0);
+
+    if (!setjmp(reset_jmp))
+    {
+        fake_set_reset_hook(reset_hook);
+        crashlog_error(CRASHLOG_CAUSE_I2C_ERROR, 0x08001234U);
+    }
+
+    reboot();
+
+    CHECK_EQ(crash_read(image, &cause), CRASHLOG_IMAGE_SIZE);
+    CHECK_EQ(cause, CRASHLOG_CAUSE_I2C_ERROR);
+    CHECK_EQ(image[0], CRASHLOG_FORMAT_VERSION);
+    CHECK_EQ(image[1], CRASHLOG_CAUSE_I2C_ERROR);
+    CHECK_EQ(image[3], 1);
+    CHECK_EQ(get_u32(&image[4 + 6 * 4]), 0x08001234U);
+
+    // Flight recorder, oldest first, ends with the key that was queued
+    int queued_q = 0;
+
+    CHECK(image[2] > 0 && image[2] <= CRASHLOG_EVENTS);
+    CHECK_EQ(image[CRASHLOG_HEADER_SIZE + 4], CRASHLOG_EV_BOOT);
+    for (int i = 0; i < image[2]; i++)
+    {
+        const uint8_t *e = &image[CRASHLOG_HEADER_SIZE + i * CRASHLOG_EVENT_SIZE];
+
+        if (e[4] == CRASHLOG_EV_KEY_QUEUED && e[5] == 'q')
+            queued_q++;
+    }
+    CHECK_EQ(queued_q, 1);
+
+    // The dump stays until the host clears it
+    CHECK_EQ(crash_read(image, &cause), CRASHLOG_IMAGE_SIZE);
+    write_reg(REG_CRASH_CTRL, &cmd, 1);
+    CHECK_EQ(crash_read(image, &cause), 0);
+
+    // Logging an event keeps a caller's interrupt mask
+    __disable_irq();
+    crashlog_event(CRASHLOG_EV_BOOT, 0, 0);
+    CHECK(__get_PRIMASK());
+    __enable_irq();
+}
+
+static uint8_t crash_count(void)
+{
+    uint8_t status[5];
+
+    CHECK(fake_i2c_read_reg(ADDR, REG_CRASH_CTRL, status, sizeof(status)));
+    return status[4];
+}
+
+static void hang_until_watchdog(void)
+{
+    // The master addresses the slave for a read and never finishes it
+    app_step();
+    CHECK(fake_i2c_start(ADDR, 1));
+
+    if (!setjmp(reset_jmp))
+    {
+        fake_set_reset_hook(reset_hook);
+        for (;;)
+            app_step();
+    }
+}
+
+static void test_crash_dump_of_fault(void)
+{
+    static uint8_t image[CRASHLOG_IMAGE_SIZE];
+    static uint32_t frame[8] = { 1, 2, 3, 4, 12, 0x08000101U, 0x08000200U, 0x01000000U };
+    uint8_t cause;
+
+    if (!setjmp(reset_jmp))
+    {
+        // Precise bus fault at BFAR, taken from thread mode on the main stack
+        fake_set_reset_hook(reset_hook);
+        fake_scb.ICSR = CRASHLOG_CAUSE_BUSFAULT;
+        fake_scb.CFSR = 0x8200U;
+        fake_scb.BFAR = 0x40001000U;
+        crashlog_fault(frame, 0xFFFFFFF9U);
+    }
+
+    reboot();
+
+    CHECK_EQ(crash_read(image, &cause), CRASHLOG_IMAGE_SIZE);
+    CHECK_EQ(cause, CRASHLOG_CAUSE_BUSFAULT);
+    for (int i = 0; i < 8; i++)
+        CHECK_EQ(get_u32(&image[4 + i * 4]), frame[i]);
+    CHECK_EQ(get_u32(&image[36]), (uint32_t)(uintptr_t)frame);
+    CHECK_EQ(get_u32(&image[40]), 0xFFFFFFF9U);
+    CHECK_EQ(get_u32(&image[44]), 0x8200U);
+    CHECK_EQ(get_u32(&image[56]), 0x40001000U);
+
+    // A second crash counts up
+    if (!setjmp(reset_jmp))
+    {
+        fake_set_reset_hook(reset_hook);
+        crashlog_error(CRASHLOG_CAUSE_ERROR, 0);
+    }
+
+    reboot();
+
+    CHECK_EQ(crash_read(image, &cause), CRASHLOG_IMAGE_SIZE);
+    CHECK_EQ(cause, CRASHLOG_CAUSE_ERROR);
+    CHECK_EQ(image[3], 2);
+
+    // A hang before the host read the dump keeps it, and is only counted
+    hang_until_watchdog();
+    reboot();
+
+    CHECK_EQ(crash_read(image, &cause), CRASHLOG_IMAGE_SIZE);
+    CHECK_EQ(cause, CRASHLOG_CAUSE_ERROR);
+    CHECK_EQ(image[3], 2);
+    CHECK_EQ(crash_count(), 3);
+}
+
+static void test_watchdog_recovers_hung_transfer(void)
+{
+    static uint8_t image[CRASHLOG_IMAGE_SIZE];
+    uint8_t boot[2];
+    uint8_t cause;
+    uint64_t hung_at;
+
+    CHECK(fake_i2c_read_reg(ADDR, REG_BOOT_REASON, boot, sizeof(boot)));
+    CHECK_EQ(boot[0], WATCHDOG_BOOT_POWER_ON);
+    CHECK(boot[1] & (RCC_CSR_PORRSTF >> 24));
+
+    // A flash sector erase outlasts the watchdog period
+    fake_flash_erase_all();
+    config_set(CFG_PRESS_AND_HOLD_MS, 600);
+    app_step();
+
+    hung_at = fake_now_us();
+    hang_until_watchdog();
+
+    // Recovery within a few hundred milliseconds, the scan loop kept going
+    CHECK(fake_now_us() - hung_at > (WATCHDOG_MARGIN_MS + WATCHDOG_TIMEOUT_MS) * 1000U);
+    CHECK(fake_now_us() - hung_at < (WATCHDOG_MARGIN_MS + WATCHDOG_TIMEOUT_MS + 50) * 1000U);
+
+    reboot();
+
+    CHECK(fake_i2c_read_reg(ADDR, REG_BOOT_REASON, boot, sizeof(boot)));
+    CHECK_EQ(boot[0], WATCHDOG_BOOT_WATCHDOG);
+    CHECK(boot[1] & (RCC_CSR_IWDGRSTF >> 24));
+
+    // The events before the hang end with the address match of the read
+    CHECK_EQ(crash_read(image, &cause), CRASHLOG_IMAGE_SIZE);
+    CHECK_EQ(cause, CRASHLOG_CAUSE_WATCHDOG);
+    CHECK(image[2] > 0);
+    CHECK_EQ(image[CRASHLOG_HEADER_SIZE + (image[2] - 1) * CRASHLOG_EVENT_SIZE + 4], CRASHLOG_EV_I2C_ADDR);
+
+    // And the slave answers again
+    tap(0, 0);
+    CHECK_EQ(read_key(), 'q');
+}
+
+static void test_watchdog_quiet_while_idle(void)
+{
+    // Long scan interval and an idle bus, nothing is overdue
+    config_set(CFG_SCAN_INTERVAL_MS, 1000);
+    app_step();
+
+    for (int i = 0; i < 5; i++)
+        app_step();
+
+    CHECK(fake_now_us() > 5000000U);
+    CHECK(fake_i2c_listening());
+}
+
+static void col_settle(uint16_t settle_us[NUM_COLS])
+{
+    uint8_t buf[2 * NUM_COLS];
+
+    CHECK(fake_i2c_read_reg(ADDR, REG_COL_SETTLE, buf, sizeof(buf)));
+    for (int c = 0; c < NUM_COLS; c++)
+        settle_us[c] = buf[2 * c] | (buf[2 * c + 1] << 8);
+}
+
+static uint8_t key_state_bit(uint8_t row, uint8_t col)
+{
+    uint8_t state[KEYBOARD_STATE_SIZE];
+    uint8_t bit = row * NUM_COLS + col;
+
+    CHECK(fake_i2c_read_reg(ADDR, REG_KEY_STATE, state, sizeof(state)));
+    return (state[bit >> 3] >> (bit & 7)) & 1;
+}
+
+static void test_settle_calibration(void)
+{
+    uint16_t settle_us[NUM_COLS];
+
+    // Ideal lines settle at once, only the margin is left
+    col_settle(settle_us);
+    for (int c = 0; c < NUM_COLS; c++)
+        CHECK(settle_us[c] >= KEYBOARD_SETTLE_MARGIN_US && settle_us[c] <= KEYBOARD_SETTLE_MARGIN_US + 2);
+
+    // A key held at boot never ties a discharged row to a column driven high
+    fake_reset();
+    fake_key_set(1, 2, 1);
+    app_init();
+    CHECK_EQ(fake_drive_contentions(), 0);
+    col_settle(settle_us);
+    for (int c = 0; c < NUM_COLS; c++)
+        CHECK(settle_us[c] >= KEYBOARD_SETTLE_MARGIN_US && settle_us[c] <= KEYBOARD_SETTLE_MARGIN_US + 2);
+    fake_key_set(1, 2, 0);
+
+    // A slow row sets every column's time at boot
+    fake_row_rise_us(1, 40);
+    reboot();
+    col_settle(settle_us);
+    for (int c = 0; c < NUM_COLS; c++)
+        CHECK(settle_us[c] >= 2 * 40 + KEYBOARD_SETTLE_MARGIN_US && settle_us[c] <= 2 * 42 + KEYBOARD_SETTLE_MARGIN_US);
+
+    // Long enough that the row is back up before the next column is sampled
+    fake_key_set(1, 0, 1);
+    app_step();
+    CHECK(key_state_bit(1, 0));
+    CHECK(!key_state_bit(1, 1));
+
+    // Bounded by the configured time, which is too short for this row
+    CHECK(config_set(CFG_COL_SETTLE_US, 10));
+    app_step();
+    col_settle(settle_us);
+    for (int c = 0; c < NUM_COLS; c++)
+        CHECK_EQ(settle_us[c], 10);
+    CHECK(key_state_bit(1, 1));
+    fake_key_set(1, 0, 0);
+
+    // A row slower than the configured time keeps it
+    CHECK(config_set(CFG_COL_SETTLE_US, KEYBOARD_COL_SETTLE_US));
+    app_step();
+    fake_row_rise_us(1, 2 * KEYBOARD_COL_SETTLE_US);
+    reboot();
+    col_settle(settle_us);
+    for (int c = 0; c < NUM_COLS; c++)
+        CHECK_EQ(settle_us[c], KEYBOARD_COL_SETTLE_US);
+
+    // Calibration off, the configured time for every column
+    fake_row_rise_us(1, 0);
+    reboot();
+    CHECK(config_set(CFG_COL_SETTLE_AUTO, 0));
+    col_settle(settle_us);
+    for (int c = 0; c < NUM_COLS; c++)
+        CHECK_EQ(settle_us[c], KEYBOARD_COL_SETTLE_US);
+}
+
+static void press_q(void)
+{
+    fake_key_set(0, 0, 1);
+}
+
+static void press_e(void)
+{
+    fake_key_set(0, 1, 1);
+}
+
+static uint32_t read_key_stamped(uint8_t *key)
+{
+    uint8_t buf[5];
+
+    CHECK(fake_i2c_read_reg(ADDR, REG_KEY_STAMPED, buf, sizeof(buf)));
+    *key = buf[0];
+    return get_u32(&buf[1]);
+}
+
+static void test_edge_stamps(void)
+{
+    uint64_t press_us;
+    uint64_t scan_us;
+    uint32_t stamp;
+    uint8_t key;
+
+    // Columns idle high, a press is only seen by the next scan
+    press_us = fake_now_us() + 300;
+    fake_set_alarm(press_us, press_q);
+    app_step();
+    scan_us = fake_now_us();
+    app_step();
+    stamp = read_key_stamped(&key);
+    CHECK_EQ(key, 'q');
+    CHECK(stamp >= scan_us);
+
+    fake_key_set(0, 0, 0);
+    CHECK(config_set(CFG_EDGE_STAMP, 1));
+    app_step();
+
+    // Parked columns, the row's edge stamps the press to the microsecond
+    press_us = fake_now_us() + 300;
+    fake_set_alarm(press_us, press_q);
+    app_step();
+    app_step();
+    stamp = read_key_stamped(&key);
+    CHECK_EQ(key, 'q');
+    CHECK(stamp + 1 >= press_us && stamp <= press_us + 1);
+
+    // The held key keeps row 0 low, a second key on it goes by the scan again
+    press_us = fake_now_us() + 300;
+    fake_set_alarm(press_us, press_e);
+    app_step();
+    scan_us = fake_now_us();
+    app_step();
+    stamp = read_key_stamped(&key);
+    CHECK_EQ(key, 'e');
+    CHECK(stamp >= scan_us);
+
+    // Empty queue reads a zero key
+    read_key_stamped(&key);
+    CHECK_EQ(key, 0);
+
+    // Still microseconds since boot once the cycle counter wrapped
+    fake_keys_release_all();
+    while (fake_now_us() < 300000000ULL)
+        app_step();
+    press_us = fake_now_us() + 300;
+    fake_set_alarm(press_us, press_q);
+    app_step();
+    app_step();
+    stamp = read_key_stamped(&key);
+    CHECK_EQ(key, 'q');
+    CHECK(stamp + 1 >= press_us && stamp <= press_us + 1);
+}
+
+static uint64_t scan_cycles(void)
+{
+    uint64_t start = fake_now_cycles();
+
+    keyboard_scan();
+    return fake_now_cycles() - start;
+}
+
+static void test_partial_scan(void)
+{
+    uint64_t full = scan_cycles();
+
+    CHECK(config_set(CFG_PARTIAL_SCAN, 1));
+    app_step();
+
+    // Idle: all columns at once, one settle time instead of one per column
+    CHECK(scan_cycles() * 3 < full);
+
+    // A lone key is found on whichever column of its row
+    for (int c = 0; c < NUM_COLS; c++)
+    {
+        fake_key_set(1, c, 1);
+        keyboard_scan();
+        for (int k = 0; k < NUM_COLS; k++)
+            CHECK_EQ(key_state_bit(1, k), k == c);
+        fake_key_set(1, c, 0);
+    }
+
+    // A second key on the row, or on another row, takes the full scan
+    fake_key_set(1, 0, 1);
+    fake_key_set(1, 3, 1);
+    CHECK(scan_cycles() >= full);
+    CHECK(key_state_bit(1, 0) && key_state_bit(1, 3));
+    fake_key_set(1, 3, 0);
+    fake_key_set(4, 2, 1);
+    CHECK(scan_cycles() >= full);
+    CHECK(key_state_bit(1, 0) && key_state_bit(4, 2));
+    fake_keys_release_all();
+
+    // Parked columns, an idle scan is a read and a key is searched right away
+    CHECK(config_set(CFG_EDGE_STAMP, 1));
+    app_step();
+    app_step();
+    CHECK(scan_cycles() * 10 < full);
+    fake_key_set(1, 4, 1);
+    CHECK(scan_cycles() < full);
+    CHECK(key_state_bit(1, 4));
+
+    // Through the main loop the key is decoded as usual
+    fake_keys_release_all();
+    app_step();
+    tap(0, 0);
+    CHECK_EQ(read_key(), 'q');
+}
+
+typedef struct
+{
+    const char *name;
+    void (*fn)(void);
+} test_case_t;
+
+#define TEST(fn) { #fn, fn }
+
+static const test_case_t tests[] = {
+    TEST(test_key_press_is_queued),
+    TEST(test_key_fifo_keeps_order),
+    TEST(test_modifiers_apply_to_next_key),
+    TEST(test_rollover_sends_each_key_once),
+    TEST(test_irq_is_coalesced),
+    TEST(test_irq_immediate_mode),
+    TEST(test_irq_pulse_does_not_block),
+    TEST(test_interrupt_priorities),
+    TEST(test_key_state_register),
+    TEST(test_sym_debounce_does_not_stall),
+    TEST(test_press_and_hold_is_timed),
+    TEST(test_other_address_is_not_acked),
+    TEST(test_aborted_key_read_is_resent),
+    TEST(test_bus_error_recovers),
+    TEST(test_config_persists),
+    TEST(test_config_rejects_out_of_range),
+    TEST(test_keymap_upload),
+    TEST(test_keymap_bad_crc),
+    TEST(test_keymap_command_while_saving),
+    TEST(test_capture_round_trip),
+    TEST(test_capture_ring_wraps),
+    TEST(test_bench_probes),
+    TEST(test_bench_key_stages),
+    TEST(test_stats_counters),
+    TEST(test_trace_ring),
+    TEST(test_cpu_load),
+    TEST(test_selftest_passes),
+    TEST(test_selftest_finds_wiring_faults),
+    TEST(test_settle_calibration),
+    TEST(test_edge_stamps),
+    TEST(test_partial_scan),
+    TEST(test_crash_dump_after_error),
+    TEST(test_crash_dump_of_fault),
+    TEST(test_watchdog_recovers_hung_transfer),
+    TEST(test_watchdog_quiet_while_idle),
+};
+
+int main(int argc, char **argv)
+{
+    int failed = 0;
+    int run = 0;
+
+    for (size_t i = 0; i < sizeof(tests) / sizeof(tests[0]); i++)
+    {
+        int status;
+        pid_t pid;
+
+        // Optional filter: run only tests whose name contains argv[1]
+        if (argc > 1 && !strstr(tests[i].name, argv[1]))
+            continue;
+
+        run++;
+        fflush(stdout);
+
+        pid = fork();
+        if (pid == 0)
+        {
+            fake_reset();
+            app_init();
+            tests[i].fn();
+            exit(0);
+        }
+
+        waitpid(pid, &status, 0);
+
+        if (WIFEXITED(status) && WEXITSTATUS(status) == 0)
+        {
+            printf("PASS %s\n", tests[i].name);
+        }
+        else
+        {
+            printf("FAIL %s\n", tests[i].name);
+            failed++;
+        }
+    }
+
+    printf("%d/%d passed\n", run - failed, run);
+    return failed ? 1 : 0;
+}
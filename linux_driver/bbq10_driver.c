@@ -30,17 +30,17 @@
 #include <linux/of_gpio.h>
 #include <linux/delay.h>
 #include <linux/input.h>
-#include <linux/workqueue.h>
 
 #define BBQ10_DEBUG 0
 
+/* Upper bound of keys drained per interrupt, matches the controller key queue */
+#define BBQ10_MAX_KEYS_PER_IRQ 16
+
 struct bbq10_data {
     struct i2c_client *client;
     struct gpio_desc *irq_gpio;
     struct input_dev *input;
-    struct work_struct key_work;
     int irq;
-    u8 key_value;
 };
 
 static const unsigned short alphabet[] = {
@@ -139,13 +139,11 @@ static unsigned short bbq10_char_to_keycode(u8 ch, bool *needs_shift)
     }
 }
 
-/* Work handler */
-static void bbq10_key_work_handler(struct work_struct *work)
+/* Emulate press and release of a received character */
+static void bbq10_report_key(struct bbq10_data *data, u8 val)
 {
-    struct bbq10_data *data = container_of(work, struct bbq10_data, key_work);
     unsigned short keycode;
     bool needs_shift;
-    u8 val = data->key_value;
 
 #ifdef BBQ10_DEBUG
     pr_info("bbq10_driver: processing key 0x%02x ('%c')\n", 
@@ -189,17 +187,24 @@ static void bbq10_key_work_handler(struct work_struct *work)
 static irqreturn_t bbq10_irq_handler(int irq, void *dev_id)
 {
     struct bbq10_data *data = dev_id;
+    u8 val;
     int ret;
+    int i;
 
-    /* Perform a 1-byte I2C read from the STM32 */
-    ret = i2c_master_recv(data->client, &data->key_value, 1);
-    if (ret != 1) {
-        pr_err("bbq10_driver: i2c_master_recv failed, ret=%d\n", ret);
-        return IRQ_HANDLED;
-    }
+    /* The controller may coalesce several keys into one interrupt,
+     * read 1 byte at a time until its queue reports empty (0) */
+    for (i = 0; i < BBQ10_MAX_KEYS_PER_IRQ; i++) {
+        ret = i2c_master_recv(data->client, &val, 1);
+        if (ret != 1) {
+            pr_err("bbq10_driver: i2c_master_recv failed, ret=%d\n", ret);
+            break;
+        }
+
+        if (val == 0)
+            break;
 
-    /* Schedule work to process the key */
-    schedule_work(&data->key_work);
+        bbq10_report_key(data, val);
+    }
 
     return IRQ_HANDLED;
 }
@@ -217,9 +222,6 @@ static int bbq10_probe(struct i2c_client *client,
 
     data->client = client;
 
-    /* Initialize work queue */
-    INIT_WORK(&data->key_work, bbq10_key_work_handler);
-
     /* Allocate input device */
     data->input = devm_input_allocate_device(&client->dev);
     if (!data->input) {
@@ -297,10 +299,6 @@ static int bbq10_probe(struct i2c_client *client,
 
 static void bbq10_remove(struct i2c_client *client)
 {
-    struct bbq10_data *data = i2c_get_clientdata(client);
-    
-    cancel_work_sync(&data->key_work);
-    
     dev_info(&client->dev, "bbq10 driver removed\n");
 }
 
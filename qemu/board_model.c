@@ -0,0 +1,339 @@
+/**
+ * Blackberry Q10 keyboard STM32 driver
+ * A fun little weekend project to act as a BBQ10 STM32 driver that is able to communicate with I2C bus masters.
+ * Creates rising-edge IRQ pulse, sends pressed character over I2C when master reads from slave upon receiving interrupt.
+ *
+ * Copyright (C) 2025 Mustafa Ozcelikors
+ *
+ * See GPLv3 LICENSE file in repository for licensing details.
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#include "board_model.h"
+#include "board_gen.h"
+#include "i2c_slave.h"
+
+/* Peripherals QEMU does not model, see qemu_board.h. RCC comes up with the
+ * HSI on and ready, which is all SystemClock_Config() asks for. */
+RCC_TypeDef qemu_rcc = {
+    .CR = RCC_CR_HSION | RCC_CR_HSIRDY | (0x10U << RCC_CR_HSITRIM_Pos),
+    .PLLCFGR = 0x24003010U,
+    .CSR = RCC_CSR_PORRSTF | RCC_CSR_PINRSTF,
+};
+FLASH_TypeDef qemu_flash;
+I2C_TypeDef qemu_i2c1;
+CoreDebug_Type qemu_core_debug;
+IWDG_TypeDef qemu_iwdg;
+DBGMCU_TypeDef qemu_dbgmcu;
+ITM_Type qemu_itm;
+
+static DWT_Type dwt;
+
+/* ---- Cycle counter ---- */
+
+uint32_t qemu_cycles(void)
+{
+    uint32_t tick;
+    uint32_t val;
+
+    do {
+        tick = uwTick;
+        val = SysTick->VAL;
+    } while (tick != uwTick);
+
+    uint32_t load = SysTick->LOAD + 1;
+    uint32_t cycles = tick * load + (load - 1 - val);
+
+    // Wrapped but the SysTick handler has not run yet (masked, or we are in it)
+    if ((SCB->ICSR & SCB_ICSR_PENDSTSET_Msk) && val > load / 2)
+        cycles += load;
+
+    return cycles;
+}
+
+DWT_Type *qemu_dwt(void)
+{
+    dwt.CYCCNT = qemu_cycles();
+    return &dwt;
+}
+
+/* ---- Key matrix ---- */
+
+static GPIO_TypeDef *const col_ports[NUM_COLS] = BOARD_COL_PORTS;
+static const uint16_t col_pins[NUM_COLS] = BOARD_COL_PINS;
+static GPIO_TypeDef *const row_ports[NUM_ROWS] = BOARD_ROW_PORTS;
+static const uint16_t row_pins[NUM_ROWS] = BOARD_ROW_PINS;
+
+#define GPIO_PORT_INDEX(port) (((uint32_t)(port) - GPIOA_BASE) / (GPIOB_BASE - GPIOA_BASE))
+#define GPIO_NUM_PORTS 11
+
+static uint32_t odr[GPIO_NUM_PORTS] = {
+    0xFFFF, 0xFFFF, 0xFFFF, 0xFFFF, 0xFFFF, 0xFFFF,
+    0xFFFF, 0xFFFF, 0xFFFF, 0xFFFF, 0xFFFF,
+};
+static volatile board_row_mask_t pressed[NUM_COLS];
+
+void qemu_key_set(uint8_t row, uint8_t col, uint8_t pressed_now)
+{
+    if (pressed_now)
+        pressed[col] |= (board_row_mask_t)(1U << row);
+    else
+        pressed[col] &= (board_row_mask_t)~(1U << row);
+}
+
+void qemu_gpio_bsrr(const GPIO_TypeDef *port, uint32_t value)
+{
+    uint32_t *out = &odr[GPIO_PORT_INDEX(port)];
+
+    *out = (*out | (value & 0xFFFFU)) & ~(value >> 16);
+}
+
+uint32_t qemu_gpio_read(const GPIO_TypeDef *port)
+{
+    // Rows are pulled up, a pressed key pulls its row to a low column
+    uint32_t idr = odr[GPIO_PORT_INDEX(port)];
+
+    for (uint8_t c = 0; c < NUM_COLS; c++) {
+        if (odr[GPIO_PORT_INDEX(col_ports[c])] & col_pins[c])
+            continue;
+        for (uint8_t r = 0; r < NUM_ROWS; r++)
+            if ((pressed[c] & (1U << r)) && row_ports[r] == port)
+                idr &= ~(uint32_t)row_pins[r];
+    }
+
+    return idr;
+}
+
+/* ---- I2C bus master ---- */
+
+#define DR_EMPTY 0x100U
+
+const char *const qemu_i2c_ev_names[QEMU_I2C_EV_COUNT] = {
+    "addr", "rxne", "txe", "stopf", "af", "berr",
+};
+
+static uint32_t isr_max[QEMU_I2C_EV_COUNT];
+
+static uint8_t addressed;   // our address was ACKed, transfer in progress
+static uint8_t reading;     // master reads from us
+static uint8_t nacked;      // master NACKed a read byte
+static uint8_t tx_loaded;   // slave has a byte in DR for the master
+static uint8_t tx_byte;
+
+static uint8_t it_enabled(uint32_t bits)
+{
+    return (qemu_i2c1.CR2 & bits) == bits;
+}
+
+// Raise one bus event and run its interrupt to completion
+static void i2c_event(uint8_t event, uint32_t sr1, IRQn_Type irq)
+{
+    qemu_i2c1.SR1 = sr1;
+
+    if (NVIC_GetEnableIRQ(irq)) {
+        uint32_t start = qemu_cycles();
+
+        NVIC_SetPendingIRQ(irq);
+        __DSB();
+        __ISB();
+        while (NVIC_GetPendingIRQ(irq));
+
+        uint32_t cycles = qemu_cycles() - start;
+        if (cycles > isr_max[event])
+            isr_max[event] = cycles;
+    }
+
+    qemu_i2c1.SR1 = 0;
+}
+
+static void bus_error(void)
+{
+    addressed = 0;
+    if (it_enabled(I2C_CR2_ITERREN))
+        i2c_event(QEMU_I2C_EV_BERR, I2C_SR1_BERR, I2C1_ER_IRQn);
+    qemu_i2c1.SR2 = 0;
+}
+
+// TXE: the slave loads the byte the master clocks out next
+static void load_tx(void)
+{
+    tx_loaded = 0;
+    if (!it_enabled(I2C_CR2_ITEVTEN | I2C_CR2_ITBUFEN))
+        return;
+
+    qemu_i2c1.DR = DR_EMPTY;
+    i2c_event(QEMU_I2C_EV_TXE, I2C_SR1_TXE, I2C1_EV_IRQn);
+    if (qemu_i2c1.DR != DR_EMPTY) {
+        tx_byte = (uint8_t)qemu_i2c1.DR;
+        tx_loaded = 1;
+    }
+}
+
+uint8_t qemu_i2c_start(uint8_t addr, uint8_t read)
+{
+    // A START in the middle of a read the master never NACKed is misplaced
+    if (addressed && reading && !nacked)
+        bus_error();
+
+    addressed = 0;
+    if (!(qemu_i2c1.CR1 & I2C_CR1_PE) || !(qemu_i2c1.CR1 & I2C_CR1_ACK) ||
+        !it_enabled(I2C_CR2_ITEVTEN) || ((qemu_i2c1.OAR1 >> 1) & 0x7F) != addr)
+        return 0;
+
+    qemu_i2c1.SR2 = I2C_SR2_BUSY | (read ? I2C_SR2_TRA : 0);
+    i2c_event(QEMU_I2C_EV_ADDR, I2C_SR1_ADDR, I2C1_EV_IRQn);
+
+    addressed = 1;
+    reading = read;
+    nacked = 0;
+    if (read)
+        load_tx();
+
+    return 1;
+}
+
+uint8_t qemu_i2c_write_byte(uint8_t byte)
+{
+    if (!addressed || reading)
+        return 0;
+    if (!(qemu_i2c1.CR1 & I2C_CR1_ACK) || !it_enabled(I2C_CR2_ITEVTEN | I2C_CR2_ITBUFEN))
+        return 0;
+
+    qemu_i2c1.DR = byte;
+    i2c_event(QEMU_I2C_EV_RXNE, I2C_SR1_RXNE, I2C1_EV_IRQn);
+    return 1;
+}
+
+uint8_t qemu_i2c_read_byte(uint8_t ack)
+{
+    if (!addressed || !reading || nacked)
+        return 0xFF;
+
+    uint8_t byte = tx_loaded ? tx_byte : 0xFF;
+
+    if (ack) {
+        load_tx();
+    } else {
+        nacked = 1;
+        if (it_enabled(I2C_CR2_ITERREN))
+            i2c_event(QEMU_I2C_EV_AF, I2C_SR1_AF, I2C1_ER_IRQn);
+    }
+
+    return byte;
+}
+
+void qemu_i2c_stop(void)
+{
+    if (!addressed)
+        return;
+
+    // A STOP while the slave still drives a data byte is a bus error
+    if (reading && !nacked) {
+        bus_error();
+        return;
+    }
+
+    addressed = 0;
+    if (it_enabled(I2C_CR2_ITEVTEN))
+        i2c_event(QEMU_I2C_EV_STOPF, I2C_SR1_STOPF, I2C1_EV_IRQn);
+    qemu_i2c1.SR2 = 0;
+}
+
+void qemu_i2c_bus_error(void)
+{
+    bus_error();
+}
+
+uint8_t qemu_i2c_listening(void)
+{
+    return (qemu_i2c1.CR1 & I2C_CR1_PE) && (qemu_i2c1.CR1 & I2C_CR1_ACK) &&
+           it_enabled(I2C_CR2_ITEVTEN);
+}
+
+uint8_t qemu_i2c_write(uint8_t addr, const uint8_t *data, uint8_t len)
+{
+    uint8_t acked = qemu_i2c_start(addr, 0);
+
+    for (uint8_t i = 0; i < len && acked; i++)
+        acked = qemu_i2c_write_byte(data[i]);
+
+    qemu_i2c_stop();
+    return acked;
+}
+
+uint8_t qemu_i2c_read(uint8_t addr, uint8_t *buf, uint8_t len)
+{
+    uint8_t acked = qemu_i2c_start(addr, 1);
+
+    for (uint8_t i = 0; i < len; i++)
+        buf[i] = acked ? qemu_i2c_read_byte(i + 1 < len) : 0xFF;
+
+    qemu_i2c_stop();
+    return acked;
+}
+
+uint8_t qemu_i2c_read_reg(uint8_t addr, uint8_t reg, uint8_t *buf, uint8_t len)
+{
+    // Register select write, repeated start, read
+    uint8_t acked = qemu_i2c_start(addr, 0) && qemu_i2c_write_byte(reg) && qemu_i2c_start(addr, 1);
+
+    for (uint8_t i = 0; i < len; i++)
+        buf[i] = acked ? qemu_i2c_read_byte(i + 1 < len) : 0xFF;
+
+    qemu_i2c_stop();
+    return acked;
+}
+
+uint32_t qemu_i2c_isr_max(uint8_t event)
+{
+    return isr_max[event];
+}
+
+/* ---- Semihosting ---- */
+
+#define SYS_WRITE0 0x04
+#define SYS_EXIT   0x18
+
+#define ADP_STOPPED_APPLICATION_EXIT 0x20026
+#define ADP_STOPPED_RUNTIME_ERROR    0x20023
+
+static uint32_t semihost(uint32_t op, const void *arg)
+{
+    register uint32_t r0 __asm__("r0") = op;
+    register const void *r1 __asm__("r1") = arg;
+
+    __asm__ volatile ("bkpt 0xAB" : "+r"(r0) : "r"(r1) : "memory");
+    return r0;
+}
+
+void qemu_puts(const char *s)
+{
+    semihost(SYS_WRITE0, s);
+}
+
+void qemu_exit(uint8_t failed)
+{
+    semihost(SYS_EXIT, (const void *)(failed ? ADP_STOPPED_RUNTIME_ERROR : ADP_STOPPED_APPLICATION_EXIT));
+    while (1);
+}
+
+/* ---- Tick ---- */
+
+// Replaces the weak HAL version, the scenario runs from SysTick
+void HAL_IncTick(void)
+{
+    uwTick += uwTickFreq;
+    qemu_scenario_tick(uwTick);
+}
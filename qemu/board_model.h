@@ -0,0 +1,72 @@
+/**
+ * Blackberry Q10 keyboard STM32 driver
+ * A fun little weekend project to act as a BBQ10 STM32 driver that is able to communicate with I2C bus masters.
+ * Creates rising-edge IRQ pulse, sends pressed character over I2C when master reads from slave upon receiving interrupt.
+ *
+ * Copyright (C) 2025 Mustafa Ozcelikors
+ *
+ * See GPLv3 LICENSE file in repository for licensing details.
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#ifndef QEMU_BOARD_MODEL_H_
+#define QEMU_BOARD_MODEL_H_
+
+#include <stdint.h>
+
+/* Board model for the QEMU build: key matrix, I2C bus master and
+ * semihosting. Everything runs inside the SysTick handler, bus events raise
+ * the real I2C1 interrupts through the NVIC and return once the ISR is done. */
+
+// Key matrix
+void qemu_key_set(uint8_t row, uint8_t col, uint8_t pressed);
+
+// I2C master, same calls as the host fake (host/Inc/hal_fake.h)
+uint8_t qemu_i2c_start(uint8_t addr, uint8_t read);   // returns 1 if ACKed
+uint8_t qemu_i2c_write_byte(uint8_t byte);            // returns 1 if ACKed
+uint8_t qemu_i2c_read_byte(uint8_t ack);              // ack = 0 on the last byte
+void qemu_i2c_stop(void);
+void qemu_i2c_bus_error(void);
+uint8_t qemu_i2c_listening(void);
+
+uint8_t qemu_i2c_write(uint8_t addr, const uint8_t *data, uint8_t len);
+uint8_t qemu_i2c_read(uint8_t addr, uint8_t *buf, uint8_t len);
+uint8_t qemu_i2c_read_reg(uint8_t addr, uint8_t reg, uint8_t *buf, uint8_t len);
+
+// Longest I2C interrupt seen per bus event, in CYCCNT cycles
+enum {
+    QEMU_I2C_EV_ADDR,
+    QEMU_I2C_EV_RXNE,
+    QEMU_I2C_EV_TXE,
+    QEMU_I2C_EV_STOPF,
+    QEMU_I2C_EV_AF,
+    QEMU_I2C_EV_BERR,
+    QEMU_I2C_EV_COUNT
+};
+
+extern const char *const qemu_i2c_ev_names[QEMU_I2C_EV_COUNT];
+uint32_t qemu_i2c_isr_max(uint8_t event);
+
+// CYCCNT as the firmware sees it
+uint32_t qemu_cycles(void);
+
+// Semihosting console and exit status
+void qemu_puts(const char *s);
+void qemu_exit(uint8_t failed) __attribute__((noreturn));
+
+// Scenario hook, called every tick from SysTick (scenario.c)
+void qemu_scenario_tick(uint32_t tick);
+
+#endif /* QEMU_BOARD_MODEL_H_ */
@@ -0,0 +1,98 @@
+/**
+ * Blackberry Q10 keyboard STM32 driver
+ * A fun little weekend project to act as a BBQ10 STM32 driver that is able to communicate with I2C bus masters.
+ * Creates rising-edge IRQ pulse, sends pressed character over I2C when master reads from slave upon receiving interrupt.
+ *
+ * Copyright (C) 2025 Mustafa Ozcelikors
+ *
+ * See GPLv3 LICENSE file in repository for licensing details.
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#ifndef QEMU_BOARD_H_
+#define QEMU_BOARD_H_
+
+/* Force included (-include) into every C file of the QEMU build, see
+ * qemu/Makefile.
+ *
+ * QEMU's netduinoplus2 machine (STM32F405) has the Cortex-M4 core, NVIC,
+ * SysTick, flash and SRAM we need but no model of the RCC, the flash
+ * interface, the watchdog, DBGMCU, the ITM or the I2C and GPIO blocks. Those
+ * peripherals are redirected to RAM register blocks that board_model.c
+ * drives, so the real HAL code runs unchanged against them. The watchdog
+ * therefore never fires here. */
+
+#include "stm32f4xx.h"
+
+extern RCC_TypeDef qemu_rcc;
+extern FLASH_TypeDef qemu_flash;
+extern I2C_TypeDef qemu_i2c1;
+extern CoreDebug_Type qemu_core_debug;
+extern IWDG_TypeDef qemu_iwdg;
+extern DBGMCU_TypeDef qemu_dbgmcu;
+extern ITM_Type qemu_itm;
+
+DWT_Type *qemu_dwt(void);
+uint32_t qemu_gpio_read(const GPIO_TypeDef *port);
+void qemu_gpio_bsrr(const GPIO_TypeDef *port, uint32_t value);
+
+#undef RCC
+#define RCC (&qemu_rcc)
+
+#undef FLASH
+#define FLASH (&qemu_flash)
+
+#undef I2C1
+#define I2C1 (&qemu_i2c1)
+
+#undef CoreDebug
+#define CoreDebug (&qemu_core_debug)
+
+#undef IWDG
+#define IWDG (&qemu_iwdg)
+
+#undef DBGMCU
+#define DBGMCU (&qemu_dbgmcu)
+
+// Left disabled, as without a debugger
+#undef ITM
+#define ITM (&qemu_itm)
+
+// QEMU has no DWT, CYCCNT is derived from SysTick on every access
+#undef DWT
+#define DWT (qemu_dwt())
+
+/* The status register is a plain RAM word here, make the HAL's flag clears
+ * act like the hardware's (rc_w0 and clear-by-read) instead of storing the
+ * written value */
+#undef __HAL_I2C_CLEAR_FLAG
+#define __HAL_I2C_CLEAR_FLAG(__HANDLE__, __FLAG__) \
+    ((__HANDLE__)->Instance->SR1 &= ~((__FLAG__) & I2C_FLAG_MASK))
+
+#undef __HAL_I2C_CLEAR_ADDRFLAG
+#define __HAL_I2C_CLEAR_ADDRFLAG(__HANDLE__) \
+    ((__HANDLE__)->Instance->SR1 &= ~I2C_SR1_ADDR)
+
+#undef __HAL_I2C_CLEAR_STOPFLAG
+#define __HAL_I2C_CLEAR_STOPFLAG(__HANDLE__) do { \
+    (__HANDLE__)->Instance->SR1 &= ~I2C_SR1_STOPF; \
+    SET_BIT((__HANDLE__)->Instance->CR1, I2C_CR1_PE); \
+} while (0)
+
+// Matrix pins go through the key matrix model
+#define BOARD_PORT_READ(port)        (qemu_gpio_read(port))
+#define BOARD_PORT_BSRR(port, value) (qemu_gpio_bsrr((port), (value)))
+
+#endif /* QEMU_BOARD_H_ */
@@ -0,0 +1,253 @@
+/**
+ * Blackberry Q10 keyboard STM32 driver
+ * A fun little weekend project to act as a BBQ10 STM32 driver that is able to communicate with I2C bus masters.
+ * Creates rising-edge IRQ pulse, sends pressed character over I2C when master reads from slave upon receiving interrupt.
+ *
+ * Copyright (C) 2025 Mustafa Ozcelikors
+ *
+ * See GPLv3 LICENSE file in repository for licensing details.
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+/* Scripted scenario for the QEMU build. Runs from SysTick once the firmware
+ * listens on I2C, one step per entry of the table below, and reports over
+ * semihosting. Exits with a failure status on the first failed step. */
+
+#include "board_model.h"
+#include "bench.h"
+#include "board_gen.h"
+#include "config.h"
+#include "i2c_slave.h"
+#include "irq_prio.h"
+#include "registers.h"
+#include "watchdog.h"
+
+// Longest an I2C event may keep the CPU, one byte time at 100 kHz
+#define ISR_BUDGET_CYCLES (16000000U / 100000U * 9U)
+
+// Give up if the firmware never gets as far as listening on I2C
+#define BOOT_TIMEOUT_TICKS 1000
+
+#define ADDR KEYBOARD_I2C_ADDRESS
+
+extern const uint32_t g_pfnVectors[];
+void SysTick_Handler(void);
+void PendSV_Handler(void);
+void I2C1_EV_IRQHandler(void);
+void I2C1_ER_IRQHandler(void);
+
+static uint32_t data_check = 0x5EED1234U;   // .data copied by the startup code
+static uint32_t bss_check;                  // .bss zeroed by it
+
+static void put_uint(uint32_t value)
+{
+    char buf[11];
+    char *p = &buf[sizeof(buf) - 1];
+
+    *p = '\0';
+    do {
+        *--p = (char)('0' + value % 10);
+        value /= 10;
+    } while (value);
+
+    qemu_puts(p);
+}
+
+/* ---- Steps ---- */
+
+static uint8_t check_startup(void)
+{
+    const uint32_t *vectors = (const uint32_t *)SCB->VTOR;
+
+    return data_check == 0x5EED1234U && bss_check == 0 &&
+           // SystemClock_Config() kept the 16 MHz HSI
+           SystemCoreClock == 16000000U && HAL_RCC_GetHCLKFreq() == 16000000U &&
+           // Vector table as linked, wherever VTOR points
+           vectors[0] == g_pfnVectors[0] &&
+           vectors[16 + PendSV_IRQn] == (uint32_t)&PendSV_Handler &&
+           vectors[16 + SysTick_IRQn] == (uint32_t)&SysTick_Handler &&
+           vectors[16 + I2C1_EV_IRQn] == (uint32_t)&I2C1_EV_IRQHandler &&
+           vectors[16 + I2C1_ER_IRQn] == (uint32_t)&I2C1_ER_IRQHandler &&
+           // I2C above the tick above the deferred decode
+           NVIC_GetPriority(I2C1_EV_IRQn) == IRQ_PRIO_I2C &&
+           NVIC_GetPriority(I2C1_ER_IRQn) == IRQ_PRIO_I2C &&
+           NVIC_GetPriority(SysTick_IRQn) == IRQ_PRIO_TICK &&
+           NVIC_GetPriority(PendSV_IRQn) == IRQ_PRIO_DEFERRED &&
+           // Watchdog set up for the normal period and fed, held while halted
+           qemu_iwdg.RLR == WATCHDOG_TIMEOUT_MS - 1 && qemu_iwdg.KR == 0xAAAAU &&
+           (qemu_dbgmcu.APB1FZ & DBGMCU_APB1_FZ_DBG_IWDG_STOP) &&
+           watchdog_boot_reason() == WATCHDOG_BOOT_POWER_ON;
+}
+
+static uint8_t start_bench(void)
+{
+    uint8_t start[2] = { REG_BENCH_CTRL, BENCH_CMD_START };
+    uint8_t status[4];
+
+    // The read also moves the register selection back to REG_KEY
+    return qemu_i2c_write(ADDR, start, sizeof(start)) &&
+           qemu_i2c_read(ADDR, status, sizeof(status)) &&
+           status[0] == BENCH_STATE_RUNNING;
+}
+
+static uint8_t press_q(void)
+{
+    qemu_key_set(0, 0, 1);
+    return 1;
+}
+
+static uint8_t release_q(void)
+{
+    qemu_key_set(0, 0, 0);
+    return 1;
+}
+
+static uint8_t read_q(void)
+{
+    uint8_t key[2];
+
+    return qemu_i2c_read(ADDR, &key[0], 1) && qemu_i2c_read(ADDR, &key[1], 1) &&
+           key[0] == 'q' && key[1] == 0;
+}
+
+static uint8_t read_config(void)
+{
+    uint8_t select[2] = { REG_CONFIG, CFG_I2C_ADDRESS };
+    uint8_t value[2];
+
+    return qemu_i2c_write(ADDR, select, sizeof(select)) &&
+           qemu_i2c_read_reg(ADDR, REG_CONFIG, value, sizeof(value)) &&
+           (value[0] | (value[1] << 8)) == KEYBOARD_I2C_ADDRESS;
+}
+
+static uint8_t bus_error(void)
+{
+    qemu_i2c_bus_error();
+    return !qemu_i2c_listening();
+}
+
+static uint8_t relistened(void)
+{
+    uint8_t key;
+
+    // The main loop had a few ticks to restart listening
+    return qemu_i2c_read(ADDR, &key, 1) && key == 0;
+}
+
+static uint8_t isr_timing(void)
+{
+    uint8_t ok = 1;
+
+    for (uint8_t ev = 0; ev < QEMU_I2C_EV_COUNT; ev++) {
+        uint32_t cycles = qemu_i2c_isr_max(ev);
+
+        qemu_puts("  isr ");
+        qemu_puts(qemu_i2c_ev_names[ev]);
+        qemu_puts(" max ");
+        put_uint(cycles);
+        qemu_puts(" cycles\n");
+
+        if (cycles > ISR_BUDGET_CYCLES)
+            ok = 0;
+    }
+
+    return ok;
+}
+
+static uint8_t report_bench(void)
+{
+    static const char *const names[BENCH_NUM_PROBES] = {
+        "scan", "find_key", "i2c_addr", "i2c_rx_cplt", "i2c_tx_cplt",
+        "i2c_listen", "i2c_error", "key_to_irq", "isr_entry", "key_scan",
+        "key_decode", "key_queue", "key_irq", "key_read", "key_total",
+    };
+    bench_stats_t stats;
+
+    for (uint8_t probe = 0; probe < BENCH_NUM_PROBES; probe++) {
+        bench_get(probe, &stats);
+
+        qemu_puts("  bench ");
+        qemu_puts(names[probe]);
+        qemu_puts(" n ");
+        put_uint(stats.count);
+        if (stats.count) {
+            qemu_puts(" min ");
+            put_uint(stats.min);
+            qemu_puts(" mean ");
+            put_uint((uint32_t)(stats.total / stats.count));
+            qemu_puts(" max ");
+            put_uint(stats.max);
+        }
+        qemu_puts("\n");
+    }
+
+    bench_get(BENCH_SCAN, &stats);
+    return stats.count > 0;
+}
+
+typedef struct {
+    uint32_t at;                // ticks after the slave first listened
+    const char *name;
+    uint8_t (*run)(void);       // returns 1 on pass
+} step_t;
+
+static const step_t steps[] = {
+    {   0, "startup",           check_startup },
+    {   0, "bench start",       start_bench },
+    {   1, "press q",           press_q },
+    {  30, "release q",         release_q },
+    {  60, "read q",            read_q },
+    {  70, "config register",   read_config },
+    {  80, "bus error",         bus_error },
+    {  90, "relisten",          relistened },
+    { 100, "isr timing",        isr_timing },
+    { 100, "bench report",      report_bench },
+};
+
+#define NUM_STEPS (sizeof(steps) / sizeof(steps[0]))
+
+void qemu_scenario_tick(uint32_t tick)
+{
+    static uint32_t start;
+    static uint8_t started;
+    static uint8_t next;
+
+    if (!started) {
+        if (hi2c1.State == HAL_I2C_STATE_LISTEN) {
+            started = 1;
+            start = tick;
+        } else if (tick > BOOT_TIMEOUT_TICKS) {
+            qemu_puts("FAIL boot: slave never listened\n");
+            qemu_exit(1);
+        }
+        return;
+    }
+
+    while (next < NUM_STEPS && tick - start >= steps[next].at) {
+        const step_t *step = &steps[next++];
+        uint8_t ok = step->run();
+
+        qemu_puts(ok ? "PASS " : "FAIL ");
+        qemu_puts(step->name);
+        qemu_puts("\n");
+        if (!ok)
+            qemu_exit(1);
+    }
+
+    if (next == NUM_STEPS) {
+        qemu_puts("all steps passed\n");
+        qemu_exit(0);
+    }
+}
@@ -0,0 +1,98 @@
+#!/usr/bin/env python3
+#
+# Blackberry Q10 keyboard STM32 driver
+# Cycle benchmark control and read-out over I2C.
+#
+# Copyright (C) 2025 Mustafa Ozcelikors
+#
+# See GPLv3 LICENSE file in repository for licensing details.
+#
+# Usage: bench_read.py [-b bus] [-a address] start|stop|clear
+#        bench_read.py [-b bus] [-a address] [--hist] read
+#
+# "start" clears every probe and starts measuring, "read" prints cycle counts
+# per probe (see Core/Inc/bench.h). Uses i2ctransfer from i2c-tools, so
+# unbind the kernel driver first or run it on a bus the driver is not using.
+
+import argparse
+import subprocess
+import struct
+
+REG_BENCH_CTRL = 0x40
+REG_BENCH_DATA = 0x41
+REG_BENCH_HIST = 0x42
+
+COMMANDS = {'stop': 0x00, 'start': 0x01, 'clear': 0x02}
+
+# Probe numbers, in the order of Core/Inc/bench.h
+PROBES = [
+    'scan',
+    'find_key',
+    'i2c_addr',
+    'i2c_rx_cplt',
+    'i2c_tx_cplt',
+    'i2c_listen',
+    'i2c_error',
+    'key_to_irq',
+    'isr_entry',
+    'key_scan',
+    'key_decode',
+    'key_queue',
+    'key_irq',
+    'key_read',
+    'key_total',
+]
+
+CPU_HZ = 16000000
+
+
+def transfer(bus, addr, write, read=0):
+    cmd = ['i2ctransfer', '-y', str(bus), 'w%d@0x%02x' % (len(write), addr)]
+    cmd += ['0x%02x' % b for b in write]
+    if read:
+        cmd.append('r%d@0x%02x' % (read, addr))
+    out = subprocess.run(cmd, check=True, capture_output=True, text=True).stdout
+    return bytes(int(tok, 16) for tok in out.split())
+
+
+def bucket_label(i, shift):
+    if i == 0:
+        return '<%d' % (1 << shift)
+    return '%d+' % (1 << (i + shift - 1))
+
+
+def main():
+    parser = argparse.ArgumentParser()
+    parser.add_argument('-b', '--bus', type=int, default=1)
+    parser.add_argument('-a', '--address', type=lambda s: int(s, 0), default=0x52)
+    parser.add_argument('--hist', action='store_true', help='print the histograms too')
+    parser.add_argument('action', choices=sorted(COMMANDS) + ['read'])
+    args = parser.parse_args()
+
+    if args.action in COMMANDS:
+        transfer(args.bus, args.address, [REG_BENCH_CTRL, COMMANDS[args.action]])
+        return
+
+    state, probes, buckets, shift = transfer(args.bus, args.address, [REG_BENCH_CTRL], 4)
+    print('%s, cycles at %d MHz' % ('running' if state else 'stopped', CPU_HZ // 1000000))
+    print('%-12s %8s %10s %10s %10s' % ('probe', 'count', 'min', 'mean', 'max'))
+
+    for probe in range(probes):
+        name = PROBES[probe] if probe < len(PROBES) else 'probe%d' % probe
+        count, lo, hi, mean = struct.unpack('<4I', transfer(args.bus, args.address,
+                                                            [REG_BENCH_DATA, probe], 16))
+        if not count:
+            print('%-12s %8d' % (name, 0))
+            continue
+        print('%-12s %8d %10d %10d %10d' % (name, count, lo, mean, hi))
+
+        if args.hist:
+            hist = struct.unpack('<%dH' % buckets, transfer(args.bus, args.address,
+                                                           [REG_BENCH_HIST, probe], 2 * buckets))
+            for i, n in enumerate(hist):
+                if n:
+                    print('%14s %-8s %d' % ('', bucket_label(i, shift), n))
+
+
+if __name__ == '__main__':
+    main()
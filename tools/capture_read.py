@@ -0,0 +1,86 @@
+#!/usr/bin/env python3
+#
+# Blackberry Q10 keyboard STM32 driver
+# Matrix capture control and read-out over I2C.
+#
+# Copyright (C) 2025 Mustafa Ozcelikors
+#
+# See GPLv3 LICENSE file in repository for licensing details.
+#
+# Usage: capture_read.py [-b bus] [-a address] start
+#        capture_read.py [-b bus] [-a address] read <capture.bin>
+#
+# "start" clears the ring and starts recording raw matrix frames. "read" stops
+# recording and saves the capture image, which host/build/replay_capture
+# replays against the current firmware. Uses i2ctransfer from i2c-tools, so
+# unbind the kernel driver first or run it on a bus the driver is not using.
+
+import argparse
+import subprocess
+import sys
+import time
+
+REG_CAPTURE_CTRL = 0x30
+REG_CAPTURE_DATA = 0x31
+
+CAPTURE_CMD_STOP = 0x00
+CAPTURE_CMD_START = 0x01
+CAPTURE_STATE_STOPPED = 0x00
+CAPTURE_FLAG_WRAPPED = 0x01
+
+CHUNK = 32  # I2C_TX_BUF_SIZE
+
+
+def transfer(bus, addr, write, read=0):
+    cmd = ['i2ctransfer', '-y', str(bus), 'w%d@0x%02x' % (len(write), addr)]
+    cmd += ['0x%02x' % b for b in write]
+    if read:
+        cmd.append('r%d@0x%02x' % (read, addr))
+    out = subprocess.run(cmd, check=True, capture_output=True, text=True).stdout
+    return [int(tok, 16) for tok in out.split()]
+
+
+def status(bus, addr):
+    state, flags, lo, hi = transfer(bus, addr, [REG_CAPTURE_CTRL], 4)
+    return state, flags, lo | (hi << 8)
+
+
+def main():
+    parser = argparse.ArgumentParser()
+    parser.add_argument('-b', '--bus', type=int, default=1)
+    parser.add_argument('-a', '--address', type=lambda s: int(s, 0), default=0x52)
+    parser.add_argument('action', choices=['start', 'read'])
+    parser.add_argument('output', nargs='?')
+    args = parser.parse_args()
+
+    if args.action == 'start':
+        transfer(args.bus, args.address, [REG_CAPTURE_CTRL, CAPTURE_CMD_START])
+        return
+
+    if not args.output:
+        sys.exit('read needs an output file')
+
+    # Stop is applied by the firmware at its next scan
+    transfer(args.bus, args.address, [REG_CAPTURE_CTRL, CAPTURE_CMD_STOP])
+    for _ in range(100):
+        state, flags, size = status(args.bus, args.address)
+        if state == CAPTURE_STATE_STOPPED:
+            break
+        time.sleep(0.01)
+    else:
+        sys.exit('capture did not stop')
+
+    image = bytearray()
+    for offset in range(0, size, CHUNK):
+        length = min(CHUNK, size - offset)
+        image += bytes(transfer(args.bus, args.address,
+                                [REG_CAPTURE_DATA, offset & 0xFF, offset >> 8], length))
+
+    with open(args.output, 'wb') as f:
+        f.write(image)
+
+    print('%d bytes%s' % (size, ', oldest frames were overwritten' if flags & CAPTURE_FLAG_WRAPPED else ''))
+
+
+if __name__ == '__main__':
+    main()
@@ -0,0 +1,59 @@
+#!/usr/bin/env python3
+#
+# Blackberry Q10 keyboard STM32 driver
+# CPU load read-out over I2C.
+#
+# Copyright (C) 2025 Mustafa Ozcelikors
+#
+# See GPLv3 LICENSE file in repository for licensing details.
+#
+# Usage: cpuload_read.py [-b bus] [-a address] [-i seconds]
+#
+# Prints where the CPU time of the last one second window went (see
+# Core/Inc/cpuload.h), once, or every few seconds with -i. Uses i2ctransfer
+# from i2c-tools, so unbind the kernel driver first or run it on a bus the
+# driver is not using.
+
+import argparse
+import struct
+import subprocess
+import time
+
+REG_CPU_LOAD = 0x90
+
+FIELDS = ['busy', 'main', 'deferred', 'i2c', 'systick', 'edge', 'idle', 'peak']
+
+
+def transfer(bus, addr, write, read=0):
+    cmd = ['i2ctransfer', '-y', str(bus), 'w%d@0x%02x' % (len(write), addr)]
+    cmd += ['0x%02x' % b for b in write]
+    if read:
+        cmd.append('r%d@0x%02x' % (read, addr))
+    out = subprocess.run(cmd, check=True, capture_output=True, text=True).stdout
+    return bytes(int(tok, 16) for tok in out.split())
+
+
+def show(bus, addr):
+    window, *shares = struct.unpack('<9H', transfer(bus, addr, [REG_CPU_LOAD], 18))
+    if not window:
+        print('no window closed yet')
+        return
+    print('%d ms: ' % window + '  '.join('%s %.2f%%' % (name, share / 100.0)
+                                         for name, share in zip(FIELDS, shares)))
+
+
+def main():
+    parser = argparse.ArgumentParser()
+    parser.add_argument('-b', '--bus', type=int, default=1)
+    parser.add_argument('-a', '--address', type=lambda s: int(s, 0), default=0x52)
+    parser.add_argument('-i', '--interval', type=float, help='repeat every so many seconds')
+    args = parser.parse_args()
+
+    show(args.bus, args.address)
+    while args.interval:
+        time.sleep(args.interval)
+        show(args.bus, args.address)
+
+
+if __name__ == '__main__':
+    main()
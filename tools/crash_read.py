@@ -0,0 +1,129 @@
+#!/usr/bin/env python3
+#
+# Blackberry Q10 keyboard STM32 driver
+# Crash dump read-out over I2C.
+#
+# Copyright (C) 2025 Mustafa Ozcelikors
+#
+# See GPLv3 LICENSE file in repository for licensing details.
+#
+# Usage: crash_read.py [-b bus] [-a address] [--clear] [-o dump.bin]
+#
+# Prints the crash dump the firmware kept across its last reset (see
+# Core/Inc/crashlog.h): the cause, the registers at the crash and the flight
+# recorder events leading up to it. --clear forgets the dump afterwards.
+# Uses i2ctransfer from i2c-tools, so unbind the kernel driver first or run it
+# on a bus the driver is not using.
+
+import argparse
+import subprocess
+import struct
+
+REG_CRASH_CTRL = 0x50
+REG_CRASH_DATA = 0x51
+
+CMD_CLEAR = 0x02
+CHUNK = 32
+HEADER_SIZE = 68
+EVENT_SIZE = 8
+
+CAUSES = {
+    0x00: 'none',
+    0x02: 'NMI',
+    0x03: 'HardFault',
+    0x04: 'MemManage',
+    0x05: 'BusFault',
+    0x06: 'UsageFault',
+    0x80: 'Error_Handler',
+    0x81: 'I2C_Error_Handler',
+    0x82: 'watchdog',
+}
+
+EVENTS = {
+    0x01: 'boot',
+    0x02: 'key_queued',
+    0x03: 'key_dropped',
+    0x04: 'irq_pulse',
+    0x05: 'i2c_addr',
+    0x06: 'i2c_write',
+    0x07: 'key_delivered',
+    0x08: 'i2c_error',
+    0x09: 'i2c_restart',
+    0x0A: 'config_save',
+    0x0B: 'keymap_save',
+    0x0C: 'watchdog',
+}
+
+CAUSE_WATCHDOG = 0x82
+
+FRAME = ['r0', 'r1', 'r2', 'r3', 'r12', 'lr', 'pc', 'xpsr']
+
+CPU_HZ = 16000000
+
+
+def transfer(bus, addr, write, read=0):
+    cmd = ['i2ctransfer', '-y', str(bus), 'w%d@0x%02x' % (len(write), addr)]
+    cmd += ['0x%02x' % b for b in write]
+    if read:
+        cmd.append('r%d@0x%02x' % (read, addr))
+    out = subprocess.run(cmd, check=True, capture_output=True, text=True).stdout
+    return bytes(int(tok, 16) for tok in out.split())
+
+
+def read_image(bus, addr, size):
+    image = b''
+    while len(image) < size:
+        n = min(CHUNK, size - len(image))
+        image += transfer(bus, addr, [REG_CRASH_DATA, len(image) & 0xFF, len(image) >> 8], n)
+    return image
+
+
+def print_dump(image):
+    version, cause, events, crashes = image[0:4]
+    words = struct.unpack_from('<16I', image, 4)
+    frame, (sp, exc_return, cfsr, hfsr, mmfar, bfar, cycles, tick) = words[:8], words[8:]
+
+    print('version %d, cause %s, crash %d since power-on, tick %d ms' %
+          (version, CAUSES.get(cause, '0x%02x' % cause), crashes, tick))
+
+    if cause < 0x80:
+        print('  ' + '  '.join('%s=%08x' % (n, v) for n, v in zip(FRAME[:4], frame[:4])))
+        print('  ' + '  '.join('%s=%08x' % (n, v) for n, v in zip(FRAME[4:], frame[4:])))
+        print('  sp=%08x  exc_return=%08x' % (sp, exc_return))
+    elif cause != CAUSE_WATCHDOG:
+        print('  called from %08x' % frame[6])
+    print('  CFSR=%08x  HFSR=%08x  MMFAR=%08x  BFAR=%08x' % (cfsr, hfsr, mmfar, bfar))
+
+    print('events, oldest first, us before the crash:')
+    for i in range(events):
+        t, kind, arg, data = struct.unpack_from('<IBBH', image, HEADER_SIZE + i * EVENT_SIZE)
+        before = ((cycles - t) & 0xFFFFFFFF) * 1000000 // CPU_HZ
+        print('  %10d  %-14s arg 0x%02x  data %d' % (before, EVENTS.get(kind, '0x%02x' % kind), arg, data))
+
+
+def main():
+    parser = argparse.ArgumentParser()
+    parser.add_argument('-b', '--bus', type=int, default=1)
+    parser.add_argument('-a', '--address', type=lambda s: int(s, 0), default=0x52)
+    parser.add_argument('-o', '--output', help='also write the raw dump to this file')
+    parser.add_argument('--clear', action='store_true', help='forget the dump once read')
+    args = parser.parse_args()
+
+    state, cause, lo, hi, crashes = transfer(args.bus, args.address, [REG_CRASH_CTRL], 5)
+    if not state:
+        print('no crash dump, %d crashes since power-on' % crashes)
+        return
+
+    image = read_image(args.bus, args.address, lo | (hi << 8))
+    print_dump(image)
+
+    if args.output:
+        with open(args.output, 'wb') as f:
+            f.write(image)
+
+    if args.clear:
+        transfer(args.bus, args.address, [REG_CRASH_CTRL, CMD_CLEAR])
+
+
+if __name__ == '__main__':
+    main()
@@ -0,0 +1,107 @@
+#!/usr/bin/env python3
+#
+# Blackberry Q10 keyboard STM32 driver
+# Side by side size and cycle report of two firmware builds.
+#
+# Copyright (C) 2025 Mustafa Ozcelikors
+#
+# See GPLv3 LICENSE file in repository for licensing details.
+#
+# Usage: fw_report.py [--nm tool] [--top n] <a.elf> <b.elf> [--bench <a.log> <b.log>]
+#
+# Prints the section totals and the largest functions of both images, and
+# with --bench the DWT benchmark figures the QEMU scenario printed for each
+# (make compare runs all of it for the Debug and Release builds).
+
+import argparse
+import os
+import re
+import subprocess
+
+# Clones GCC makes of a function, reported under the original name
+CLONE_SUFFIX = re.compile(r'\.(constprop|isra|part|lto_priv|cold)\.\d+')
+
+BENCH_LINE = re.compile(r'^\s*bench (\S+) n (\d+)(?: min (\d+) mean (\d+) max (\d+))?')
+
+
+def run(cmd):
+    return subprocess.run(cmd, check=True, capture_output=True, text=True).stdout
+
+
+def sections(size_tool, elf):
+    # Berkeley format: text data bss dec hex filename
+    fields = run([size_tool, elf]).splitlines()[1].split()
+    return int(fields[0]), int(fields[1]), int(fields[2])
+
+
+def functions(nm_tool, elf):
+    sizes = {}
+    for line in run([nm_tool, '--print-size', '--radix=d', elf]).splitlines():
+        fields = line.split()
+        if len(fields) != 4 or fields[2] not in 'tTwW':
+            continue
+        name = CLONE_SUFFIX.sub('', fields[3])
+        sizes[name] = sizes.get(name, 0) + int(fields[1])
+    return sizes
+
+
+def bench(path):
+    probes = {}
+    try:
+        with open(path) as f:
+            for line in f:
+                m = BENCH_LINE.match(line)
+                if m:
+                    probes[m.group(1)] = m.groups()[1:]
+    except OSError:
+        pass
+    return probes
+
+
+def label(path):
+    return os.path.basename(os.path.dirname(os.path.abspath(path))) or path
+
+
+def main():
+    parser = argparse.ArgumentParser()
+    parser.add_argument('--nm', default='arm-none-eabi-nm')
+    parser.add_argument('--top', type=int, default=25)
+    parser.add_argument('elf', nargs=2)
+    parser.add_argument('--bench', nargs=2, metavar='LOG')
+    args = parser.parse_args()
+
+    size_tool = re.sub(r'nm$', 'size', args.nm)
+    names = [label(e) for e in args.elf]
+
+    print('%-28s %12s %12s' % ('section', names[0], names[1]))
+    totals = [sections(size_tool, e) for e in args.elf]
+    for i, section in enumerate(('text', 'data', 'bss')):
+        print('%-28s %12d %12d' % (section, totals[0][i], totals[1][i]))
+
+    # Functions missing from an image were inlined everywhere or removed
+    a, b = (functions(args.nm, e) for e in args.elf)
+    print()
+    print('%-28s %12s %12s' % ('function (bytes)', names[0], names[1]))
+    for name in sorted(set(a) | set(b), key=lambda n: -max(a.get(n, 0), b.get(n, 0)))[:args.top]:
+        print('%-28s %12s %12s' % (name[:28], a.get(name, '-'), b.get(name, '-')))
+
+    if not args.bench:
+        return
+
+    runs = [bench(log) for log in args.bench]
+    if not any(runs):
+        print('\nno benchmark figures, is qemu-system-arm installed?')
+        return
+
+    print()
+    print('%-14s %25s %25s' % ('probe (cycles)', names[0] + ' mean/max', names[1] + ' mean/max'))
+    for probe in sorted(set(runs[0]) | set(runs[1]), key=lambda p: list(runs[0]).index(p) if p in runs[0] else 99):
+        cells = []
+        for r in runs:
+            n, lo, mean, hi = r.get(probe, ('0', None, None, None))
+            cells.append('%s/%s (n %s)' % (mean, hi, n) if mean else '-')
+        print('%-14s %25s %25s' % (probe, cells[0], cells[1]))
+
+
+if __name__ == '__main__':
+    main()
@@ -0,0 +1,288 @@
+#!/usr/bin/env python3
+#
+# Blackberry Q10 keyboard STM32 driver
+# Board description to C header generator.
+#
+# Copyright (C) 2025 Mustafa Ozcelikors
+#
+# See GPLv3 LICENSE file in repository for licensing details.
+#
+# Usage: gen_board.py <board description> <output header>
+#
+# Reads the matrix pin assignment and default keymap of a board (see
+# board/bbq10.txt) and writes a header with the matrix size, the default
+# keymap and a scan routine unrolled for that exact pinout: one BSRR write
+# per column transition and one IDR read per row port, no pin tables.
+
+import os
+import re
+import sys
+
+SPECIAL = {
+    'NONE':   'S_UNUSED',
+    'SPACE':  "' '",
+    'ENTER':  'S_ENTER',
+    'BACK':   'S_BACK',
+    'HASH':   "'#'",
+    'ALT':    'S_ALT',
+    'SYM':    'S_SYM',
+    'LSHIFT': 'S_LSHIFT',
+    'RSHIFT': 'S_RSHIFT',
+}
+
+MODIFIERS = ['ALT', 'RSHIFT', 'LSHIFT', 'SYM']
+
+
+def fail(path, lineno, msg):
+    sys.exit('%s:%d: %s' % (path, lineno, msg))
+
+
+def parse_pin(path, lineno, text):
+    m = re.fullmatch(r'P([A-K])(\d{1,2})', text)
+    if not m or int(m.group(2)) > 15:
+        fail(path, lineno, 'bad pin "%s", expected e.g. PA0' % text)
+    return ('GPIO' + m.group(1), int(m.group(2)))
+
+
+def c_char(path, lineno, token):
+    if token in SPECIAL:
+        return SPECIAL[token]
+    if len(token) != 1 or token == '#':
+        fail(path, lineno, 'bad key "%s"' % token)
+    if token in ('\\', "'"):
+        return "'\\%s'" % token
+    return "'%s'" % token
+
+
+def parse(path):
+    board = {'cols': None, 'rows': None, 'primary': [], 'alt': []}
+    section = None
+
+    with open(path) as f:
+        for lineno, line in enumerate(f, 1):
+            text = line.strip()
+            if not text:
+                continue
+
+            if section is None and text.startswith('#'):
+                continue
+
+            m = re.fullmatch(r'\[(\w+)\]', text)
+            if m:
+                section = m.group(1)
+                if section not in ('primary', 'alt'):
+                    fail(path, lineno, 'unknown section [%s]' % section)
+                continue
+
+            if section is None:
+                key, sep, value = text.partition('=')
+                key = key.strip()
+                if not sep or key not in ('cols', 'rows'):
+                    fail(path, lineno, 'expected "cols = ..." or "rows = ..."')
+                board[key] = [parse_pin(path, lineno, p) for p in value.split()]
+                continue
+
+            board[section].append((lineno, text.split()))
+
+    if not board['cols'] or not board['rows']:
+        sys.exit('%s: cols and rows must both be given' % path)
+
+    pins = board['cols'] + board['rows']
+    if len(set(pins)) != len(pins):
+        sys.exit('%s: a pin is used twice' % path)
+
+    num_cols = len(board['cols'])
+    num_rows = len(board['rows'])
+    if num_rows > 32:
+        sys.exit('%s: at most 32 rows are supported' % path)
+
+    for layer in ('primary', 'alt'):
+        if len(board[layer]) != num_rows:
+            sys.exit('%s: [%s] needs %d rows' % (path, layer, num_rows))
+        for lineno, tokens in board[layer]:
+            if len(tokens) != num_cols:
+                fail(path, lineno, 'expected %d keys' % num_cols)
+
+    positions = {}
+    for r, (lineno, tokens) in enumerate(board['primary']):
+        for c, token in enumerate(tokens):
+            if token in MODIFIERS:
+                if token in positions:
+                    fail(path, lineno, '%s appears twice' % token)
+                positions[token] = (r, c)
+
+    for mod in MODIFIERS:
+        if mod not in positions:
+            sys.exit('%s: [primary] has no %s key' % (path, mod))
+
+    board['positions'] = positions
+    return board
+
+
+def ports_of(pins):
+    ports = []
+    for port, _ in pins:
+        if port not in ports:
+            ports.append(port)
+    return sorted(ports)
+
+
+def bsrr_writes(release, select):
+    # Merge releasing one column and selecting the next into one write per port
+    writes = {}
+    if release is not None:
+        port, pin = release
+        writes[port] = writes.get(port, 0) | (1 << pin)
+    if select is not None:
+        port, pin = select
+        writes[port] = writes.get(port, 0) | (1 << (pin + 16))
+    return sorted(writes.items())
+
+
+def edge_rows(rows):
+    mask = 0
+    lines = set()
+    for r, (_, pin) in enumerate(rows):
+        if pin not in lines:
+            lines.add(pin)
+            mask |= 1 << r
+    return mask
+
+
+def row_mask_type(num_rows):
+    if num_rows <= 8:
+        return 'uint8_t'
+    if num_rows <= 16:
+        return 'uint16_t'
+    return 'uint32_t'
+
+
+def generate(board, source):
+    cols = board['cols']
+    rows = board['rows']
+    num_cols = len(cols)
+    num_rows = len(rows)
+    out = []
+    w = out.append
+
+    w('/* Generated by tools/gen_board.py from %s, do not edit */' % source)
+    w('')
+    w('#ifndef INC_BOARD_GEN_H_')
+    w('#define INC_BOARD_GEN_H_')
+    w('')
+    w('#include "board_io.h"')
+    w('#include "timebase.h"')
+    w('')
+    w('/* Matrix size */')
+    w('#define NUM_COLS %d' % num_cols)
+    w('#define NUM_ROWS %d' % num_rows)
+    w('')
+    w('/* One bit per row, bit set = key pressed */')
+    w('typedef %s board_row_mask_t;' % row_mask_type(num_rows))
+    w('#define BOARD_ROW_ALL 0x%XU' % ((1 << num_rows) - 1))
+    w('')
+    w('/* Modifier key positions */')
+    for mod in MODIFIERS:
+        r, c = board['positions'][mod]
+        w('#define ROW_%-7s %d' % (mod, r))
+        w('#define COL_%-7s %d' % (mod, c))
+    w('')
+    w('/* Pin tables, only used for GPIO setup and diagnostics */')
+    w('#define BOARD_COL_PORTS { %s }' % ', '.join(p for p, _ in cols))
+    w('#define BOARD_COL_PINS  { %s }' % ', '.join('GPIO_PIN_%d' % n for _, n in cols))
+    w('#define BOARD_ROW_PORTS { %s }' % ', '.join(p for p, _ in rows))
+    w('#define BOARD_ROW_PINS  { %s }' % ', '.join('GPIO_PIN_%d' % n for _, n in rows))
+    w('')
+    w('/* Rows with an EXTI line of their own, the line is the pin number so of')
+    w(' * rows on the same pin number of different ports only the first has one */')
+    w('#define BOARD_EDGE_ROWS 0x%XU' % edge_rows(rows))
+    w('')
+    w('#define BOARD_GPIO_CLK_ENABLE() do { \\')
+    for port in ports_of(cols + rows):
+        w('    __HAL_RCC_%s_CLK_ENABLE(); \\' % port)
+    w('} while (0)')
+    w('')
+    w('/* Default keymap */')
+    for layer, name in (('primary', 'BOARD_KEYMAP_PRIMARY'), ('alt', 'BOARD_KEYMAP_ALT')):
+        w('#define %s { \\' % name)
+        for i, (lineno, tokens) in enumerate(board[layer]):
+            chars = [c_char(source, lineno, t) for t in tokens]
+            chars = ''.join('%-10s' % (c + ',') for c in chars[:-1]) + '%-9s' % chars[-1]
+            w('    { %s }%s \\' % (chars, ',' if i < num_rows - 1 else ''))
+        w('}')
+        w('')
+
+    w('/* Sample all rows, one IDR read per port, rows are active low */')
+    w('static inline board_row_mask_t board_read_rows(void)')
+    w('{')
+    row_ports = ports_of(rows)
+    for port in row_ports:
+        w('    uint32_t %s = BOARD_PORT_READ(%s);' % (port.lower(), port))
+    w('    uint32_t idle = 0;')
+    w('')
+    for r, (port, pin) in enumerate(rows):
+        if pin == r:
+            w('    idle |= (%s & (1U << %d));' % (port.lower(), pin))
+        elif pin > r:
+            w('    idle |= (%s >> %d) & (1U << %d);' % (port.lower(), pin - r, r))
+        else:
+            w('    idle |= (%s << %d) & (1U << %d);' % (port.lower(), r - pin, r))
+    w('')
+    w('    return (board_row_mask_t)(~idle & BOARD_ROW_ALL);')
+    w('}')
+    w('')
+    w('/* Drive every column high (idle) */')
+    w('static inline void board_release_cols(void)')
+    w('{')
+    for port in ports_of(cols):
+        mask = sum(1 << pin for p, pin in cols if p == port)
+        w('    BOARD_PORT_BSRR(%s, 0x%04XU);' % (port, mask))
+    w('}')
+    w('')
+    w('/* Drive every column low (parked), a pressed key then pulls its row low */')
+    w('static inline void board_park_cols(void)')
+    w('{')
+    for port in ports_of(cols):
+        mask = sum(1 << pin for p, pin in cols if p == port)
+        w('    BOARD_PORT_BSRR(%s, 0x%08XU);' % (port, mask << 16))
+    w('}')
+    w('')
+    w('/* Scan the whole matrix, unrolled for this pinout, settle time per column */')
+    w('static inline void board_scan(board_row_mask_t rows[NUM_COLS], const uint16_t settle_us[NUM_COLS])')
+    w('{')
+    for c in range(num_cols):
+        for port, value in bsrr_writes(cols[c - 1] if c > 0 else None, cols[c]):
+            w('    BOARD_PORT_BSRR(%s, 0x%08XU);' % (port, value))
+        w('    timebase_delay_us(settle_us[%d]);' % c)
+        w('    rows[%d] = board_read_rows();' % c)
+        w('')
+    for port, value in bsrr_writes(cols[-1], None):
+        w('    BOARD_PORT_BSRR(%s, 0x%08XU);' % (port, value))
+    w('}')
+    w('')
+    w('#endif /* INC_BOARD_GEN_H_ */')
+    return '\n'.join(out) + '\n'
+
+
+def main():
+    if len(sys.argv) != 3:
+        sys.exit('usage: gen_board.py <board description> <output header>')
+
+    source, output = sys.argv[1], sys.argv[2]
+    root = os.path.join(os.path.dirname(os.path.abspath(__file__)), '..')
+    name = os.path.relpath(os.path.abspath(source), root).replace(os.sep, '/')
+    text = generate(parse(source), name)
+
+    try:
+        with open(output) as f:
+            if f.read() == text:
+                return
+    except OSError:
+        pass
+
+    with open(output, 'w') as f:
+        f.write(text)
+
+
+if __name__ == '__main__':
+    main()
@@ -0,0 +1,98 @@
+#!/usr/bin/env python3
+#
+# Blackberry Q10 keyboard STM32 driver
+# Matrix self-test over I2C, for production and wiring diagnostics.
+#
+# Copyright (C) 2025 Mustafa Ozcelikors
+#
+# See GPLv3 LICENSE file in repository for licensing details.
+#
+# Usage: selftest_read.py [-b bus] [-a address] [--read]
+#
+# Starts the matrix self-test (see Core/Inc/selftest.h) with nothing pressed,
+# waits for it and prints the faults found. --read only prints the result of
+# the last test, including the rows and columns no key has been seen on
+# since, so press every key once after the test to find open lines. Exits
+# with 1 when the test failed. Uses i2ctransfer from i2c-tools, so unbind the
+# kernel driver first or run it on a bus the driver is not using.
+
+import argparse
+import struct
+import subprocess
+import sys
+import time
+
+REG_SELFTEST_CTRL = 0xA0
+REG_SELFTEST_DATA = 0xA1
+
+CMD_START = 0x01
+
+STATES = ['idle', 'running', 'pass', 'FAIL']
+
+# Masks of the result, in the order of Core/Inc/selftest.h
+MASKS = [
+    ('stuck rows', 'row'),
+    ('stuck columns', 'col'),
+    ('shorted rows', 'row'),
+    ('shorted columns', 'col'),
+    ('unseen rows', 'row'),
+    ('unseen columns', 'col'),
+]
+
+CHUNK = 32
+
+
+def transfer(bus, addr, write, read=0):
+    cmd = ['i2ctransfer', '-y', str(bus), 'w%d@0x%02x' % (len(write), addr)]
+    cmd += ['0x%02x' % b for b in write]
+    if read:
+        cmd.append('r%d@0x%02x' % (read, addr))
+    out = subprocess.run(cmd, check=True, capture_output=True, text=True).stdout
+    return bytes(int(tok, 16) for tok in out.split())
+
+
+def lines(mask, kind):
+    return ' '.join('%s%d' % (kind, i) for i in range(32) if mask & (1 << i)) or '-'
+
+
+def main():
+    parser = argparse.ArgumentParser()
+    parser.add_argument('-b', '--bus', type=int, default=1)
+    parser.add_argument('-a', '--address', type=lambda s: int(s, 0), default=0x52)
+    parser.add_argument('--read', action='store_true', help='only read the last result')
+    args = parser.parse_args()
+
+    if not args.read:
+        transfer(args.bus, args.address, [REG_SELFTEST_CTRL, CMD_START])
+        time.sleep(0.01)
+
+    deadline = time.time() + 1.0
+    while True:
+        state, _, size = transfer(args.bus, args.address, [REG_SELFTEST_CTRL], 3)
+        if state != 1 or time.time() > deadline:
+            break
+        time.sleep(0.01)
+
+    image = b''
+    while len(image) < size:
+        image += transfer(args.bus, args.address, [REG_SELFTEST_DATA, len(image)],
+                          min(CHUNK, size - len(image)))
+
+    state, faults, rows, cols = image[:4]
+    values = struct.unpack('<7I%dI' % cols, image[4:])
+    print('%s, faults 0x%02x, %dx%d matrix, %d us' % (
+        STATES[state] if state < len(STATES) else 'state %d' % state,
+        faults, rows, cols, values[6]))
+
+    for (name, kind), mask in zip(MASKS, values):
+        print('%-16s %s' % (name, lines(mask, kind)))
+    for c, mask in enumerate(values[7:]):
+        if mask:
+            print('col%d closed to   %s' % (c, lines(mask, 'row')))
+
+    if state != 2:
+        sys.exit(1)
+
+
+if __name__ == '__main__':
+    main()
@@ -0,0 +1,89 @@
+#!/usr/bin/env python3
+#
+# Blackberry Q10 keyboard STM32 driver
+# Performance counter read-out over I2C.
+#
+# Copyright (C) 2025 Mustafa Ozcelikors
+#
+# See GPLv3 LICENSE file in repository for licensing details.
+#
+# Usage: stats_read.py [-b bus] [-a address] [--clear]
+#
+# Takes a snapshot of the counters (see Core/Inc/stats.h) and prints it,
+# --clear starts a new period with the same snapshot. Uses i2ctransfer from
+# i2c-tools, so unbind the kernel driver first or run it on a bus the driver
+# is not using.
+
+import argparse
+import subprocess
+import struct
+
+REG_STATS_CTRL = 0x70
+REG_STATS_DATA = 0x71
+
+CMD_SNAPSHOT = 0x01
+CMD_SNAPSHOT_CLEAR = 0x02
+
+# Counter ids, in the order of Core/Inc/stats.h
+COUNTERS = [
+    'elapsed_ms',
+    'idle_ms',
+    'scans',
+    'scan_min',
+    'scan_max',
+    'keys_queued',
+    'keys_delivered',
+    'keys_dropped',
+    'fifo_high_water',
+    'i2c_addr',
+    'i2c_reads',
+    'i2c_writes',
+    'i2c_nacks',
+    'i2c_bus_errors',
+    'i2c_recoveries',
+    'irq_pulses',
+]
+
+CPU_HZ = 16000000
+CHUNK = 32
+
+
+def transfer(bus, addr, write, read=0):
+    cmd = ['i2ctransfer', '-y', str(bus), 'w%d@0x%02x' % (len(write), addr)]
+    cmd += ['0x%02x' % b for b in write]
+    if read:
+        cmd.append('r%d@0x%02x' % (read, addr))
+    out = subprocess.run(cmd, check=True, capture_output=True, text=True).stdout
+    return bytes(int(tok, 16) for tok in out.split())
+
+
+def main():
+    parser = argparse.ArgumentParser()
+    parser.add_argument('-b', '--bus', type=int, default=1)
+    parser.add_argument('-a', '--address', type=lambda s: int(s, 0), default=0x52)
+    parser.add_argument('--clear', action='store_true', help='start a new period')
+    args = parser.parse_args()
+
+    cmd = CMD_SNAPSHOT_CLEAR if args.clear else CMD_SNAPSHOT
+    transfer(args.bus, args.address, [REG_STATS_CTRL, cmd])
+    count, _ = transfer(args.bus, args.address, [REG_STATS_CTRL], 2)
+
+    image = b''
+    while len(image) < 4 * count:
+        image += transfer(args.bus, args.address, [REG_STATS_DATA, len(image)],
+                          min(CHUNK, 4 * count - len(image)))
+    values = struct.unpack('<%dI' % count, image)
+
+    for i, value in enumerate(values):
+        name = COUNTERS[i] if i < len(COUNTERS) else 'counter%d' % i
+        print('%-16s %10d' % (name, value))
+
+    elapsed, idle, scans, lo, hi = values[:5]
+    if elapsed:
+        print('active %.1f%%, %.1f scans/s, scan %.1f..%.1f us' % (
+            100.0 * (elapsed - idle) / elapsed, 1000.0 * scans / elapsed,
+            lo * 1e6 / CPU_HZ, hi * 1e6 / CPU_HZ))
+
+
+if __name__ == '__main__':
+    main()
@@ -0,0 +1,182 @@
+#!/usr/bin/env python3
+#
+# Blackberry Q10 keyboard STM32 driver
+# Trace decoder, expands trace records with the format strings from the ELF.
+#
+# Copyright (C) 2025 Mustafa Ozcelikors
+#
+# See GPLv3 LICENSE file in repository for licensing details.
+#
+# Usage: trace_decode.py [-b bus] [-a address] [--clear] firmware.elf
+#        trace_decode.py --swo capture.bin firmware.elf
+#
+# Reads the trace ring over I2C (oldest record first), or decodes a raw SWO
+# capture of the ITM stream, and prints each record formatted with its string
+# from the .trace_fmt section (see Core/Inc/trace.h). The ELF has to be the
+# one running on the board. --clear empties the ring after reading it. The I2C
+# read-out uses i2ctransfer from i2c-tools, so unbind the kernel driver first
+# or run it on a bus the driver is not using.
+
+import argparse
+import re
+import struct
+import subprocess
+import sys
+
+REG_TRACE_CTRL = 0x80
+REG_TRACE_DATA = 0x81
+
+CMD_CLEAR = 0x01
+CHUNK = 32
+RECORD_SIZE = 16
+ITM_PORT = 1
+
+CPU_HZ = 16000000
+
+
+def transfer(bus, addr, write, read=0):
+    cmd = ['i2ctransfer', '-y', str(bus), 'w%d@0x%02x' % (len(write), addr)]
+    cmd += ['0x%02x' % b for b in write]
+    if read:
+        cmd.append('r%d@0x%02x' % (read, addr))
+    out = subprocess.run(cmd, check=True, capture_output=True, text=True).stdout
+    return bytes(int(tok, 16) for tok in out.split())
+
+
+def load_strings(path):
+    # Just enough ELF32 little endian to find one section
+    with open(path, 'rb') as f:
+        elf = f.read()
+    if elf[:4] != b'\x7fELF' or elf[4] != 1 or elf[5] != 1:
+        sys.exit('%s: not a 32-bit little endian ELF' % path)
+
+    shoff, = struct.unpack_from('<I', elf, 0x20)
+    shentsize, shnum, shstrndx = struct.unpack_from('<HHH', elf, 0x2E)
+
+    def section(i):
+        return struct.unpack_from('<IIIIII', elf, shoff + i * shentsize)
+
+    names_offset = section(shstrndx)[4]
+    for i in range(shnum):
+        name, _, _, addr, offset, size = section(i)
+        end = elf.index(b'\0', names_offset + name)
+        if elf[names_offset + name:end] == b'.trace_fmt':
+            return addr, elf[offset:offset + size]
+
+    sys.exit('%s: no .trace_fmt section' % path)
+
+
+def to_python(fmt):
+    # Integer conversions only, drop the C length modifiers
+    return re.sub(r'(%[-+ #0]*\d*(?:\.\d+)?)(?:hh|h|ll|l|z|j|t)?([diouxXc%])', r'\1\2', fmt)
+
+
+def format_record(strings, header, args):
+    base, data = strings
+    fid, nargs = header >> 16, (header >> 8) & 0xFF
+    offset = fid - base
+
+    if nargs > len(args) or not 0 <= offset < len(data):
+        return '<bad record %08x>' % header
+
+    fmt = data[offset:data.index(b'\0', offset)].decode('ascii', 'replace')
+    values = []
+    for conv, value in zip(re.findall(r'%[-+ #0]*\d*(?:\.\d+)?[a-zA-Z]*([diouxXc])', fmt), args):
+        values.append(value - (1 << 32) if conv in 'di' and value & 0x80000000 else value)
+
+    try:
+        return to_python(fmt) % tuple(values[:nargs])
+    except (TypeError, ValueError, OverflowError):
+        return '%s %s' % (fmt, ' '.join('0x%x' % v for v in args[:nargs]))
+
+
+def print_records(strings, records):
+    first = None
+    for header, cycles, args in records:
+        if first is None:
+            first = cycles
+        us = ((cycles - first) & 0xFFFFFFFF) * 1000000 // CPU_HZ
+        print('%12d us  %s' % (us, format_record(strings, header, args)))
+
+
+def read_i2c(bus, addr):
+    status = transfer(bus, addr, [REG_TRACE_CTRL], 4)
+    head = status[0] | (status[1] << 8)
+    slots = status[2]
+    count = min(head, slots)
+    records = []
+
+    for i in range(count):
+        seq = (head - count + i) & 0xFFFF
+        slot = seq & (slots - 1)
+        raw = transfer(bus, addr, [REG_TRACE_DATA, slot], RECORD_SIZE)
+        header, cycles, a0, a1 = struct.unpack('<4I', raw)
+        # Overwritten since the status read
+        if header & 0xFF != seq & 0xFF:
+            continue
+        records.append((header, cycles, (a0, a1)))
+
+    return records
+
+
+def read_swo(path):
+    # ITM software source packets of our stimulus port, the rest is skipped
+    with open(path, 'rb') as f:
+        stream = f.read()
+    words = []
+    i = 0
+
+    while i < len(stream):
+        h = stream[i]
+        i += 1
+        if h == 0x00 or h == 0x80 or h == 0x70:
+            continue  # synchronization, overflow
+        if h & 0x03 == 0:
+            while h & 0x80 and i < len(stream):  # timestamps and extensions
+                h = stream[i]
+                i += 1
+            continue
+        size = {1: 1, 2: 2, 3: 4}[h & 0x03]
+        payload = stream[i:i + size]
+        i += size
+        if not h & 0x04 and h >> 3 == ITM_PORT and size == 4 and len(payload) == 4:
+            words.append(struct.unpack('<I', payload)[0])
+
+    # Four words per record, slide until the header looks sane after a loss or
+    # after an ISR's record cut into the one it preempted
+    records = []
+    i = 0
+    while i + 4 <= len(words):
+        header = words[i]
+        nargs = (header >> 8) & 0xFF
+        if nargs > 2 or any(words[i + 2 + n] for n in range(nargs, 2)):
+            i += 1
+            continue
+        records.append((header, words[i + 1], (words[i + 2], words[i + 3])))
+        i += 4
+
+    return records
+
+
+def main():
+    parser = argparse.ArgumentParser()
+    parser.add_argument('-b', '--bus', type=int, default=1)
+    parser.add_argument('-a', '--address', type=lambda s: int(s, 0), default=0x52)
+    parser.add_argument('--clear', action='store_true', help='empty the ring after reading it')
+    parser.add_argument('--swo', help='decode a raw SWO capture instead of reading over I2C')
+    parser.add_argument('elf')
+    args = parser.parse_args()
+
+    strings = load_strings(args.elf)
+
+    if args.swo:
+        print_records(strings, read_swo(args.swo))
+        return
+
+    print_records(strings, read_i2c(args.bus, args.address))
+    if args.clear:
+        transfer(args.bus, args.address, [REG_TRACE_CTRL, CMD_CLEAR])
+
+
+if __name__ == '__main__':
+    main()